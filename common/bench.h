@@ -0,0 +1,373 @@
+/*
+ * Общий каркас замеров для всех заданий.
+ *
+ * Одиночный замер omp_get_wtime() ничего не говорит о разбросе:
+ * первый запуск платит за промахи кэша и страницы, дальше мешают
+ * частота процессора и соседние процессы. Здесь каждый замер - это
+ *   - warmups прогревочных запусков (не учитываются)
+ *   - repetitions запусков, по которым считаются min, медиана,
+ *     95-й перцентиль, среднее и стандартное отклонение
+ * Подготовка данных перед каждым запуском (например, копирование
+ * массива для сортировки) в замер не входит.
+ *
+ * Конфигурация задается общими ключами командной строки:
+ *   --reps N         число замеряемых запусков (по умолчанию 5)
+ *   --warmup N       число прогревочных запусков (по умолчанию 1)
+ *   --sizes a,b,c    размеры входа для перебора
+ *   --threads a,b,c  числа потоков OpenMP для перебора
+ *   --csv ФАЙЛ       записать результаты в CSV ("-" - в stdout)
+ *   --json ФАЙЛ      записать результаты в JSON ("-" - в stdout)
+ *
+ * Замер с именем участка дополнительно собирает аппаратные счетчики
+ * (common/perf_counters.h, сборка с PERF_COUNTERS=1) только по
+ * замеряемым запускам; без счетчиков имя ни на что не влияет.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <omp.h>
+
+#include "perf_counters.h"
+
+namespace bench
+{
+
+// Настройки замеров
+struct Config
+{
+    int warmups;
+    int repetitions;
+    std::vector<long long> sizes;   // Пусто - размеры по умолчанию программы
+    std::vector<int> threads;       // Пусто - omp_get_max_threads()
+    std::string csvPath;
+    std::string jsonPath;
+
+    Config() : warmups(1), repetitions(5)
+    {
+    }
+};
+
+// Статистика по запускам (секунды)
+struct Summary
+{
+    int runs;
+    double min;
+    double median;
+    double p95;
+    double mean;
+    double stddev;
+};
+
+inline Summary summarize(std::vector<double> samples)
+{
+    Summary s = Summary();
+    s.runs = (int)samples.size();
+    if (samples.empty())
+    {
+        return s;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+    s.min = samples[0];
+    s.median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+
+    // Перцентиль по ближайшему рангу
+    size_t rank = (size_t)ceil(0.95 * n);
+    s.p95 = samples[rank > 0 ? rank - 1 : 0];
+
+    double sum = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        sum += samples[i];
+    }
+    s.mean = sum / n;
+
+    double sq = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        sq += (samples[i] - s.mean) * (samples[i] - s.mean);
+    }
+    s.stddev = n > 1 ? sqrt(sq / (n - 1)) : 0;
+    return s;
+}
+
+// Замер run(): перед каждым запуском вызывается setup() (не замеряется)
+// region - имя участка для счетчиков perf; они читаются за пределами
+// интервала таймера, прогрев в них не входит
+template <typename Setup, typename Run>
+Summary measure(const Config& config, const char* region, Setup setup, Run run)
+{
+    for (int w = 0; w < config.warmups; w++)
+    {
+        setup();
+        run();
+    }
+
+    std::vector<double> samples;
+    for (int r = 0; r < config.repetitions; r++)
+    {
+        setup();
+        perf::Region counters(region);
+        double start = omp_get_wtime();
+        run();
+        samples.push_back(omp_get_wtime() - start);
+        counters.stop();
+    }
+    return summarize(samples);
+}
+
+// Без имени участка (имя - строка - выбирает перегрузку ниже)
+template <typename Setup, typename Run>
+typename std::enable_if<!std::is_convertible<Setup, const char*>::value, Summary>::type
+measure(const Config& config, Setup setup, Run run)
+{
+    return measure(config, (const char*)NULL, setup, run);
+}
+
+template <typename Run>
+Summary measure(const Config& config, const char* region, Run run)
+{
+    return measure(config, region, []() {}, run);
+}
+
+template <typename Run>
+Summary measure(const Config& config, Run run)
+{
+    return measure(config, []() {}, run);
+}
+
+// Числа потоков для перебора (по умолчанию - текущее)
+inline std::vector<int> threadCounts(const Config& config)
+{
+    if (config.threads.empty())
+    {
+        return std::vector<int>(1, omp_get_max_threads());
+    }
+    return config.threads;
+}
+
+// Размеры для перебора или defaults, если --sizes не задан
+inline std::vector<long long> sizesOr(const Config& config, const std::vector<long long>& defaults)
+{
+    return config.sizes.empty() ? defaults : config.sizes;
+}
+
+// Краткая строка для вывода: "медиана 1.2 мс (min 1.1, p95 1.4, σ 0.1, 5 запусков)"
+inline std::string format(const Summary& s)
+{
+    char text[160];
+    snprintf(text, sizeof(text), "медиана %.4g мс (min %.4g, p95 %.4g, σ %.2g, %d запусков)",
+             s.median * 1000, s.min * 1000, s.p95 * 1000, s.stddev * 1000, s.runs);
+    return text;
+}
+
+// Одна строка результатов
+struct Record
+{
+    std::string benchmark;   // Что замеряли (например, "sort")
+    std::string variant;     // Вариант (например, "radix")
+    long long size;          // Размер входа (элементов)
+    int threads;
+    Summary time;
+    double bytes;            // Объем данных за запуск (0 - не считать ГБ/с)
+};
+
+// Накопление результатов и вывод в CSV/JSON
+class Report
+{
+public:
+    explicit Report(const std::string& program) : program(program)
+    {
+    }
+
+    void add(const std::string& benchmark, const std::string& variant, long long size,
+             int threads, const Summary& time, double bytes = 0)
+    {
+        Record r;
+        r.benchmark = benchmark;
+        r.variant = variant;
+        r.size = size;
+        r.threads = threads;
+        r.time = time;
+        r.bytes = bytes;
+        records.push_back(r);
+    }
+
+    // Записывает файлы из config; false - не удалось открыть файл
+    bool write(const Config& config) const
+    {
+        bool ok = true;
+        if (!config.csvPath.empty())
+        {
+            ok = writeFile(config.csvPath, false) && ok;
+        }
+        if (!config.jsonPath.empty())
+        {
+            ok = writeFile(config.jsonPath, true) && ok;
+        }
+        return ok;
+    }
+
+private:
+    bool writeFile(const std::string& path, bool json) const
+    {
+        bool console = path == "-";
+        FILE* out = console ? stdout : fopen(path.c_str(), "w");
+        if (out == NULL)
+        {
+            std::cout << "Не удалось создать файл " << path << std::endl;
+            return false;
+        }
+        std::cout.flush();
+
+        if (json)
+        {
+            writeJson(out);
+        }
+        else
+        {
+            writeCsv(out);
+        }
+
+        if (console)
+        {
+            fflush(out);
+            return true;
+        }
+        return fclose(out) == 0;
+    }
+
+    static double gigabytesPerSecond(const Record& r)
+    {
+        return r.bytes > 0 && r.time.median > 0 ? r.bytes / r.time.median / 1e9 : 0;
+    }
+
+    void writeCsv(FILE* out) const
+    {
+        fprintf(out, "program,benchmark,variant,size,threads,runs,"
+                     "min_s,median_s,p95_s,mean_s,stddev_s,gb_per_s\n");
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            const Record& r = records[i];
+            fprintf(out, "%s,%s,%s,%lld,%d,%d,%.9g,%.9g,%.9g,%.9g,%.9g,%.6g\n",
+                    program.c_str(), r.benchmark.c_str(), r.variant.c_str(), r.size, r.threads,
+                    r.time.runs, r.time.min, r.time.median, r.time.p95, r.time.mean,
+                    r.time.stddev, gigabytesPerSecond(r));
+        }
+    }
+
+    void writeJson(FILE* out) const
+    {
+        fprintf(out, "{\n  \"program\": \"%s\",\n  \"results\": [\n", program.c_str());
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            const Record& r = records[i];
+            fprintf(out, "    {\"benchmark\": \"%s\", \"variant\": \"%s\", \"size\": %lld, "
+                         "\"threads\": %d, \"runs\": %d, \"min_s\": %.9g, \"median_s\": %.9g, "
+                         "\"p95_s\": %.9g, \"mean_s\": %.9g, \"stddev_s\": %.9g, "
+                         "\"gb_per_s\": %.6g}%s\n",
+                    r.benchmark.c_str(), r.variant.c_str(), r.size, r.threads, r.time.runs,
+                    r.time.min, r.time.median, r.time.p95, r.time.mean, r.time.stddev,
+                    gigabytesPerSecond(r), i + 1 < records.size() ? "," : "");
+        }
+        fprintf(out, "  ]\n}\n");
+    }
+
+    std::string program;
+    std::vector<Record> records;
+};
+
+// Список положительных чисел через запятую; false - ошибка
+template <typename T>
+bool parseList(const char* text, std::vector<T>& values)
+{
+    values.clear();
+    std::string list(text);
+    size_t start = 0;
+    while (start <= list.size())
+    {
+        size_t comma = list.find(',', start);
+        std::string item = list.substr(start, comma == std::string::npos ? std::string::npos
+                                                                          : comma - start);
+        long long value = atoll(item.c_str());
+        if (value < 1)
+        {
+            return false;
+        }
+        values.push_back((T)value);
+        if (comma == std::string::npos)
+        {
+            break;
+        }
+        start = comma + 1;
+    }
+    return !values.empty();
+}
+
+// Разбор общего ключа argv[i]; true - ключ наш и разобран
+// (i сдвигается на значение), false - чужой ключ или ошибка в значении
+inline bool parseOption(int argc, char* argv[], int& i, Config& config)
+{
+    if (i + 1 >= argc)
+    {
+        return false;
+    }
+    const char* name = argv[i];
+    const char* value = argv[i + 1];
+
+    if (strcmp(name, "--reps") == 0 && atoi(value) >= 1)
+    {
+        config.repetitions = atoi(value);
+    }
+    else if (strcmp(name, "--warmup") == 0 && atoi(value) >= 0 && value[0] != '-')
+    {
+        config.warmups = atoi(value);
+    }
+    else if (strcmp(name, "--sizes") == 0 && parseList(value, config.sizes))
+    {
+    }
+    else if (strcmp(name, "--threads") == 0 && parseList(value, config.threads))
+    {
+    }
+    else if (strcmp(name, "--csv") == 0)
+    {
+        config.csvPath = value;
+    }
+    else if (strcmp(name, "--json") == 0)
+    {
+        config.jsonPath = value;
+    }
+    else
+    {
+        return false;
+    }
+    i++;
+    return true;
+}
+
+// Справка по общим ключам
+inline void printUsage()
+{
+    std::cout << "Общие ключи замеров:" << std::endl;
+    std::cout << "  --reps N         замеряемых запусков (по умолчанию 5)" << std::endl;
+    std::cout << "  --warmup N       прогревочных запусков (по умолчанию 1)" << std::endl;
+    std::cout << "  --sizes a,b,c    размеры входа" << std::endl;
+    std::cout << "  --threads a,b,c  числа потоков OpenMP" << std::endl;
+    std::cout << "  --csv ФАЙЛ       результаты в CSV (\"-\" - в stdout)" << std::endl;
+    std::cout << "  --json ФАЙЛ      результаты в JSON (\"-\" - в stdout)" << std::endl;
+}
+
+} // namespace bench
+
+#endif // BENCH_H
@@ -0,0 +1,319 @@
+/*
+ * Параллельный детерминированный генератор тестовых данных.
+ *
+ * rand() в glibc берет глобальную блокировку, работает в одном потоке,
+ * а srand(time(NULL)) делает запуски невоспроизводимыми. Здесь
+ * используется счетчиковый генератор Philox4x32-10 (Salmon et al.,
+ * "Parallel random numbers: as easy as 1, 2, 3", 2011): случайное
+ * число для элемента i - это шифр от (i, номер попытки) на ключе seed.
+ * Состояния нет, поэтому массив заполняется параллельно любым числом
+ * потоков, а результат зависит только от seed и индексов.
+ *
+ * Распределения:
+ *   - UNIFORM       равномерно на [lo, hi)
+ *   - ZIPF          ранги Zipf с показателем zipfExponent: значение
+ *                   lo + (ранг - 1), маленькие значения встречаются чаще
+ *                   (rejection-inversion, Hormann & Derflinger 1996)
+ *   - SORTED        неубывающая последовательность на [lo, hi)
+ *   - REVERSE       невозрастающая
+ *   - FEW_UNIQUE    uniqueValues разных значений, равномерно по [lo, hi)
+ *   - NEARLY_SORTED отсортированная с локальным шумом, доля disorder
+ *                   элементов - случайные значения на своих местах
+ */
+
+#ifndef DATA_GEN_H
+#define DATA_GEN_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <omp.h>
+
+namespace datagen
+{
+
+enum Distribution
+{
+    UNIFORM,
+    ZIPF,
+    SORTED,
+    REVERSE,
+    FEW_UNIQUE,
+    NEARLY_SORTED
+};
+
+const int DISTRIBUTION_COUNT = NEARLY_SORTED + 1;
+
+// Seed по умолчанию - одинаковые данные во всех запусках
+const uint64_t DEFAULT_SEED = 42;
+
+// Параметры генерации
+struct Spec
+{
+    Distribution distribution;
+    int lo;               // Значения на [lo, hi)
+    int hi;
+    uint64_t seed;
+    double zipfExponent;  // ZIPF: показатель s > 0
+    int uniqueValues;     // FEW_UNIQUE: число разных значений
+    double disorder;      // NEARLY_SORTED: доля случайных элементов
+
+    Spec(Distribution distribution = UNIFORM, int lo = 0, int hi = 100000,
+         uint64_t seed = DEFAULT_SEED)
+        : distribution(distribution), lo(lo), hi(hi), seed(seed),
+          zipfExponent(1.1), uniqueValues(16), disorder(0.01)
+    {
+    }
+};
+
+inline const char* distributionName(Distribution d)
+{
+    static const char* const names[DISTRIBUTION_COUNT] = {
+        "uniform", "zipf", "sorted", "reverse", "few-unique", "nearly-sorted"
+    };
+    return names[d];
+}
+
+// Разбор имени распределения; false - неизвестное имя
+inline bool parseDistribution(const char* name, Distribution& d)
+{
+    for (int i = 0; i < DISTRIBUTION_COUNT; i++)
+    {
+        if (strcmp(name, distributionName((Distribution)i)) == 0)
+        {
+            d = (Distribution)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Блок из 4 случайных 32-битных слов
+struct Block
+{
+    uint32_t w[4];
+};
+
+// Philox4x32-10: 10 раундов над счетчиком (c0..c3) с ключом (k0, k1)
+inline Block philox(uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3, uint64_t seed)
+{
+    uint32_t k0 = (uint32_t)seed;
+    uint32_t k1 = (uint32_t)(seed >> 32);
+
+    for (int round = 0; round < 10; round++)
+    {
+        uint64_t p0 = (uint64_t)0xD2511F53u * c0;
+        uint64_t p1 = (uint64_t)0xCD9E8D57u * c2;
+        uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c1 = (uint32_t)p1;
+        c3 = (uint32_t)p0;
+        c0 = n0;
+        c2 = n2;
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+
+    Block b;
+    b.w[0] = c0;
+    b.w[1] = c1;
+    b.w[2] = c2;
+    b.w[3] = c3;
+    return b;
+}
+
+// Случайный блок элемента index (attempt - номер попытки для отбора)
+inline Block randomBlock(uint64_t index, uint32_t attempt, uint64_t seed)
+{
+    return philox((uint32_t)index, (uint32_t)(index >> 32), attempt, 0, seed);
+}
+
+// Равномерное double на [0, 1) из 53 бит
+inline double toUnit(uint32_t hi, uint32_t lo)
+{
+    uint64_t bits = ((uint64_t)hi << 32 | lo) >> 11;
+    return bits * (1.0 / 9007199254740992.0);
+}
+
+// Равномерное целое на [0, range) без деления (умножение со сдвигом)
+inline uint32_t toRange(uint32_t r, uint32_t range)
+{
+    return (uint32_t)(((uint64_t)r * range) >> 32);
+}
+
+namespace detail
+{
+
+// Выборка Zipf методом rejection-inversion: ранг на [1, n]
+// Для каждого элемента несколько попыток, каждая со своим счетчиком
+class ZipfSampler
+{
+public:
+    ZipfSampler(double n, double s) : n(n), s(s)
+    {
+        hIntegralX1 = hIntegral(1.5) - 1.0;
+        hIntegralN = hIntegral(n + 0.5);
+        threshold = 2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0));
+    }
+
+    uint32_t sample(uint64_t index, uint64_t seed) const
+    {
+        for (uint32_t attempt = 0; ; attempt++)
+        {
+            Block b = randomBlock(index, attempt, seed);
+            double u = hIntegralN + toUnit(b.w[0], b.w[1]) * (hIntegralX1 - hIntegralN);
+            double x = hIntegralInverse(u);
+            double k = floor(x + 0.5);
+            k = k < 1 ? 1 : (k > n ? n : k);
+            if (k - x <= threshold || u >= hIntegral(k + 0.5) - h(k))
+            {
+                return (uint32_t)k;
+            }
+        }
+    }
+
+private:
+    double h(double x) const
+    {
+        return exp(-s * log(x));
+    }
+
+    double hIntegral(double x) const
+    {
+        double logX = log(x);
+        return helper2((1.0 - s) * logX) * logX;
+    }
+
+    double hIntegralInverse(double x) const
+    {
+        double t = x * (1.0 - s);
+        if (t < -1.0)
+        {
+            t = -1.0;
+        }
+        return exp(helper1(t) * x);
+    }
+
+    // log(1 + x) / x и (exp(x) - 1) / x, точные около нуля
+    static double helper1(double x)
+    {
+        return fabs(x) > 1e-8 ? log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+
+    static double helper2(double x)
+    {
+        return fabs(x) > 1e-8 ? expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+    }
+
+    double n;
+    double s;
+    double hIntegralX1;
+    double hIntegralN;
+    double threshold;
+};
+
+// Значение элемента index массива из total элементов
+// (распределения, которым нужно больше одного слова на элемент)
+inline int generate(uint64_t index, uint64_t total, const Spec& spec, uint32_t range,
+                    const ZipfSampler* zipf)
+{
+    switch (spec.distribution)
+    {
+    case ZIPF:
+        return spec.lo + (int)(zipf->sample(index, spec.seed) - 1);
+
+    case SORTED:
+        return spec.lo + (int)((double)index / total * range);
+
+    case REVERSE:
+        return spec.lo + (int)((double)(total - 1 - index) / total * range);
+
+    case NEARLY_SORTED:
+    {
+        // Отсортированное значение со сдвигом на несколько позиций;
+        // изредка - совсем случайное значение
+        Block b = randomBlock(index, 0, spec.seed);
+        if (toUnit(b.w[0], b.w[1]) < spec.disorder)
+        {
+            return spec.lo + (int)toRange(b.w[2], range);
+        }
+        double step = (double)range / total;
+        double noise = ((double)toRange(b.w[3], 65) - 32) * step;
+        double v = index * step + noise;
+        v = v < 0 ? 0 : (v > range - 1 ? range - 1 : v);
+        return spec.lo + (int)v;
+    }
+
+    default:
+        return spec.lo;
+    }
+}
+
+// UNIFORM и FEW_UNIQUE берут одно слово на элемент: блок Philox
+// с номером index / 4 (поток счетчика 1) дает 4 соседних элемента
+inline bool wordPerElement(const Spec& spec)
+{
+    return spec.distribution == UNIFORM || spec.distribution == FEW_UNIQUE;
+}
+
+inline int fromWord(uint32_t word, const Spec& spec, uint32_t range)
+{
+    if (spec.distribution == FEW_UNIQUE)
+    {
+        uint32_t unique = spec.uniqueValues < 1 ? 1 : (uint32_t)spec.uniqueValues;
+        uint32_t v = toRange(word, unique);
+        return spec.lo + (int)((uint64_t)v * range / unique);
+    }
+    return spec.lo + (int)toRange(word, range);
+}
+
+} // namespace detail
+
+// Заполняет arr[0..n) элементами first..first+n последовательности
+// из total элементов (total = 0 - это n). Так большой файл можно
+// генерировать кусками, и результат не зависит от размера куска
+// и числа потоков
+inline void fill(int* arr, size_t n, const Spec& spec, size_t first = 0, size_t total = 0,
+                 int threads = omp_get_max_threads())
+{
+    if (total == 0)
+    {
+        total = first + n;
+    }
+    uint32_t range = spec.hi > spec.lo ? (uint32_t)((int64_t)spec.hi - spec.lo) : 1;
+    detail::ZipfSampler zipf(range, spec.zipfExponent);
+    bool words = detail::wordPerElement(spec);
+    if (n == 0)
+    {
+        return;
+    }
+
+    // Группы по 4 индекса - столько слов в одном блоке Philox
+    size_t end = first + n;
+    #pragma omp parallel for schedule(static) num_threads(threads)
+    for (size_t group = first / 4; group <= (end - 1) / 4; group++)
+    {
+        size_t from = group * 4 < first ? first : group * 4;
+        size_t to = group * 4 + 4 > end ? end : group * 4 + 4;
+        if (words)
+        {
+            Block b = randomBlock(group, 1, spec.seed);
+            for (size_t i = from; i < to; i++)
+            {
+                arr[i - first] = detail::fromWord(b.w[i % 4], spec, range);
+            }
+        }
+        else
+        {
+            for (size_t i = from; i < to; i++)
+            {
+                arr[i - first] = detail::generate(i, total, spec, range, &zipf);
+            }
+        }
+    }
+}
+
+} // namespace datagen
+
+#endif // DATA_GEN_H
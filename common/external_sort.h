@@ -0,0 +1,503 @@
+/*
+ * Внешняя сортировка (out-of-core) файлов из int32, которые не
+ * помещаются в память.
+ *
+ * Весь объем памяти задается бюджетом memoryBudget:
+ *   1) Формирование серий: файл читается кусками по memoryBudget / 8
+ *      элементов (вторая половина бюджета - временный буфер сортировки),
+ *      каждый кусок сортируется параллельно (psort::mergeSort)
+ *      и сбрасывается на диск как отсортированная серия
+ *   2) Слияние: все серии сливаются деревом проигравших из kway_merge.h.
+ *      У каждой серии два буфера: пока слияние берет данные из одного,
+ *      в другой асинхронно читается следующий блок. Выход тоже пишется
+ *      асинхронно из двух буферов. Если серий так много, что блоки
+ *      становятся меньше MIN_BLOCK, сначала сливаются группы серий
+ *      в промежуточные серии (дополнительный проход)
+ *
+ * Ошибки ввода-вывода завершают программу с сообщением, как в арене.
+ *
+ * Формат файлов - "сырые" int32 в порядке байт машины, без заголовка.
+ */
+
+#ifndef EXTERNAL_SORT_H
+#define EXTERNAL_SORT_H
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include <unistd.h>
+
+#include "kway_merge.h"
+#include "parallel_sort.h"
+#include "scratch_arena.h"
+
+namespace extsort
+{
+
+// Наименьший блок чтения/записи при слиянии (элементов int)
+const size_t MIN_BLOCK = 1 << 16;
+
+// Настройки внешней сортировки
+struct Options
+{
+    size_t memoryBudget;   // Байт памяти на данные (буферы и сортировку)
+    std::string tempDir;   // Каталог для серий
+    int threads;           // Потоков для сортировки серий
+
+    Options() : memoryBudget(256u << 20), tempDir("."), threads(omp_get_max_threads())
+    {
+    }
+};
+
+// Статистика по фазам: время в секундах, байты данных
+struct Stats
+{
+    size_t elements;
+    unsigned long long checksum;   // Как checksum() в task3 - не зависит от порядка
+
+    // Фаза 1: формирование серий
+    size_t runs;
+    double readTime;
+    double sortTime;
+    double writeTime;
+
+    // Фаза 2: слияние (все проходы)
+    int mergePasses;
+    size_t mergeBytes;     // Прочитано байт за все проходы (столько же записано)
+    double mergeTime;
+    double ioWaitTime;     // Сколько слияние ждало ввод-вывод
+};
+
+// Скорость в МБ/с
+inline double megabytesPerSecond(double bytes, double seconds)
+{
+    return seconds > 0 ? bytes / seconds / 1e6 : 0;
+}
+
+namespace detail
+{
+
+inline void ioFail(const char* what, const std::string& path)
+{
+    std::cout << "Внешняя сортировка: " << what << " " << path << std::endl;
+    exit(1);
+}
+
+inline FILE* openFile(const std::string& path, const char* mode)
+{
+    FILE* file = fopen(path.c_str(), mode);
+    if (file == NULL)
+    {
+        ioFail("не удалось открыть файл", path);
+    }
+    return file;
+}
+
+inline void writeInts(FILE* file, const int* data, size_t n, const std::string& path)
+{
+    if (fwrite(data, sizeof(int), n, file) != n)
+    {
+        ioFail("ошибка записи в файл", path);
+    }
+}
+
+inline unsigned long long checksum(const int* data, size_t n)
+{
+    unsigned long long sum = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        unsigned long long x = (unsigned int)data[i];
+        sum += x * x + x * 0x9E3779B97F4A7C15ULL;
+    }
+    return sum;
+}
+
+// Чтение серии блоками с опережением на один блок
+// Текущий блок - [cur, end); когда он кончился, next() отдает
+// уже прочитанный следующий и запускает чтение еще одного
+class RunReader
+{
+public:
+    RunReader(const std::string& path, size_t block)
+        : path(path), block(block), front(block), back(block), done(false)
+    {
+        file = openFile(path, "rb");
+        cur = end = front.data();
+        prefetch();
+    }
+
+    ~RunReader()
+    {
+        if (pending.valid())
+        {
+            pending.wait();
+        }
+        fclose(file);
+    }
+
+    // Следующий блок (ждет чтения); возвращает время ожидания
+    double next()
+    {
+        double start = omp_get_wtime();
+        size_t n = pending.get();
+        double wait = omp_get_wtime() - start;
+        if (ferror(file))
+        {
+            ioFail("ошибка чтения файла", path);
+        }
+
+        front.swap(back);
+        cur = front.data();
+        end = cur + n;
+        if (n == block)
+        {
+            prefetch();
+        }
+        else
+        {
+            done = true;
+        }
+        return wait;
+    }
+
+    // Последний блок уже в памяти
+    bool finished() const
+    {
+        return done;
+    }
+
+    const int* cur;
+    const int* end;
+
+private:
+    void prefetch()
+    {
+        FILE* f = file;
+        int* data = back.data();
+        size_t n = block;
+        pending = std::async(std::launch::async, [f, data, n]()
+        {
+            return fread(data, sizeof(int), n, f);
+        });
+    }
+
+    std::string path;
+    size_t block;
+    std::vector<int> front;
+    std::vector<int> back;
+    std::future<size_t> pending;
+    bool done;
+    FILE* file;
+
+    RunReader(const RunReader&);
+    RunReader& operator=(const RunReader&);
+};
+
+// Запись блоками: пока один буфер пишется на диск, заполняется другой
+class RunWriter
+{
+public:
+    RunWriter(const std::string& path, size_t block)
+        : path(path), block(block), front(block), back(block), fill(0), waitTime(0)
+    {
+        file = openFile(path, "wb");
+    }
+
+    // Свободное место в текущем буфере
+    int* space(size_t& available)
+    {
+        if (fill == block)
+        {
+            flush();
+        }
+        available = block - fill;
+        return front.data() + fill;
+    }
+
+    void commit(size_t n)
+    {
+        fill += n;
+    }
+
+    // Дописывает остаток и закрывает файл; возвращает время ожидания записи
+    double finish()
+    {
+        flush();
+        wait();
+        if (fclose(file) != 0)
+        {
+            ioFail("ошибка записи в файл", path);
+        }
+        return waitTime;
+    }
+
+private:
+    void wait()
+    {
+        if (pending.valid())
+        {
+            double start = omp_get_wtime();
+            bool ok = pending.get();
+            waitTime += omp_get_wtime() - start;
+            if (!ok)
+            {
+                ioFail("ошибка записи в файл", path);
+            }
+        }
+    }
+
+    void flush()
+    {
+        wait();
+        front.swap(back);
+
+        FILE* f = file;
+        const int* data = back.data();
+        size_t n = fill;
+        pending = std::async(std::launch::async, [f, data, n]()
+        {
+            return fwrite(data, sizeof(int), n, f) == n;
+        });
+        fill = 0;
+    }
+
+    std::string path;
+    size_t block;
+    std::vector<int> front;
+    std::vector<int> back;
+    size_t fill;
+    std::future<bool> pending;
+    double waitTime;
+    FILE* file;
+
+    RunWriter(const RunWriter&);
+    RunWriter& operator=(const RunWriter&);
+};
+
+// Имя временного файла серии
+inline std::string runPath(const Options& options, size_t index)
+{
+    return options.tempDir + "/extsort_" + std::to_string((long)getpid()) + "_"
+           + std::to_string(index) + ".run";
+}
+
+// Слияние серий runs в файл output блоками по block элементов
+// Возвращает время ожидания ввода-вывода
+inline double mergeRuns(const std::vector<std::string>& runs, const std::string& output,
+                        size_t block)
+{
+    size_t k = runs.size();
+    std::vector<RunReader*> readers(k);
+    for (size_t i = 0; i < k; i++)
+    {
+        readers[i] = new RunReader(runs[i], block);
+    }
+    RunWriter writer(output, block);
+    double wait = 0;
+
+    std::vector<const int*> begins(k);
+    std::vector<const int*> stops(k);
+
+    while (true)
+    {
+        // Пустые блоки заменяем следующими
+        bool any = false;
+        for (size_t i = 0; i < k; i++)
+        {
+            RunReader& r = *readers[i];
+            while (r.cur == r.end && !r.finished())
+            {
+                wait += r.next();
+            }
+            any = any || r.cur < r.end;
+        }
+        if (!any)
+        {
+            break;
+        }
+
+        // Без подкачки можно выдать все элементы не больше limit -
+        // наименьшего последнего элемента среди серий, у которых
+        // на диске еще есть данные. Серия с этим элементом
+        // опустеет целиком, так что каждый раунд продвигается
+        bool bounded = false;
+        int limit = INT_MAX;
+        for (size_t i = 0; i < k; i++)
+        {
+            RunReader& r = *readers[i];
+            if (r.cur < r.end && !r.finished())
+            {
+                limit = bounded ? std::min(limit, r.end[-1]) : r.end[-1];
+                bounded = true;
+            }
+        }
+
+        size_t total = 0;
+        for (size_t i = 0; i < k; i++)
+        {
+            RunReader& r = *readers[i];
+            begins[i] = r.cur;
+            stops[i] = bounded ? std::upper_bound(r.cur, r.end, limit) : r.end;
+            total += stops[i] - begins[i];
+        }
+
+        kway::LoserTree tree(begins.data(), stops.data(), k);
+        while (total > 0)
+        {
+            size_t available;
+            int* out = writer.space(available);
+            size_t n = std::min(total, available);
+            tree.pop(out, n);
+            writer.commit(n);
+            total -= n;
+        }
+
+        for (size_t i = 0; i < k; i++)
+        {
+            readers[i]->cur = stops[i];
+        }
+    }
+
+    for (size_t i = 0; i < k; i++)
+    {
+        delete readers[i];
+    }
+    return wait + writer.finish();
+}
+
+} // namespace detail
+
+// Сортирует файл input в файл output, используя не больше
+// options.memoryBudget байт под данные
+inline Stats sortFile(const std::string& input, const std::string& output,
+                      const Options& options = Options())
+{
+    Stats stats = Stats();
+
+    // ===== Фаза 1: формирование серий =====
+    size_t chunk = std::max(MIN_BLOCK, options.memoryBudget / (2 * sizeof(int)));
+    int* buffer = new int[chunk];
+    arena::ScratchArena scratch;
+    std::vector<std::string> runs;
+
+    FILE* in = detail::openFile(input, "rb");
+    while (true)
+    {
+        double start = omp_get_wtime();
+        size_t n = fread(buffer, sizeof(int), chunk, in);
+        if (ferror(in))
+        {
+            detail::ioFail("ошибка чтения файла", input);
+        }
+        double read = omp_get_wtime();
+        if (n == 0)
+        {
+            break;
+        }
+
+        stats.elements += n;
+        stats.checksum += detail::checksum(buffer, n);
+        psort::mergeSort(buffer, n, scratch, options.threads);
+        double sorted = omp_get_wtime();
+
+        std::string path = detail::runPath(options, runs.size());
+        FILE* out = detail::openFile(path, "wb");
+        detail::writeInts(out, buffer, n, path);
+        if (fclose(out) != 0)
+        {
+            detail::ioFail("ошибка записи в файл", path);
+        }
+        runs.push_back(path);
+        double written = omp_get_wtime();
+
+        stats.readTime += read - start;
+        stats.sortTime += sorted - read;
+        stats.writeTime += written - sorted;
+
+        if (n < chunk)
+        {
+            break;
+        }
+    }
+    fclose(in);
+    delete[] buffer;
+    stats.runs = runs.size();
+
+    // ===== Фаза 2: слияние =====
+    // На k серий нужно 2k буферов чтения и 2 буфера записи
+    size_t budgetInts = options.memoryBudget / sizeof(int);
+    size_t maxFanIn = std::max((size_t)2, budgetInts / MIN_BLOCK / 2 - 1);
+    size_t nextRun = runs.size();
+    double start = omp_get_wtime();
+
+    // Промежуточные проходы, пока серий больше, чем можно слить за раз
+    while (runs.size() > maxFanIn)
+    {
+        std::vector<std::string> merged;
+        for (size_t g = 0; g < runs.size(); g += maxFanIn)
+        {
+            std::vector<std::string> group(runs.begin() + g,
+                                           runs.begin() + std::min(runs.size(), g + maxFanIn));
+            std::string path = detail::runPath(options, nextRun++);
+            stats.ioWaitTime += detail::mergeRuns(group, path, budgetInts / (2 * group.size() + 2));
+            for (size_t i = 0; i < group.size(); i++)
+            {
+                remove(group[i].c_str());
+            }
+            merged.push_back(path);
+        }
+        runs.swap(merged);
+        stats.mergePasses++;
+        stats.mergeBytes += stats.elements * sizeof(int);
+    }
+
+    // Последний проход - сразу в выходной файл
+    size_t block = std::max(MIN_BLOCK, budgetInts / (2 * runs.size() + 2));
+    stats.ioWaitTime += detail::mergeRuns(runs, output, block);
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        remove(runs[i].c_str());
+    }
+    stats.mergePasses++;
+    stats.mergeBytes += stats.elements * sizeof(int);
+    stats.mergeTime = omp_get_wtime() - start;
+
+    return stats;
+}
+
+// Проверка результата: файл отсортирован, в нем столько же элементов
+// и та же контрольная сумма, что у входа
+inline bool verifyFile(const std::string& path, const Stats& stats)
+{
+    FILE* file = detail::openFile(path, "rb");
+    std::vector<int> block(MIN_BLOCK * 16);
+    size_t count = 0;
+    unsigned long long sum = 0;
+    bool sorted = true;
+    int last = INT_MIN;
+
+    size_t n;
+    while ((n = fread(block.data(), sizeof(int), block.size(), file)) > 0)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            sorted = sorted && last <= block[i];
+            last = block[i];
+        }
+        count += n;
+        sum += detail::checksum(block.data(), n);
+    }
+    fclose(file);
+
+    return sorted && count == stats.elements && sum == stats.checksum;
+}
+
+} // namespace extsort
+
+#endif // EXTERNAL_SORT_H
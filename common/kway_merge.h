@@ -0,0 +1,392 @@
+/*
+ * Сортировка слиянием с k-путевым слиянием на дереве проигравших.
+ *
+ * Попарное слияние (как в mergeSortGPU) читает и пишет весь массив
+ * на каждом уровне: log2(n/64) проходов по памяти. Здесь:
+ *   1) куски по 64 элемента сортируются сетью из sort_network.h
+ *   2) все куски сливаются за один проход деревом проигравших
+ *      (loser tree): выбор следующего минимума из k серий стоит
+ *      log2(k) сравнений и не требует перечитывать данные
+ *   3) если серий больше MAX_FAN_IN, проходов несколько: p проходов
+ *      по группам из ~k^(1/p) серий (p - наименьшее, при котором
+ *      группа не больше MAX_FAN_IN), обычно два - по ~sqrt(k)
+ *
+ * Каждое слияние делится на независимые части выхода: для границы
+ * части с номером r во всех сериях ищутся позиции, после которых
+ * ровно r элементов меньше или равны остальным (выбор по нескольким
+ * последовательностям бинарным поиском по значениям группы). Границы
+ * считаются один раз на проход, затем части сливаются разными
+ * потоками без синхронизации.
+ *
+ * Функция возвращает число проходов и байт, прочитанных и записанных
+ * на один элемент, чтобы сравнить трафик с попарным слиянием.
+ */
+
+#ifndef KWAY_MERGE_H
+#define KWAY_MERGE_H
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <omp.h>
+
+#include "scratch_arena.h"
+#include "sort_network.h"
+
+namespace kway
+{
+
+// Длина начальных серий (сортируются сетью)
+const size_t RUN_LENGTH = netsort::MAX_BLOCK;
+
+// Больше серий одно дерево не сливает - будет больше проходов
+const size_t MAX_FAN_IN = 1024;
+
+// Размер части выхода, которую сливает один поток
+const size_t MIN_PART = 1 << 14;
+const size_t MAX_PART = 1 << 20;
+
+// Статистика сортировки
+struct Stats
+{
+    int mergePasses;          // Проходов k-путевого слияния
+    double bytesPerElement;   // Прочитано + записано байт на элемент
+};
+
+// Дерево проигравших для слияния k серий
+// Ключ листа: значение в старших 32 битах, номер серии в младших -
+// все ключи различны, а при равных значениях побеждает серия с меньшим
+// номером (слияние устойчивое). Исчерпанная серия имеет ключ UINT64_MAX.
+// В узлах хранятся сами ключи проигравших, поэтому подъем к корню
+// не обращается к сериям, а сравнения компилируются без ветвлений.
+class LoserTree
+{
+public:
+    LoserTree(const int* const* begins, const int* const* ends, size_t k)
+        : cur(begins, begins + k), end(ends, ends + k)
+    {
+        leaves = 1;
+        while (leaves < k)
+        {
+            leaves *= 2;
+        }
+
+        // Строим дерево снизу вверх: в узле остается проигравший,
+        // победитель поднимается выше
+        tree.assign(leaves, UINT64_MAX);
+        std::vector<uint64_t> winners(2 * leaves, UINT64_MAX);
+        for (size_t i = 0; i < k; i++)
+        {
+            winners[leaves + i] = keyOf(i);
+        }
+        for (size_t node = leaves - 1; node >= 1; node--)
+        {
+            uint64_t a = winners[2 * node];
+            uint64_t b = winners[2 * node + 1];
+            winners[node] = std::min(a, b);
+            tree[node] = std::max(a, b);
+        }
+        tree[0] = winners[1];
+    }
+
+    // Записывает count следующих элементов слияния в out
+    void pop(int* out, size_t count)
+    {
+        uint64_t winner = tree[0];
+        for (size_t i = 0; i < count; i++)
+        {
+            size_t leaf = (uint32_t)winner;
+            out[i] = (int)((uint32_t)(winner >> 32) ^ 0x80000000u);
+            cur[leaf]++;
+            winner = keyOf(leaf);
+
+            // Новый ключ листа поднимается к корню
+            for (size_t node = (leaves + leaf) / 2; node >= 1; node /= 2)
+            {
+                uint64_t loser = tree[node];
+                tree[node] = std::max(loser, winner);
+                winner = std::min(loser, winner);
+            }
+        }
+        tree[0] = winner;
+    }
+
+private:
+    uint64_t keyOf(size_t i) const
+    {
+        if (cur[i] == end[i])
+        {
+            return UINT64_MAX;
+        }
+        // Инверсия знакового бита сохраняет порядок при сравнении без знака
+        uint64_t value = (uint32_t)(*cur[i]) ^ 0x80000000u;
+        return (value << 32) | i;
+    }
+
+    size_t leaves;
+    std::vector<const int*> cur;
+    std::vector<const int*> end;
+    std::vector<uint64_t> tree;
+};
+
+namespace detail
+{
+
+// Серии группы: последовательные куски длины runLength (последний короче)
+struct Runs
+{
+    const int* base;
+    size_t length;
+    size_t runLength;
+
+    size_t count() const
+    {
+        return (length + runLength - 1) / runLength;
+    }
+    const int* begin(size_t i) const
+    {
+        return base + i * runLength;
+    }
+    const int* end(size_t i) const
+    {
+        return base + std::min(length, (i + 1) * runLength);
+    }
+};
+
+// Выбор по нескольким последовательностям: позиции split[i] в каждой
+// серии, такие что всего взято rank элементов и каждый взятый
+// не больше любого невзятого
+inline void selectSplits(const Runs& runs, size_t rank, size_t* split)
+{
+    size_t k = runs.count();
+    if (rank == 0)
+    {
+        std::fill(split, split + k, (size_t)0);
+        return;
+    }
+    if (rank >= runs.length)
+    {
+        for (size_t i = 0; i < k; i++)
+        {
+            split[i] = runs.end(i) - runs.begin(i);
+        }
+        return;
+    }
+
+    // Искомое значение лежит между наименьшим и наибольшим в группе:
+    // поиск идет по этому диапазону, а не по всем значениям int
+    long long lo = INT_MAX;
+    long long hi = INT_MIN;
+    for (size_t i = 0; i < k; i++)
+    {
+        lo = std::min(lo, (long long)*runs.begin(i));
+        hi = std::max(hi, (long long)*(runs.end(i) - 1));
+    }
+
+    // Наименьшее v, для которого элементов <= v не меньше rank
+    while (lo < hi)
+    {
+        long long mid = lo + (hi - lo) / 2;
+        size_t countLE = 0;
+        for (size_t i = 0; i < k; i++)
+        {
+            countLE += std::upper_bound(runs.begin(i), runs.end(i), (int)mid) - runs.begin(i);
+        }
+        if (countLE >= rank)
+        {
+            hi = mid;
+        }
+        else
+        {
+            lo = mid + 1;
+        }
+    }
+    int v = (int)lo;
+
+    // Берем все элементы < v, недостающие - из равных v по порядку серий
+    size_t taken = 0;
+    for (size_t i = 0; i < k; i++)
+    {
+        split[i] = std::lower_bound(runs.begin(i), runs.end(i), v) - runs.begin(i);
+        taken += split[i];
+    }
+    for (size_t i = 0; i < k && taken < rank; i++)
+    {
+        size_t equal = std::upper_bound(runs.begin(i), runs.end(i), v) - runs.begin(i) - split[i];
+        size_t take = std::min(equal, rank - taken);
+        split[i] += take;
+        taken += take;
+    }
+}
+
+// Одна часть слияния группы: элементы выхода [from, to), в серии i
+// берутся позиции [lo[i], hi[i])
+inline void mergePart(const Runs& runs, size_t from, size_t to,
+                      const size_t* lo, const size_t* hi, int* out)
+{
+    size_t k = runs.count();
+    std::vector<const int*> begins(k);
+    std::vector<const int*> ends(k);
+    for (size_t i = 0; i < k; i++)
+    {
+        begins[i] = runs.begin(i) + lo[i];
+        ends[i] = runs.begin(i) + hi[i];
+    }
+
+    LoserTree tree(begins.data(), ends.data(), k);
+    tree.pop(out + from, to - from);
+}
+
+// Серии группы g прохода
+inline Runs groupOf(const int* src, size_t n, size_t runLength, size_t groupLength, size_t g)
+{
+    Runs runs;
+    runs.base = src + g * groupLength;
+    runs.length = std::min(groupLength, n - g * groupLength);
+    runs.runLength = runLength;
+    return runs;
+}
+
+// Проход слияния: src делится на группы по groupRuns серий длины
+// runLength, каждая группа сливается в свой кусок dst
+// Границы частей считаются один раз: parts + 1 границ группы, соседние
+// части делят общую границу
+inline void mergePass(const int* src, int* dst, size_t n, size_t runLength,
+                      size_t groupRuns, size_t partSize, int threads)
+{
+    size_t groupLength = runLength * groupRuns;
+    size_t groups = (n + groupLength - 1) / groupLength;
+
+    // Список границ: (группа, номер, число частей) и место позиций
+    // границы в splits (по одной на серию группы)
+    std::vector<size_t> boundGroup;
+    std::vector<size_t> boundIndex;
+    std::vector<size_t> boundParts;
+    std::vector<size_t> boundOffset;
+    size_t total = 0;
+    for (size_t g = 0; g < groups; g++)
+    {
+        Runs runs = groupOf(src, n, runLength, groupLength, g);
+        size_t parts = (runs.length + partSize - 1) / partSize;
+        for (size_t b = 0; b <= parts; b++)
+        {
+            boundGroup.push_back(g);
+            boundIndex.push_back(b);
+            boundParts.push_back(parts);
+            boundOffset.push_back(total);
+            total += runs.count();
+        }
+    }
+    std::vector<size_t> splits(total);
+
+    #pragma omp parallel num_threads(threads)
+    {
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t j = 0; j < boundGroup.size(); j++)
+        {
+            Runs runs = groupOf(src, n, runLength, groupLength, boundGroup[j]);
+            size_t rank = runs.length * boundIndex[j] / boundParts[j];
+            selectSplits(runs, rank, &splits[boundOffset[j]]);
+        }
+
+        // Часть j - между границами j и j + 1 своей группы
+        // (последняя граница группы части не начинает)
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t j = 0; j < boundGroup.size(); j++)
+        {
+            if (boundIndex[j] == boundParts[j])
+            {
+                continue;
+            }
+            size_t g = boundGroup[j];
+            Runs runs = groupOf(src, n, runLength, groupLength, g);
+            size_t from = runs.length * boundIndex[j] / boundParts[j];
+            size_t to = runs.length * (boundIndex[j] + 1) / boundParts[j];
+            mergePart(runs, from, to, &splits[boundOffset[j]], &splits[boundOffset[j + 1]],
+                      dst + g * groupLength);
+        }
+    }
+}
+
+} // namespace detail
+
+// Сортировка: серии по 64 элемента сетью, затем проходы k-путевого
+// слияния (1 при runs <= MAX_FAN_IN, 2 до MAX_FAN_IN^2 серий и т.д.).
+// Временный буфер берется из арены
+inline Stats mergeSort(int* arr, size_t n, arena::ScratchArena& scratch,
+                       int threads = omp_get_max_threads())
+{
+    Stats stats;
+    stats.mergePasses = 0;
+
+    // Шаг 1: начальные серии (чтение + запись на месте)
+    #pragma omp parallel for schedule(static) num_threads(threads)
+    for (size_t start = 0; start < n; start += RUN_LENGTH)
+    {
+        netsort::sortBlock(arr + start, std::min(RUN_LENGTH, n - start));
+    }
+    stats.bytesPerElement = 2 * sizeof(int);
+
+    size_t runs = (n + RUN_LENGTH - 1) / RUN_LENGTH;
+    if (runs <= 1)
+    {
+        return stats;
+    }
+
+    int* temp = scratch.acquire(n);
+    size_t partSize = std::max(MIN_PART, std::min(MAX_PART, n / (threads * 4 + 1)));
+
+    // Наименьшее число проходов, при котором группа не больше MAX_FAN_IN,
+    // и группа ~runs^(1/passes): проходы получаются равными
+    int passes = 1;
+    for (size_t capacity = MAX_FAN_IN; capacity < runs; capacity *= MAX_FAN_IN)
+    {
+        passes++;
+    }
+    size_t fanIn = (size_t)ceil(pow((double)runs, 1.0 / passes));
+    fanIn = std::min(std::max(fanIn, (size_t)2), MAX_FAN_IN);
+
+    // Проходы попеременно из arr в temp и обратно; в конце результат
+    // копируется в arr, если число проходов нечетное
+    int* src = arr;
+    int* dst = temp;
+    size_t runLength = RUN_LENGTH;
+    while (runs > 1)
+    {
+        size_t groupRuns = std::min(fanIn, runs);
+        detail::mergePass(src, dst, n, runLength, groupRuns, partSize, threads);
+        std::swap(src, dst);
+        runLength *= groupRuns;
+        runs = (runs + groupRuns - 1) / groupRuns;
+        stats.mergePasses++;
+        stats.bytesPerElement += 2 * sizeof(int);
+    }
+    if (src != arr)
+    {
+        memcpy(arr, src, n * sizeof(int));
+        stats.bytesPerElement += 2 * sizeof(int);
+    }
+
+    return stats;
+}
+
+// Байт на элемент у попарного слияния с теми же сериями по 64:
+// серии + по одному чтению и записи на каждый из log2(n/64) уровней.
+// copyBack - если после каждого уровня есть еще копирование (как copyKernel)
+inline double pairwiseBytesPerElement(size_t n, bool copyBack)
+{
+    int levels = 0;
+    for (size_t width = RUN_LENGTH; width < n; width *= 2)
+    {
+        levels++;
+    }
+    return 2 * sizeof(int) * (1 + levels * (copyBack ? 2 : 1));
+}
+
+} // namespace kway
+
+#endif // KWAY_MERGE_H
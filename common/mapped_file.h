@@ -0,0 +1,195 @@
+/*
+ * Отображение двоичных файлов в память (mmap) для бенчмарков.
+ *
+ * Вместо заполнения массива через rand() программа может работать
+ * прямо с файлом реальных данных: "сырые" int32 или float32
+ * в порядке little-endian без заголовка. Данные не разбираются
+ * и не копируются - страницы файла подгружаются ядром по мере чтения.
+ *
+ * Подсказки ядру (madvise):
+ *   - SEQUENTIAL: агрессивное чтение вперед, прочитанные страницы
+ *     можно быстрее вытеснять
+ *   - HUGEPAGE: большие страницы там, где ядро их поддерживает
+ *     (меньше промахов TLB на проходах по гигабайтам)
+ *
+ * Результат можно записать в файл, созданный через create():
+ * программа пишет в отображение, а ядро сбрасывает страницы на диск.
+ */
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mapped
+{
+
+// Подсказки для madvise (объединяются через |)
+enum Advice
+{
+    SEQUENTIAL = 1 << 0,
+    HUGEPAGE   = 1 << 1
+};
+
+// Файлы данных - little-endian; на другой машине их пришлось бы разбирать
+inline bool littleEndianHost()
+{
+    const uint32_t probe = 1;
+    unsigned char first;
+    memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+class File
+{
+public:
+    File() : data(NULL), length(0), shared(false)
+    {
+    }
+
+    ~File()
+    {
+        close();
+    }
+
+    // Только чтение
+    bool openRead(const std::string& path, unsigned advice = SEQUENTIAL | HUGEPAGE)
+    {
+        return map(path, O_RDONLY, PROT_READ, MAP_SHARED, 0, advice);
+    }
+
+    // Новый файл размером bytes; все записи попадают в файл
+    bool create(const std::string& path, size_t bytes, unsigned advice = SEQUENTIAL | HUGEPAGE)
+    {
+        return map(path, O_RDWR | O_CREAT | O_TRUNC, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   bytes, advice);
+    }
+
+    // Сбрасывает изменения на диск и закрывает отображение
+    void close()
+    {
+        if (data != NULL)
+        {
+            if (shared)
+            {
+                msync(data, length, MS_SYNC);
+            }
+            munmap(data, length);
+        }
+        data = NULL;
+        length = 0;
+        shared = false;
+    }
+
+    template <typename T>
+    T* as() const
+    {
+        return (T*)data;
+    }
+
+    // Число элементов типа T в файле
+    template <typename T>
+    size_t count() const
+    {
+        return length / sizeof(T);
+    }
+
+    size_t bytes() const
+    {
+        return length;
+    }
+
+private:
+    bool map(const std::string& path, int flags, int protection, int sharing,
+             size_t createBytes, unsigned advice)
+    {
+        close();
+
+        if (!littleEndianHost())
+        {
+            std::cout << "Файлы данных little-endian, а машина big-endian: " << path << std::endl;
+            return false;
+        }
+
+        int fd = open(path.c_str(), flags, 0644);
+        if (fd < 0)
+        {
+            std::cout << "Не удалось открыть файл " << path << std::endl;
+            return false;
+        }
+
+        size_t size = createBytes;
+        if (flags & O_CREAT)
+        {
+            if (ftruncate(fd, (off_t)size) != 0)
+            {
+                std::cout << "Не удалось задать размер файла " << path << std::endl;
+                ::close(fd);
+                return false;
+            }
+        }
+        else
+        {
+            struct stat info;
+            if (fstat(fd, &info) != 0)
+            {
+                std::cout << "Не удалось узнать размер файла " << path << std::endl;
+                ::close(fd);
+                return false;
+            }
+            size = (size_t)info.st_size;
+        }
+
+        // Пустой файл отобразить нельзя - это просто ноль элементов
+        if (size == 0)
+        {
+            ::close(fd);
+            return true;
+        }
+
+        void* address = mmap(NULL, size, protection, sharing, fd, 0);
+        ::close(fd);  // Отображение держит файл само
+        if (address == MAP_FAILED)
+        {
+            std::cout << "Не удалось отобразить файл " << path << std::endl;
+            return false;
+        }
+
+        data = address;
+        length = size;
+        shared = (sharing & MAP_SHARED) && (protection & PROT_WRITE);
+
+        // Подсказки необязательны: ошибку madvise игнорируем
+        if (advice & SEQUENTIAL)
+        {
+            madvise(data, length, MADV_SEQUENTIAL);
+        }
+#ifdef MADV_HUGEPAGE
+        if (advice & HUGEPAGE)
+        {
+            madvise(data, length, MADV_HUGEPAGE);
+        }
+#endif
+        return true;
+    }
+
+    void* data;
+    size_t length;
+    bool shared;
+
+    // Копировать нельзя: отображение принадлежит объекту
+    File(const File&);
+    File& operator=(const File&);
+};
+
+} // namespace mapped
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,558 @@
+/*
+ * Параллельные сортировки массива int на OpenMP.
+ *
+ * sampleSort - параллельная сортировка выборкой (samplesort):
+ *   1) из массива берется выборка, по ней выбираются разделители
+ *   2) каждый поток считает, сколько его элементов попадает в каждую
+ *      корзину (корзины - промежутки между разделителями)
+ *   3) по префиксным суммам каждый поток знает, куда писать свои
+ *      элементы, и раскладывает их во временный массив без блокировок
+ *   4) корзины сортируются независимо и параллельно (слиянием ниже)
+ *
+ * Весь алгоритм - один параллельный регион и два прохода по памяти,
+ * поэтому он масштабируется на 10^8 - 10^9 элементов.
+ *
+ * Для разделителей, которые встречаются несколько раз (много
+ * одинаковых ключей), заводится отдельная корзина "равно разделителю" -
+ * ее не нужно сортировать, и одна корзина не разрастается до всего массива.
+ *
+ * radixSort - параллельная поразрядная сортировка (LSD radix sort):
+ *   каждый проход сортирует по radixBits битам ключа устойчивой
+ *   раскладкой. Число проходов зависит от максимального ключа:
+ *   для ключей меньше 100000 при 8 битах нужно всего 3 прохода.
+ *   Запись при раскладке идет через программный буфер объединения
+ *   записи (write-combining): для каждой корзины копится одна
+ *   кэш-линия и сбрасывается целиком, что сильно уменьшает промахи
+ *   кэша и TLB при разбросанной записи.
+ *
+ * mergeSort - параллельная сортировка слиянием на задачах OpenMP:
+ *   - один временный буфер на всю сортировку: уровни рекурсии
+ *     попеременно пишут то в массив, то в буфер (ping-pong)
+ *   - маленькие куски (до 64 элементов) сортируются битонической
+ *     сетью AVX2 из sort_network.h (или вставками, если выбрано LEAF_INSERTION)
+ *   - слияние тоже параллельное: выход делится на равные части,
+ *     границы частей во входных массивах находятся бинарным поиском
+ *     (co-ranking), и каждая часть сливается отдельной задачей.
+ *     Поэтому верхние уровни слияния не становятся последовательными.
+ */
+
+#ifndef PARALLEL_SORT_H
+#define PARALLEL_SORT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <omp.h>
+
+#include "reduction.h"
+#include "scratch_arena.h"
+#include "sort_network.h"
+
+namespace psort
+{
+
+// Массивы меньше этого размера сортируются одним потоком
+const size_t SEQUENTIAL_CUTOFF = 1 << 16;
+
+// Корзин на поток: чем больше, тем лучше балансировка
+const int BUCKETS_PER_THREAD = 8;
+
+// Элементов выборки на одну корзину
+const int OVERSAMPLING = 32;
+
+namespace detail
+{
+
+// Номер корзины для значения v
+// Корзина 2*i - значения между разделителями i-1 и i,
+// корзина 2*i+1 - значения, равные разделителю i
+inline int bucketOf(int v, const int* splitters, int count)
+{
+    const int* pos = std::lower_bound(splitters, splitters + count, v);
+    int i = (int)(pos - splitters);
+    return 2 * i + (i < count && *pos == v ? 1 : 0);
+}
+
+// Простое перемешивание индекса (для равномерной выборки без rand)
+inline size_t mixIndex(size_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x;
+}
+
+} // namespace detail
+
+// Допустимое число бит за проход radix sort
+// (при 16 битах буферы потока уже занимают 4 МБ)
+const int RADIX_MIN_BITS = 1;
+const int RADIX_MAX_BITS = 16;
+
+// Элементов int в одной кэш-линии
+const int LINE_INTS = 64 / sizeof(int);
+
+// Параллельная поразрядная сортировка (LSD), radixBits бит за проход
+inline void radixSort(int* arr, size_t n, int radixBits = 8, int threads = omp_get_max_threads())
+{
+    if (n < 2)
+    {
+        return;
+    }
+    if (radixBits < RADIX_MIN_BITS)
+    {
+        radixBits = RADIX_MIN_BITS;
+    }
+    if (radixBits > RADIX_MAX_BITS)
+    {
+        radixBits = RADIX_MAX_BITS;
+    }
+    if (n < SEQUENTIAL_CUTOFF)
+    {
+        threads = 1;
+    }
+
+    // Сколько бит ключа реально нужно сортировать
+    // Отрицательные числа: инвертируем знаковый бит и сортируем все 32 бита
+    reduce::Result<int> range = reduce::compute(arr, n, reduce::MIN | reduce::MAX);
+    unsigned flip = range.min < 0 ? 0x80000000u : 0;
+    int keyBits = 32;
+    if (flip == 0)
+    {
+        keyBits = 0;
+        while (keyBits < 32 && ((unsigned)range.max >> keyBits) != 0)
+        {
+            keyBits++;
+        }
+    }
+    int passes = (keyBits + radixBits - 1) / radixBits;
+    if (passes == 0)
+    {
+        return;  // Все элементы равны нулю
+    }
+
+    const int buckets = 1 << radixBits;
+    const unsigned mask = buckets - 1;
+
+    int* temp = new int[n];
+    std::vector<size_t> counts((size_t)threads * buckets);
+
+    // Буфер за каждым проходом меняется местами с массивом
+    int* src = arr;
+    int* dst = temp;
+    bool skipPass = false;
+
+    #pragma omp parallel num_threads(threads)
+    {
+        int t = omp_get_thread_num();
+        int count = omp_get_num_threads();
+        size_t begin = n * t / count;
+        size_t end = n * (t + 1) / count;
+        size_t* myCounts = &counts[(size_t)t * buckets];
+
+        std::vector<size_t> local(buckets);
+        std::vector<int> fill(buckets);
+        std::vector<int> target(buckets);
+
+        // Буфер объединения записи: одна кэш-линия на корзину
+        int* lines = (int*)aligned_alloc(64, (size_t)buckets * LINE_INTS * sizeof(int));
+
+        for (int pass = 0; pass < passes; pass++)
+        {
+            int shift = pass * radixBits;
+
+            // Гистограмма цифр своего куска
+            std::fill(local.begin(), local.end(), 0);
+            for (size_t i = begin; i < end; i++)
+            {
+                local[(((unsigned)src[i] ^ flip) >> shift) & mask]++;
+            }
+            std::copy(local.begin(), local.end(), myCounts);
+
+            #pragma omp barrier
+
+            // Префиксные суммы: позиция записи каждого потока в каждую корзину
+            #pragma omp single
+            {
+                size_t offset = 0;
+                skipPass = false;
+                for (int b = 0; b < buckets; b++)
+                {
+                    size_t before = offset;
+                    for (int tt = 0; tt < count; tt++)
+                    {
+                        size_t c = counts[(size_t)tt * buckets + b];
+                        counts[(size_t)tt * buckets + b] = offset;
+                        offset += c;
+                    }
+                    // Все элементы в одной корзине - проход ничего не меняет
+                    if (offset - before == n)
+                    {
+                        skipPass = true;
+                    }
+                }
+            }
+
+            if (skipPass)
+            {
+                continue;
+            }
+
+            std::copy(myCounts, myCounts + buckets, local.begin());
+
+            // Первая порция в корзину дополняет строку до границы кэш-линии,
+            // дальше в память пишутся только целые выровненные линии
+            for (int b = 0; b < buckets; b++)
+            {
+                fill[b] = 0;
+                target[b] = LINE_INTS - (int)(((uintptr_t)(dst + local[b]) / sizeof(int)) % LINE_INTS);
+            }
+
+            for (size_t i = begin; i < end; i++)
+            {
+                int v = src[i];
+                unsigned b = (((unsigned)v ^ flip) >> shift) & mask;
+                int* line = lines + b * LINE_INTS;
+                line[fill[b]++] = v;
+                if (fill[b] == target[b])
+                {
+                    memcpy(dst + local[b], line, target[b] * sizeof(int));
+                    local[b] += target[b];
+                    fill[b] = 0;
+                    target[b] = LINE_INTS;
+                }
+            }
+
+            // Сбрасываем неполные линии
+            for (int b = 0; b < buckets; b++)
+            {
+                memcpy(dst + local[b], lines + b * LINE_INTS, fill[b] * sizeof(int));
+            }
+
+            #pragma omp barrier
+
+            #pragma omp single
+            {
+                std::swap(src, dst);
+            }
+        }
+
+        free(lines);
+    }
+
+    // Результат оказался во временном массиве - копируем обратно
+    if (src != arr)
+    {
+        #pragma omp parallel for num_threads(threads)
+        for (size_t i = 0; i < n; i++)
+        {
+            arr[i] = src[i];
+        }
+    }
+
+    delete[] temp;
+}
+
+// Чем сортировать листья сортировки слиянием
+enum LeafSort
+{
+    LEAF_INSERTION,  // вставками, листья до 32 элементов
+    LEAF_NETWORK     // сетью AVX2, листья до 64 элементов
+};
+
+// Размер листа для сортировки вставками
+const size_t INSERTION_CUTOFF = 32;
+
+// Куски меньше этого размера сортируются без создания задач
+const size_t TASK_CUTOFF = 1 << 14;
+
+// Размер части выхода, которую сливает одна задача
+const size_t MERGE_CHUNK = 1 << 16;
+
+namespace detail
+{
+
+// Последовательное устойчивое слияние a[0..na) и b[0..nb) в out
+inline void mergeSequential(const int* a, size_t na, const int* b, size_t nb, int* out)
+{
+    size_t i = 0;
+    size_t j = 0;
+    size_t k = 0;
+    while (i < na && j < nb)
+    {
+        // При равенстве берем из a - слияние устойчивое
+        if (a[i] <= b[j])
+        {
+            out[k++] = a[i++];
+        }
+        else
+        {
+            out[k++] = b[j++];
+        }
+    }
+    if (i < na)
+    {
+        memcpy(out + k, a + i, (na - i) * sizeof(int));
+    }
+    if (j < nb)
+    {
+        memcpy(out + k, b + j, (nb - j) * sizeof(int));
+    }
+}
+
+// Co-ranking: сколько элементов из a попадает в первые k элементов
+// результата слияния a и b (остальные k - i берутся из b)
+inline size_t coRank(size_t k, const int* a, size_t na, const int* b, size_t nb)
+{
+    size_t lo = k > nb ? k - nb : 0;
+    size_t hi = k < na ? k : na;
+
+    // Ищем наибольшее i, при котором a[i-1] <= b[k-i]
+    while (lo < hi)
+    {
+        size_t i = lo + (hi - lo + 1) / 2;
+        if (a[i - 1] <= b[k - i])
+        {
+            lo = i;
+        }
+        else
+        {
+            hi = i - 1;
+        }
+    }
+    return lo;
+}
+
+// Параллельное слияние: выход делится на части по MERGE_CHUNK,
+// каждая часть сливается своей задачей
+inline void mergeParallel(const int* a, size_t na, const int* b, size_t nb, int* out)
+{
+    size_t total = na + nb;
+    if (total <= MERGE_CHUNK)
+    {
+        mergeSequential(a, na, b, nb, out);
+        return;
+    }
+
+    size_t parts = (total + MERGE_CHUNK - 1) / MERGE_CHUNK;
+    for (size_t p = 0; p < parts; p++)
+    {
+        #pragma omp task firstprivate(p)
+        {
+            size_t from = total * p / parts;
+            size_t to = total * (p + 1) / parts;
+            size_t ia = coRank(from, a, na, b, nb);
+            size_t ja = coRank(to, a, na, b, nb);
+            mergeSequential(a + ia, ja - ia, b + (from - ia), (to - ja) - (from - ia), out + from);
+        }
+    }
+    #pragma omp taskwait
+}
+
+// Листья сортировки слиянием
+struct Leaf
+{
+    size_t size;
+    netsort::BlockSort sort;
+
+    explicit Leaf(LeafSort kind)
+    {
+        if (kind == LEAF_NETWORK)
+        {
+            size = netsort::MAX_BLOCK;
+            sort = netsort::blockSort();
+        }
+        else
+        {
+            size = INSERTION_CUTOFF;
+            sort = netsort::insertionSort;
+        }
+    }
+};
+
+// Рекурсивная сортировка src[0..n)
+// toTemp == false - результат в src, true - в temp
+inline void mergeSortRec(int* src, int* temp, size_t n, bool toTemp, const Leaf& leaf)
+{
+    if (n <= leaf.size)
+    {
+        leaf.sort(src, n);
+        if (toTemp)
+        {
+            memcpy(temp, src, n * sizeof(int));
+        }
+        return;
+    }
+
+    // Половины сортируем в другой буфер, затем сливаем в нужный
+    size_t half = n / 2;
+    if (n > TASK_CUTOFF)
+    {
+        #pragma omp task
+        mergeSortRec(src, temp, half, !toTemp, leaf);
+        mergeSortRec(src + half, temp + half, n - half, !toTemp, leaf);
+        #pragma omp taskwait
+    }
+    else
+    {
+        mergeSortRec(src, temp, half, !toTemp, leaf);
+        mergeSortRec(src + half, temp + half, n - half, !toTemp, leaf);
+    }
+
+    const int* from = toTemp ? src : temp;
+    int* to = toTemp ? temp : src;
+    if (n > TASK_CUTOFF)
+    {
+        mergeParallel(from, half, from + half, n - half, to);
+    }
+    else
+    {
+        mergeSequential(from, half, from + half, n - half, to);
+    }
+}
+
+} // namespace detail
+
+// Параллельная сортировка слиянием
+// Буфер размера n на всю сортировку берется из арены scratch
+inline void mergeSort(int* arr, size_t n, arena::ScratchArena& scratch,
+                      int threads = omp_get_max_threads(), LeafSort leaf = LEAF_NETWORK)
+{
+    if (n < 2)
+    {
+        return;
+    }
+
+    int* temp = scratch.acquire(n);
+    detail::Leaf leafSort(leaf);
+
+    #pragma omp parallel num_threads(threads)
+    #pragma omp single
+    detail::mergeSortRec(arr, temp, n, false, leafSort);
+}
+
+// То же со своей ареной (одно выделение памяти на сортировку)
+inline void mergeSort(int* arr, size_t n, int threads = omp_get_max_threads(),
+                      LeafSort leaf = LEAF_NETWORK)
+{
+    arena::ScratchArena scratch;
+    mergeSort(arr, n, scratch, threads, leaf);
+}
+
+// Параллельная сортировка выборкой
+inline void sampleSort(int* arr, size_t n, int threads = omp_get_max_threads())
+{
+    if (n < SEQUENTIAL_CUTOFF || threads <= 1)
+    {
+        std::sort(arr, arr + n);
+        return;
+    }
+
+    // ===== Шаг 1: выборка и разделители =====
+    int wanted = threads * BUCKETS_PER_THREAD;
+    std::vector<int> sample((size_t)wanted * OVERSAMPLING);
+    for (size_t i = 0; i < sample.size(); i++)
+    {
+        sample[i] = arr[detail::mixIndex(i + 1) % n];
+    }
+    std::sort(sample.begin(), sample.end());
+
+    std::vector<int> splitters;
+    for (int i = 1; i < wanted; i++)
+    {
+        splitters.push_back(sample[(size_t)i * OVERSAMPLING]);
+    }
+    splitters.erase(std::unique(splitters.begin(), splitters.end()), splitters.end());
+
+    const int splitterCount = (int)splitters.size();
+    const int buckets = 2 * splitterCount + 1;
+
+    // Номер корзины каждого элемента, чтобы не искать его дважды
+    // (new без инициализации: страницы заполнят сами потоки)
+    unsigned short* bucketIds = new unsigned short[n];
+    int* temp = new int[n];
+
+    // counts[t * buckets + b] - сколько элементов потока t в корзине b,
+    // после префиксной суммы - позиция, с которой поток t пишет в корзину b
+    std::vector<size_t> counts((size_t)threads * buckets, 0);
+    std::vector<size_t> bucketStart(buckets + 1, 0);
+    detail::Leaf leaf(LEAF_NETWORK);
+
+    #pragma omp parallel num_threads(threads)
+    {
+        int t = omp_get_thread_num();
+        int count = omp_get_num_threads();
+        size_t begin = n * t / count;
+        size_t end = n * (t + 1) / count;
+        size_t* myCounts = &counts[(size_t)t * buckets];
+
+        // ===== Шаг 2: гистограмма потока =====
+        // Считаем в локальный массив, чтобы соседние потоки
+        // не писали в одну кэш-линию
+        std::vector<size_t> local(buckets, 0);
+        for (size_t i = begin; i < end; i++)
+        {
+            int b = detail::bucketOf(arr[i], splitters.data(), splitterCount);
+            bucketIds[i] = (unsigned short)b;
+            local[b]++;
+        }
+        std::copy(local.begin(), local.end(), myCounts);
+
+        #pragma omp barrier
+
+        // ===== Шаг 3: префиксные суммы (делает один поток) =====
+        #pragma omp single
+        {
+            size_t offset = 0;
+            for (int b = 0; b < buckets; b++)
+            {
+                bucketStart[b] = offset;
+                for (int tt = 0; tt < count; tt++)
+                {
+                    size_t c = counts[(size_t)tt * buckets + b];
+                    counts[(size_t)tt * buckets + b] = offset;
+                    offset += c;
+                }
+            }
+            bucketStart[buckets] = offset;
+        }
+
+        // Раскладываем элементы по корзинам
+        std::copy(myCounts, myCounts + buckets, local.begin());
+        for (size_t i = begin; i < end; i++)
+        {
+            temp[local[bucketIds[i]]++] = arr[i];
+        }
+
+        #pragma omp barrier
+
+        // ===== Шаг 4: сортировка корзин =====
+        // Корзина сортируется слиянием из temp сразу в arr (свой кусок arr
+        // служит вторым буфером), листья - сетью из sort_network.h.
+        // Корзины "равно разделителю" уже отсортированы - их только копируем
+        #pragma omp for schedule(dynamic, 1)
+        for (int b = 0; b < buckets; b++)
+        {
+            size_t from = bucketStart[b];
+            size_t to = bucketStart[b + 1];
+            if (b % 2 == 0 && to - from > 1)
+            {
+                detail::mergeSortRec(temp + from, arr + from, to - from, true, leaf);
+            }
+            else
+            {
+                memcpy(arr + from, temp + from, (to - from) * sizeof(int));
+            }
+        }
+    }
+
+    delete[] bucketIds;
+    delete[] temp;
+}
+
+} // namespace psort
+
+#endif // PARALLEL_SORT_H
@@ -0,0 +1,391 @@
+/*
+ * Аппаратные счетчики производительности (Linux perf_event_open)
+ * вокруг замеряемых участков.
+ *
+ * Время показывает, что участок упирается в потолок, но не почему.
+ * Счетчики за каждый участок и каждый поток отвечают на это:
+ *   - циклы и инструкции, IPC = инструкции / циклы (низкий IPC -
+ *     ядро ждет память или зависимости)
+ *   - промахи последнего уровня кэша (LLC) на чтение - упор в память
+ *   - промахи предсказания ветвлений
+ *   - время CPU потока (task-clock): если оно заметно меньше времени
+ *     участка, поток простаивал на синхронизации
+ *
+ * Счетчики открываются каждым потоком OpenMP для себя (pid = 0,
+ * cpu = -1) по одному, без группы: недоступный счетчик (виртуальная
+ * машина, perf_event_paranoid) просто выводится как "н/д", а при
+ * мультиплексировании значения масштабируются по времени работы.
+ * Считается только пользовательский режим (exclude_kernel).
+ *
+ * Включается при сборке: -DPERF_COUNTERS=1 (make PERF=1). Без этого
+ * Region - пустой класс, print() ничего не делает, и код участков
+ * компилируется в то же самое, что и без счетчиков.
+ */
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#ifndef PERF_COUNTERS
+#define PERF_COUNTERS 0
+#endif
+
+#if PERF_COUNTERS
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <omp.h>
+#endif
+
+namespace perf
+{
+
+#if PERF_COUNTERS
+
+enum Event
+{
+    CYCLES,
+    INSTRUCTIONS,
+    LLC_MISSES,
+    BRANCH_MISSES,
+    TASK_CLOCK,
+    EVENT_COUNT
+};
+
+inline const char* eventName(int e)
+{
+    static const char* const names[EVENT_COUNT] = {
+        "циклы", "инструкции", "промахи LLC", "промахи ветвлений", "время CPU"
+    };
+    return names[e];
+}
+
+// Значения счетчиков; valid[e] = false - счетчик недоступен
+struct Counts
+{
+    double value[EVENT_COUNT];
+    bool valid[EVENT_COUNT];
+
+    Counts()
+    {
+        for (int e = 0; e < EVENT_COUNT; e++)
+        {
+            value[e] = 0;
+            valid[e] = true;
+        }
+    }
+
+    void add(const Counts& other)
+    {
+        for (int e = 0; e < EVENT_COUNT; e++)
+        {
+            value[e] += other.value[e];
+            valid[e] = valid[e] && other.valid[e];
+        }
+    }
+};
+
+namespace detail
+{
+
+inline void describe(int e, perf_event_attr& attr)
+{
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    switch (e)
+    {
+    case CYCLES:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    case INSTRUCTIONS:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+    case LLC_MISSES:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                      | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+    case BRANCH_MISSES:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+    default:
+        attr.type = PERF_TYPE_SOFTWARE;
+        attr.config = PERF_COUNT_SW_TASK_CLOCK;  // Наносекунды
+        break;
+    }
+}
+
+// Счетчики одного потока; открываются при первом чтении
+class ThreadCounters
+{
+public:
+    ThreadCounters() : opened(false)
+    {
+        for (int e = 0; e < EVENT_COUNT; e++)
+        {
+            fd[e] = -1;
+        }
+    }
+
+    ~ThreadCounters()
+    {
+        for (int e = 0; e < EVENT_COUNT; e++)
+        {
+            if (fd[e] >= 0)
+            {
+                close(fd[e]);
+            }
+        }
+    }
+
+    void read(Counts& counts)
+    {
+        if (!opened)
+        {
+            open();
+        }
+        for (int e = 0; e < EVENT_COUNT; e++)
+        {
+            // value, time_enabled, time_running
+            uint64_t data[3];
+            if (fd[e] < 0 || ::read(fd[e], data, sizeof(data)) != (ssize_t)sizeof(data))
+            {
+                counts.valid[e] = false;
+                counts.value[e] = 0;
+                continue;
+            }
+            // Счетчик делил оборудование с другими - масштабируем
+            counts.value[e] = data[2] > 0 ? (double)data[0] * data[1] / data[2] : 0;
+        }
+    }
+
+private:
+    void open()
+    {
+        opened = true;
+        for (int e = 0; e < EVENT_COUNT; e++)
+        {
+            perf_event_attr attr;
+            describe(e, attr);
+            fd[e] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+            if (fd[e] < 0)
+            {
+                reportFailure(e, errno);
+            }
+        }
+    }
+
+    // Сообщение о недоступном счетчике - один раз на счетчик
+    static void reportFailure(int e, int error)
+    {
+        static bool reported[EVENT_COUNT];
+        bool first = false;
+        #pragma omp critical(perf_report)
+        {
+            first = !reported[e];
+            reported[e] = true;
+        }
+        if (first)
+        {
+            fprintf(stderr, "Счетчик \"%s\" недоступен: %s\n", eventName(e), strerror(error));
+        }
+    }
+
+    int fd[EVENT_COUNT];
+    bool opened;
+};
+
+inline ThreadCounters& threadCounters()
+{
+    static thread_local ThreadCounters counters;
+    return counters;
+}
+
+// Накопленные счетчики участка по потокам
+struct Entry
+{
+    long calls;
+    std::vector<Counts> threads;
+
+    Entry() : calls(0)
+    {
+    }
+};
+
+inline std::map<std::string, Entry>& registry()
+{
+    static std::map<std::string, Entry> entries;
+    return entries;
+}
+
+// Чтение счетчиков всеми потоками текущей команды OpenMP
+inline void readAll(std::vector<Counts>& counts)
+{
+    int threads = omp_get_max_threads();
+    counts.assign(threads, Counts());
+    #pragma omp parallel num_threads(threads)
+    {
+        threadCounters().read(counts[omp_get_thread_num()]);
+    }
+}
+
+} // namespace detail
+
+// Участок кода: счетчики всех потоков читаются при создании и в stop()
+// (или в деструкторе), разность копится под именем name.
+// name = NULL - участок не замеряется
+class Region
+{
+public:
+    explicit Region(const char* name) : name(name)
+    {
+        if (name != NULL)
+        {
+            detail::readAll(start);
+        }
+    }
+
+    ~Region()
+    {
+        stop();
+    }
+
+    void stop()
+    {
+        if (name == NULL)
+        {
+            return;
+        }
+        std::vector<Counts> end;
+        detail::readAll(end);
+
+        detail::Entry& entry = detail::registry()[name];
+        entry.calls++;
+        if (entry.threads.size() < end.size())
+        {
+            entry.threads.resize(end.size());
+        }
+        for (size_t t = 0; t < end.size() && t < start.size(); t++)
+        {
+            Counts delta;
+            for (int e = 0; e < EVENT_COUNT; e++)
+            {
+                delta.value[e] = end[t].value[e] - start[t].value[e];
+                delta.valid[e] = end[t].valid[e] && start[t].valid[e];
+            }
+            entry.threads[t].add(delta);
+        }
+        name = NULL;
+    }
+
+private:
+    const char* name;
+    std::vector<Counts> start;
+
+    Region(const Region&);
+    Region& operator=(const Region&);
+};
+
+namespace detail
+{
+
+inline void printCounts(const char* label, const Counts& c, double calls)
+{
+    char text[64];
+    std::cout << label;
+    for (int e = 0; e < EVENT_COUNT; e++)
+    {
+        if (!c.valid[e])
+        {
+            snprintf(text, sizeof(text), "н/д");
+        }
+        else if (e == TASK_CLOCK)
+        {
+            snprintf(text, sizeof(text), "%.3g мс", c.value[e] / calls / 1e6);
+        }
+        else
+        {
+            snprintf(text, sizeof(text), "%.3g", c.value[e] / calls);
+        }
+        std::cout << (e == 0 ? "" : ", ") << eventName(e) << " " << text;
+    }
+    if (c.valid[CYCLES] && c.valid[INSTRUCTIONS] && c.value[CYCLES] > 0)
+    {
+        snprintf(text, sizeof(text), "%.2f", c.value[INSTRUCTIONS] / c.value[CYCLES]);
+        std::cout << ", IPC " << text;
+    }
+    std::cout << std::endl;
+}
+
+} // namespace detail
+
+// Вывод счетчиков участка name (на один запуск) и сброс накопленного
+inline void print(const char* name)
+{
+    std::map<std::string, detail::Entry>::iterator it = detail::registry().find(name);
+    if (it == detail::registry().end() || it->second.calls == 0)
+    {
+        return;
+    }
+    const detail::Entry& entry = it->second;
+    double calls = (double)entry.calls;
+
+    Counts total;
+    for (size_t t = 0; t < entry.threads.size(); t++)
+    {
+        total.add(entry.threads[t]);
+    }
+    detail::printCounts("  Счетчики (на запуск): ", total, calls);
+
+    // По потокам - только если потоков несколько
+    if (entry.threads.size() > 1)
+    {
+        for (size_t t = 0; t < entry.threads.size(); t++)
+        {
+            char label[48];
+            snprintf(label, sizeof(label), "    поток %zu: ", t);
+            detail::printCounts(label, entry.threads[t], calls);
+        }
+    }
+    detail::registry().erase(it);
+}
+
+#else // PERF_COUNTERS
+
+// Счетчики выключены: пустые заглушки
+class Region
+{
+public:
+    explicit Region(const char*)
+    {
+    }
+
+    void stop()
+    {
+    }
+};
+
+inline void print(const char*)
+{
+}
+
+#endif // PERF_COUNTERS
+
+} // namespace perf
+
+#endif // PERF_COUNTERS_H
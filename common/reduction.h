@@ -0,0 +1,420 @@
+/*
+ * Обобщенная параллельная редукция массива.
+ *
+ * За один проход по памяти считает любой набор статистик:
+ *   - минимум и максимум (и их индексы)
+ *   - сумму, среднее и дисперсию
+ *   - гистограмму с фиксированными корзинами
+ *
+ * Поддерживаются типы int, long long, float и double.
+ *
+ * Каждый поток OpenMP получает непрерывный кусок массива и копит
+ * результаты в своем аккумуляторе. Аккумуляторы выровнены по
+ * кэш-линии (64 байта), чтобы потоки не мешали друг другу
+ * (false sharing). В конце аккумуляторы объединяются по порядку
+ * потоков, поэтому индексы argmin/argmax всегда указывают на первое
+ * вхождение - так же, как в последовательной версии.
+ *
+ * Для int, когда нужны только min/max, используется SIMD ядро
+ * из simd_minmax.h.
+ *
+ * Пример:
+ *   reduce::Result<double> r = reduce::compute(data, n, reduce::ARGMIN | reduce::MEAN);
+ */
+
+#ifndef REDUCTION_H
+#define REDUCTION_H
+
+#include <cstddef>
+#include <vector>
+#include <omp.h>
+
+#include "simd_minmax.h"
+
+namespace reduce
+{
+
+// Статистики, которые можно запросить (объединяются через |)
+enum Stat
+{
+    MIN       = 1 << 0,
+    MAX       = 1 << 1,
+    ARGMIN    = 1 << 2,
+    ARGMAX    = 1 << 3,
+    SUM       = 1 << 4,
+    MEAN      = 1 << 5,
+    VARIANCE  = 1 << 6,
+    HISTOGRAM = 1 << 7,
+
+    ALL = MIN | MAX | ARGMIN | ARGMAX | SUM | MEAN | VARIANCE | HISTOGRAM
+};
+
+// Размер кэш-линии
+const size_t CACHE_LINE = 64;
+
+// Тип суммы: для int и long long сумма считается точно в long long,
+// для float и double - в double
+template <typename T>
+struct SumType
+{
+    typedef double type;
+};
+
+template <>
+struct SumType<int>
+{
+    typedef long long type;
+};
+
+// Сумма long long точна, пока она помещается в long long (|сумма| < 2^63);
+// переполнение не проверяется, как и у последовательного цикла
+template <>
+struct SumType<long long>
+{
+    typedef long long type;
+};
+
+// Параметры гистограммы: buckets равных корзин на [lo, hi)
+// Значения вне диапазона считаются в underflow/overflow
+struct HistogramSpec
+{
+    double lo;
+    double hi;
+    int buckets;
+};
+
+// Настройки редукции
+struct Options
+{
+    // false - считать в одном потоке (последовательная версия)
+    bool parallel;
+
+    // Гистограмма (нужна только вместе с HISTOGRAM)
+    HistogramSpec histogram;
+
+    // Ядро min/max для int; NULL - выбор по CPUID
+    simd::MinMaxKernel minMaxKernel;
+
+    Options() : parallel(true), minMaxKernel(NULL)
+    {
+        histogram.lo = 0;
+        histogram.hi = 0;
+        histogram.buckets = 0;
+    }
+};
+
+// Результат редукции
+// Заполнены только поля запрошенных статистик
+template <typename T>
+struct Result
+{
+    size_t count;
+
+    T min;
+    T max;
+    size_t argmin;
+    size_t argmax;
+
+    typename SumType<T>::type sum;
+    double mean;
+    double variance;  // Дисперсия генеральной совокупности (деление на n)
+
+    std::vector<size_t> histogram;
+    size_t underflow;
+    size_t overflow;
+};
+
+namespace detail
+{
+
+// Аккумулятор одного потока
+// alignas(64) - каждый аккумулятор занимает свои кэш-линии
+template <typename T>
+struct alignas(CACHE_LINE) Accumulator
+{
+    size_t count;
+    T min;
+    T max;
+    size_t argmin;
+    size_t argmax;
+    typename SumType<T>::type sum;
+
+    // Сумма и сумма квадратов отклонений от сдвига shift
+    // (сдвиг на первый элемент массива сохраняет точность дисперсии)
+    double shiftedSum;
+    double shiftedSq;
+
+    size_t underflow;
+    size_t overflow;
+};
+
+// Проход по куску [begin, end) с нужным набором статистик
+// Набор известен на этапе компиляции - лишней работы в цикле нет
+template <typename T, bool Arg, bool Sum, bool Var, bool Hist>
+void sweep(const T* data, size_t begin, size_t end, Accumulator<T>& acc,
+           double shift, const HistogramSpec& spec, size_t* bins)
+{
+    T mn = data[begin];
+    T mx = data[begin];
+    size_t imn = begin;
+    size_t imx = begin;
+    typename SumType<T>::type sum = 0;
+    double s1 = 0;
+    double s2 = 0;
+    size_t under = 0;
+    size_t over = 0;
+    double scale = Hist ? spec.buckets / (spec.hi - spec.lo) : 0;
+
+    for (size_t i = begin; i < end; i++)
+    {
+        T v = data[i];
+
+        if (Arg)
+        {
+            // Строгое сравнение - запоминаем первое вхождение
+            if (v < mn)
+            {
+                mn = v;
+                imn = i;
+            }
+            if (v > mx)
+            {
+                mx = v;
+                imx = i;
+            }
+        }
+        else
+        {
+            mn = v < mn ? v : mn;
+            mx = v > mx ? v : mx;
+        }
+
+        if (Sum)
+        {
+            sum += v;
+        }
+
+        if (Var)
+        {
+            double d = (double)v - shift;
+            s1 += d;
+            s2 += d * d;
+        }
+
+        if (Hist)
+        {
+            double x = (double)v;
+            if (x < spec.lo)
+            {
+                under++;
+            }
+            else if (x >= spec.hi)
+            {
+                over++;
+            }
+            else
+            {
+                int b = (int)((x - spec.lo) * scale);
+                bins[b < spec.buckets ? b : spec.buckets - 1]++;
+            }
+        }
+    }
+
+    acc.count = end - begin;
+    acc.min = mn;
+    acc.max = mx;
+    acc.argmin = imn;
+    acc.argmax = imx;
+    acc.sum = sum;
+    acc.shiftedSum = s1;
+    acc.shiftedSq = s2;
+    acc.underflow = under;
+    acc.overflow = over;
+}
+
+template <typename T>
+struct Sweep
+{
+    typedef void (*Fn)(const T*, size_t, size_t, Accumulator<T>&,
+                       double, const HistogramSpec&, size_t*);
+
+    // Индекс в таблице: Arg | Sum << 1 | Var << 2 | Hist << 3
+    static Fn select(unsigned index)
+    {
+        static const Fn table[16] = {
+            sweep<T, false, false, false, false>, sweep<T, true,  false, false, false>,
+            sweep<T, false, true,  false, false>, sweep<T, true,  true,  false, false>,
+            sweep<T, false, false, true,  false>, sweep<T, true,  false, true,  false>,
+            sweep<T, false, true,  true,  false>, sweep<T, true,  true,  true,  false>,
+            sweep<T, false, false, false, true>,  sweep<T, true,  false, false, true>,
+            sweep<T, false, true,  false, true>,  sweep<T, true,  true,  false, true>,
+            sweep<T, false, false, true,  true>,  sweep<T, true,  false, true,  true>,
+            sweep<T, false, true,  true,  true>,  sweep<T, true,  true,  true,  true>,
+        };
+        return table[index];
+    }
+};
+
+// Проход только для min/max: для int берем SIMD ядро
+template <typename T>
+inline bool sweepMinMaxSimd(const T*, size_t, size_t, Accumulator<T>&, simd::MinMaxKernel)
+{
+    return false;
+}
+
+template <>
+inline bool sweepMinMaxSimd<int>(const int* data, size_t begin, size_t end,
+                                 Accumulator<int>& acc, simd::MinMaxKernel kernel)
+{
+    acc = Accumulator<int>();
+    acc.count = end - begin;
+    acc.min = data[begin];
+    acc.max = data[begin];
+    acc.argmin = begin;
+    acc.argmax = begin;
+    kernel(data + begin, end - begin, acc.min, acc.max);
+    return true;
+}
+
+} // namespace detail
+
+// Главная функция: считает статистики stats для data[0..n)
+template <typename T>
+Result<T> compute(const T* data, size_t n, unsigned stats, const Options& options = Options())
+{
+    using detail::Accumulator;
+
+    // Зависимости между статистиками
+    bool needArg = (stats & (ARGMIN | ARGMAX)) != 0;
+    bool needVar = (stats & VARIANCE) != 0;
+    bool needSum = (stats & (SUM | MEAN)) != 0;
+    bool needHist = (stats & HISTOGRAM) != 0 && options.histogram.buckets > 0
+                    && options.histogram.hi > options.histogram.lo;
+
+    Result<T> result = Result<T>();
+    if (needHist)
+    {
+        result.histogram.assign(options.histogram.buckets, 0);
+    }
+    if (n == 0)
+    {
+        return result;
+    }
+
+    int threads = options.parallel ? omp_get_max_threads() : 1;
+    if ((size_t)threads > n)
+    {
+        threads = (int)n;
+    }
+
+    std::vector<Accumulator<T> > acc(threads);
+
+    // Гистограммы потоков лежат в одном буфере, каждая строка
+    // дополнена до целого числа кэш-линий
+    size_t stride = 0;
+    std::vector<size_t> bins;
+    size_t* rows = NULL;
+    if (needHist)
+    {
+        const size_t perLine = CACHE_LINE / sizeof(size_t);
+        stride = (options.histogram.buckets + perLine - 1) / perLine * perLine;
+        bins.assign(stride * threads + perLine, 0);
+
+        // Сдвигаем начало до границы кэш-линии
+        size_t skew = (size_t)bins.data() / sizeof(size_t) % perLine;
+        rows = bins.data() + (skew == 0 ? 0 : perLine - skew);
+    }
+
+    simd::MinMaxKernel kernel = options.minMaxKernel ? options.minMaxKernel : simd::minMaxKernel();
+    typename detail::Sweep<T>::Fn fn = detail::Sweep<T>::select(
+        (needArg ? 1 : 0) | (needSum ? 2 : 0) | (needVar ? 4 : 0) | (needHist ? 8 : 0));
+    bool minMaxOnly = !needArg && !needSum && !needVar && !needHist;
+    double shift = (double)data[0];
+
+    #pragma omp parallel num_threads(threads)
+    {
+        int t = omp_get_thread_num();
+        int count = omp_get_num_threads();
+        size_t begin = n * t / count;
+        size_t end = n * (t + 1) / count;
+
+        // Своя строка гистограммы у каждого потока
+        size_t* row = needHist ? rows + stride * t : NULL;
+
+        acc[t].count = 0;
+        if (begin < end)
+        {
+            if (!(minMaxOnly && detail::sweepMinMaxSimd(data, begin, end, acc[t], kernel)))
+            {
+                fn(data, begin, end, acc[t], shift, options.histogram, row);
+            }
+        }
+    }
+
+    // Объединение по порядку потоков
+    double s1 = 0;
+    double s2 = 0;
+    bool first = true;
+    for (int t = 0; t < threads; t++)
+    {
+        const Accumulator<T>& a = acc[t];
+        if (a.count == 0)
+        {
+            continue;
+        }
+
+        if (first || a.min < result.min)
+        {
+            result.min = a.min;
+            result.argmin = a.argmin;
+        }
+        if (first || a.max > result.max)
+        {
+            result.max = a.max;
+            result.argmax = a.argmax;
+        }
+        first = false;
+
+        result.count += a.count;
+        result.sum += a.sum;
+        result.underflow += a.underflow;
+        result.overflow += a.overflow;
+        s1 += a.shiftedSum;
+        s2 += a.shiftedSq;
+    }
+
+    if (needSum)
+    {
+        result.mean = (double)result.sum / result.count;
+    }
+    if (needVar)
+    {
+        double m = s1 / result.count;
+        if (!needSum)
+        {
+            result.mean = shift + m;
+        }
+        result.variance = s2 / result.count - m * m;
+        if (result.variance < 0)
+        {
+            result.variance = 0;
+        }
+    }
+    if (needHist)
+    {
+        for (int t = 0; t < threads; t++)
+        {
+            const size_t* row = rows + stride * t;
+            for (int b = 0; b < options.histogram.buckets; b++)
+            {
+                result.histogram[b] += row[b];
+            }
+        }
+    }
+
+    return result;
+}
+
+} // namespace reduce
+
+#endif // REDUCTION_H
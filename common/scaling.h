@@ -0,0 +1,513 @@
+/*
+ * Режим масштабирования: повтор замера при 1..N потоках OpenMP.
+ *
+ *   - сильное масштабирование (STRONG): размер задачи фиксирован,
+ *     ускорение S(p) = T(1) / T(p), эффективность E(p) = S(p) / p
+ *   - слабое масштабирование (WEAK): размер растет вместе с числом
+ *     потоков (база * p), эффективность E(p) = T(1) / T(p),
+ *     масштабированное ускорение p * E(p)
+ *
+ * Без привязки потоки OpenMP кочуют между ядрами и сокетами, а данные,
+ * заполненные одним потоком, лежат в памяти одного узла NUMA - на
+ * двухсокетной машине ускорение тогда показывает не алгоритм, а то,
+ * где оказались страницы. Поэтому здесь:
+ *   - каждый поток привязывается к своему процессору (sched_setaffinity):
+ *     COMPACT - подряд по узлам NUMA, SPREAD - по очереди на каждый узел,
+ *     NODE - только процессоры одного узла
+ *   - массивы инициализируются теми же потоками и тем же разбиением,
+ *     что и замеряемый код (first touch): страница попадает на узел
+ *     потока, который первым ее записал
+ *
+ * Топология берется из /sys/devices/system/node; если ее нет, все
+ * доступные процессоры считаются одним узлом.
+ */
+
+#ifndef SCALING_H
+#define SCALING_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sched.h>
+#include <omp.h>
+
+#include "bench.h"
+
+namespace scaling
+{
+
+// Виды масштабирования (объединяются через |)
+enum Mode
+{
+    STRONG = 1 << 0,
+    WEAK   = 1 << 1
+};
+
+// Привязка потоков к процессорам
+enum Placement
+{
+    PIN_NONE,     // Без привязки (как решит ОС)
+    PIN_COMPACT,  // Подряд: сначала все процессоры узла 0, потом узла 1...
+    PIN_SPREAD,   // По очереди: узел 0, узел 1, ..., снова узел 0
+    PIN_NODE      // Только процессоры узла node
+};
+
+struct Options
+{
+    unsigned modes;       // 0 - режим выключен
+    Placement placement;
+    int node;             // Для PIN_NODE
+
+    Options() : modes(0), placement(PIN_COMPACT), node(0)
+    {
+    }
+};
+
+// Узлы NUMA: номера доступных процессоров каждого узла
+struct Topology
+{
+    std::vector<std::vector<int> > nodes;
+
+    int cpuCount() const
+    {
+        int count = 0;
+        for (size_t i = 0; i < nodes.size(); i++)
+        {
+            count += (int)nodes[i].size();
+        }
+        return count;
+    }
+};
+
+inline const char* placementName(Placement p)
+{
+    switch (p)
+    {
+        case PIN_COMPACT: return "compact";
+        case PIN_SPREAD:  return "spread";
+        case PIN_NODE:    return "node";
+        default:          return "none";
+    }
+}
+
+namespace detail
+{
+
+// Разбор списка вида "0-3,8-11" из cpulist
+inline std::vector<int> parseCpuList(const char* text)
+{
+    std::vector<int> cpus;
+    const char* p = text;
+    while (*p)
+    {
+        char* end;
+        long first = strtol(p, &end, 10);
+        if (end == p)
+        {
+            break;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-')
+        {
+            last = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; cpu++)
+        {
+            cpus.push_back((int)cpu);
+        }
+        while (*p == ',' || *p == '\n' || *p == ' ')
+        {
+            p++;
+        }
+    }
+    return cpus;
+}
+
+// Процессоры, на которых процессу разрешено работать. Маска
+// запоминается при первом вызове: после привязки маска главного
+// потока сужается до одного процессора
+inline bool allowedCpus(cpu_set_t& set)
+{
+    static cpu_set_t saved;
+    static bool ok = sched_getaffinity(0, sizeof(saved), &saved) == 0;
+    set = saved;
+    return ok;
+}
+
+} // namespace detail
+
+// Узлы NUMA с процессорами, доступными процессу
+inline Topology detectTopology()
+{
+    Topology topo;
+    cpu_set_t allowed;
+    bool haveMask = detail::allowedCpus(allowed);
+
+    // Узлы могут идти с пропусками (node0, node2), поэтому читаем каталог
+    std::vector<int> ids;
+    DIR* dir = opendir("/sys/devices/system/node");
+    if (dir != NULL)
+    {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL)
+        {
+            int id;
+            char tail;
+            if (sscanf(entry->d_name, "node%d%c", &id, &tail) == 1)
+            {
+                ids.push_back(id);
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(ids.begin(), ids.end());
+
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        char path[96];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", ids[i]);
+        FILE* f = fopen(path, "r");
+        if (f == NULL)
+        {
+            continue;
+        }
+        char text[4096] = "";
+        if (fgets(text, sizeof(text), f) == NULL)
+        {
+            text[0] = '\0';
+        }
+        fclose(f);
+
+        std::vector<int> cpus;
+        std::vector<int> listed = detail::parseCpuList(text);
+        for (size_t c = 0; c < listed.size(); c++)
+        {
+            if (!haveMask || (listed[c] < CPU_SETSIZE && CPU_ISSET(listed[c], &allowed)))
+            {
+                cpus.push_back(listed[c]);
+            }
+        }
+        if (!cpus.empty())
+        {
+            topo.nodes.push_back(cpus);
+        }
+    }
+
+    // Нет сведений о NUMA - один узел из всех доступных процессоров
+    if (topo.nodes.empty())
+    {
+        std::vector<int> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (haveMask && CPU_ISSET(cpu, &allowed))
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        if (cpus.empty())
+        {
+            cpus.push_back(0);
+        }
+        topo.nodes.push_back(cpus);
+    }
+    return topo;
+}
+
+// Порядок процессоров для потоков 0, 1, 2, ... при данной привязке
+inline std::vector<int> cpuOrder(const Topology& topo, Placement placement, int node)
+{
+    std::vector<int> order;
+    if (placement == PIN_NODE)
+    {
+        if (node >= 0 && node < (int)topo.nodes.size())
+        {
+            order = topo.nodes[node];
+        }
+    }
+    else if (placement == PIN_SPREAD)
+    {
+        for (size_t i = 0; order.size() < (size_t)topo.cpuCount(); i++)
+        {
+            for (size_t n = 0; n < topo.nodes.size(); n++)
+            {
+                if (i < topo.nodes[n].size())
+                {
+                    order.push_back(topo.nodes[n][i]);
+                }
+            }
+        }
+    }
+    else
+    {
+        for (size_t n = 0; n < topo.nodes.size(); n++)
+        {
+            order.insert(order.end(), topo.nodes[n].begin(), topo.nodes[n].end());
+        }
+    }
+    return order;
+}
+
+// Задает число потоков и привязывает каждый поток команды OpenMP
+// к своему процессору. Команда потоков в libgomp переиспользуется,
+// поэтому привязка сохраняется для следующих параллельных регионов
+// с тем же числом потоков. PIN_NONE снимает прежнюю привязку.
+// false - ОС отказала в привязке хотя бы одному потоку
+inline bool pinThreads(int threads, Placement placement, const std::vector<int>& cpus)
+{
+    omp_set_num_threads(threads);
+
+    cpu_set_t allowed;
+    detail::allowedCpus(allowed);
+    bool ok = true;
+
+    #pragma omp parallel num_threads(threads) reduction(&&:ok)
+    {
+        cpu_set_t set = allowed;
+        if (placement != PIN_NONE && !cpus.empty())
+        {
+            CPU_ZERO(&set);
+            CPU_SET(cpus[omp_get_thread_num() % cpus.size()], &set);
+        }
+        ok = sched_setaffinity(0, sizeof(set), &set) == 0;
+    }
+    return ok;
+}
+
+// Первое касание: каждый поток обнуляет свою часть массива с тем же
+// разбиением n * t / p, что и reduce::compute и статическое расписание
+// OpenMP. Вызывать до заполнения данными, при уже привязанных потоках
+template <typename T>
+void firstTouch(T* data, size_t n)
+{
+    #pragma omp parallel
+    {
+        int t = omp_get_thread_num();
+        int count = omp_get_num_threads();
+        size_t begin = n * t / count;
+        size_t end = n * (t + 1) / count;
+        if (begin < end)
+        {
+            memset((void*)(data + begin), 0, (end - begin) * sizeof(T));
+        }
+    }
+}
+
+// Числа потоков по умолчанию: 1, 2, 4, ... и максимум
+inline std::vector<int> defaultThreadCounts(int maxThreads)
+{
+    std::vector<int> counts;
+    for (int p = 1; p < maxThreads; p *= 2)
+    {
+        counts.push_back(p);
+    }
+    counts.push_back(maxThreads < 1 ? 1 : maxThreads);
+    return counts;
+}
+
+// Одна точка кривой масштабирования
+struct Point
+{
+    int threads;
+    long long size;
+    bench::Summary time;
+};
+
+// Таблица ускорения и эффективности; база - первая точка
+inline void printTable(const char* title, Mode mode, const std::vector<Point>& points)
+{
+    if (points.empty())
+    {
+        return;
+    }
+    bool weak = mode == WEAK;
+    std::cout << title << (weak ? " - слабое масштабирование" : " - сильное масштабирование")
+              << std::endl;
+
+    // Заголовок выровнен вручную: printf считает байты, а не символы UTF-8
+    std::cout << "  потоков       размер  медиана, мс"
+              << (weak ? "  масшт. уск." : "    ускорение") << "  эффективность" << std::endl;
+
+    const Point& base = points[0];
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        const Point& p = points[i];
+        double ratio = p.time.median > 0 ? base.time.median / p.time.median : 0;
+        double scale = (double)p.threads / base.threads;
+
+        // Сильное: S = T1 / Tp, E = S / p; слабое: E = T1 / Tp, S = p * E
+        double speedup = weak ? ratio * scale : ratio;
+        double efficiency = weak ? ratio : ratio / scale;
+        printf("  %7d %12lld %12.4g %12.2fx %14.0f%%\n", p.threads, p.size,
+               p.time.median * 1000, speedup, efficiency * 100);
+    }
+    std::cout << std::endl;
+}
+
+// Прогон замера при каждом числе потоков из threads.
+// measure(size) сам выделяет и заполняет данные (через firstTouch -
+// потоки к этому моменту уже привязаны) и возвращает статистику замера
+template <typename Measure>
+std::vector<Point> sweep(const Options& options, Mode mode, long long baseSize,
+                         const std::vector<int>& threads, Measure measure)
+{
+    Topology topo = detectTopology();
+    std::vector<int> cpus = cpuOrder(topo, options.placement, options.node);
+
+    std::vector<Point> points;
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        int p = threads[i];
+        if (!pinThreads(p, options.placement, cpus))
+        {
+            std::cout << "ВНИМАНИЕ: не удалось привязать потоки (" << p << ")" << std::endl;
+        }
+
+        Point point;
+        point.threads = p;
+        point.size = mode == WEAK ? baseSize * p : baseSize;
+        point.time = measure(point.size);
+        points.push_back(point);
+    }
+
+    // Возвращаем потоки в исходное состояние
+    pinThreads(threads.empty() ? 1 : threads.back(), PIN_NONE, cpus);
+    return points;
+}
+
+// Точки кривой в общий отчет: benchmark "scaling-strong" или "scaling-weak"
+inline void addToReport(bench::Report& report, const char* variant, Mode mode,
+                        const std::vector<Point>& points, double bytesPerElement)
+{
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        const Point& p = points[i];
+        report.add(mode == WEAK ? "scaling-weak" : "scaling-strong", variant, p.size,
+                   p.threads, p.time, bytesPerElement * p.size);
+    }
+}
+
+// Наибольший размер задачи в переборе: при слабом масштабировании
+// он растет вместе с числом потоков
+inline long long largestSize(const Options& options, long long baseSize,
+                             const std::vector<int>& threads)
+{
+    int most = 1;
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        most = threads[i] > most ? threads[i] : most;
+    }
+    return options.modes & WEAK ? baseSize * most : baseSize;
+}
+
+// Описание топологии и привязки для заголовка вывода
+inline void printTopology(const Options& options)
+{
+    Topology topo = detectTopology();
+    std::cout << "Узлов NUMA: " << topo.nodes.size() << ", процессоров: " << topo.cpuCount();
+    for (size_t n = 0; n < topo.nodes.size(); n++)
+    {
+        std::cout << (n == 0 ? " (" : ", ") << "узел " << n << ": " << topo.nodes[n].size();
+    }
+    std::cout << ")" << std::endl;
+    std::cout << "Привязка потоков: " << placementName(options.placement);
+    if (options.placement == PIN_NODE)
+    {
+        std::cout << " " << options.node;
+    }
+    std::cout << std::endl;
+}
+
+// Числа потоков для перебора: --threads или 1, 2, 4, ... до числа
+// процессоров (с привязкой PIN_NODE - процессоров узла)
+inline std::vector<int> threadCounts(const Options& options, const bench::Config& config)
+{
+    if (!config.threads.empty())
+    {
+        return config.threads;
+    }
+    Topology topo = detectTopology();
+    int available = (int)cpuOrder(topo, options.placement, options.node).size();
+    return defaultThreadCounts(available > 0 ? available : omp_get_num_procs());
+}
+
+// Разбор ключей --scaling strong|weak|both и --pin none|compact|spread|node:K;
+// true - ключ наш и разобран, false - чужой ключ или ошибка в значении
+inline bool parseOption(int argc, char* argv[], int& i, Options& options)
+{
+    if (i + 1 >= argc)
+    {
+        return false;
+    }
+    const char* name = argv[i];
+    const char* value = argv[i + 1];
+
+    if (strcmp(name, "--scaling") == 0)
+    {
+        if (strcmp(value, "strong") == 0)
+        {
+            options.modes = STRONG;
+        }
+        else if (strcmp(value, "weak") == 0)
+        {
+            options.modes = WEAK;
+        }
+        else if (strcmp(value, "both") == 0)
+        {
+            options.modes = STRONG | WEAK;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else if (strcmp(name, "--pin") == 0)
+    {
+        if (strcmp(value, "none") == 0)
+        {
+            options.placement = PIN_NONE;
+        }
+        else if (strcmp(value, "compact") == 0)
+        {
+            options.placement = PIN_COMPACT;
+        }
+        else if (strcmp(value, "spread") == 0)
+        {
+            options.placement = PIN_SPREAD;
+        }
+        else if (strncmp(value, "node:", 5) == 0 && value[5] >= '0' && value[5] <= '9')
+        {
+            options.placement = PIN_NODE;
+            options.node = atoi(value + 5);
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else
+    {
+        return false;
+    }
+    i++;
+    return true;
+}
+
+// Справка по ключам масштабирования
+inline void printUsage()
+{
+    std::cout << "Масштабирование по числу потоков:" << std::endl;
+    std::cout << "  --scaling strong|weak|both  перебор потоков (--threads или 1, 2, 4, ...)" << std::endl;
+    std::cout << "  --pin compact|spread|node:K|none  привязка потоков (по умолчанию compact)" << std::endl;
+}
+
+} // namespace scaling
+
+#endif // SCALING_H
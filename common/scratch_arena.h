@@ -0,0 +1,145 @@
+/*
+ * Арена временной памяти для сортировок.
+ *
+ * Классический merge() выделяет два временных массива на каждое
+ * слияние - это миллионы вызовов new/delete за одну сортировку.
+ * Арена выделяет память один раз и отдает ее сортировке повторно:
+ *   - у каждого потока OpenMP свой кусок памяти (slab), выровненный
+ *     по кэш-линии, поэтому параллельные слияния не конкурируют
+ *     за общий аллокатор и не делят кэш-линии
+ *   - slab растет только если запрос больше текущего размера
+ *     (с удвоением), поэтому за сортировку выделений O(1)
+ *
+ * Арена считает обращения (acquire) и реальные выделения из кучи,
+ * чтобы было видно, что выделений стало O(1).
+ *
+ * Буфер, полученный через acquire, действителен до следующего
+ * acquire в том же потоке.
+ */
+
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <omp.h>
+
+namespace arena
+{
+
+// Максимальное число потоков, которые могут брать память из арены
+const int MAX_THREADS = 256;
+
+class ScratchArena
+{
+public:
+    // reservePerThread - сразу выделить столько int первому потоку
+    explicit ScratchArena(size_t reservePerThread = 0)
+    {
+        for (int t = 0; t < MAX_THREADS; t++)
+        {
+            slabs[t].data = NULL;
+            slabs[t].capacity = 0;
+            slabs[t].acquires = 0;
+            slabs[t].allocations = 0;
+        }
+        if (reservePerThread > 0)
+        {
+            grow(slabs[0], reservePerThread);
+        }
+    }
+
+    ~ScratchArena()
+    {
+        for (int t = 0; t < MAX_THREADS; t++)
+        {
+            free(slabs[t].data);
+        }
+    }
+
+    // Буфер текущего потока не меньше n элементов
+    int* acquire(size_t n)
+    {
+        int t = omp_get_thread_num();
+        if (t >= MAX_THREADS)
+        {
+            std::cout << "ScratchArena: поток " << t << " больше MAX_THREADS" << std::endl;
+            exit(1);
+        }
+
+        Slab& slab = slabs[t];
+        if (slab.capacity < n)
+        {
+            grow(slab, n > slab.capacity * 2 ? n : slab.capacity * 2);
+        }
+
+        slab.acquires++;
+
+        return slab.data;
+    }
+
+    // Сколько раз память реально выделялась из кучи
+    size_t allocations() const
+    {
+        size_t total = 0;
+        for (int t = 0; t < MAX_THREADS; t++)
+        {
+            total += slabs[t].allocations;
+        }
+        return total;
+    }
+
+    // Сколько раз сортировка просила временную память
+    size_t requests() const
+    {
+        size_t total = 0;
+        for (int t = 0; t < MAX_THREADS; t++)
+        {
+            total += slabs[t].acquires;
+        }
+        return total;
+    }
+
+    // Обнулить счетчики (память остается за ареной)
+    void resetCounters()
+    {
+        for (int t = 0; t < MAX_THREADS; t++)
+        {
+            slabs[t].acquires = 0;
+            slabs[t].allocations = 0;
+        }
+    }
+
+private:
+    // Кусок памяти одного потока (занимает свою кэш-линию)
+    // Счетчики тоже свои у каждого потока - без атомарных операций
+    struct alignas(64) Slab
+    {
+        int* data;
+        size_t capacity;
+        size_t acquires;
+        size_t allocations;
+    };
+
+    void grow(Slab& slab, size_t n)
+    {
+        free(slab.data);
+
+        // Размер для aligned_alloc должен быть кратен выравниванию
+        size_t bytes = (n * sizeof(int) + 63) / 64 * 64;
+        slab.data = (int*)aligned_alloc(64, bytes);
+        slab.capacity = bytes / sizeof(int);
+        slab.allocations++;
+    }
+
+    Slab slabs[MAX_THREADS];
+
+    // Копировать арену нельзя: память принадлежит ей
+    ScratchArena(const ScratchArena&);
+    ScratchArena& operator=(const ScratchArena&);
+};
+
+} // namespace arena
+
+#endif // SCRATCH_ARENA_H
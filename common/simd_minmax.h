@@ -0,0 +1,296 @@
+/*
+ * Векторизованный поиск минимума и максимума в массиве int.
+ *
+ * Есть четыре реализации одного и того же ядра:
+ *   - скалярная (работает везде, используется как запасной вариант)
+ *   - SSE4.1  (4 int за инструкцию)
+ *   - AVX2    (8 int за инструкцию)
+ *   - AVX-512 (16 int за инструкцию)
+ *
+ * Нужная версия выбирается один раз во время работы программы
+ * по данным CPUID (__builtin_cpu_supports), поэтому бинарник,
+ * собранный без -mavx2, все равно использует AVX2 на новых процессорах.
+ *
+ * Ядро не создает потоков само - его вызывает каждый поток OpenMP
+ * для своей части массива (SIMD внутри ядра, OpenMP между ядрами).
+ */
+
+#ifndef SIMD_MINMAX_H
+#define SIMD_MINMAX_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+// nvcc разбирает хост-код своим фронтендом, который не понимает
+// target-атрибуты intrinsic-функций - под nvcc остается скалярная версия
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(__CUDACC__)
+#include <immintrin.h>
+#define SIMD_MINMAX_X86 1
+#else
+#define SIMD_MINMAX_X86 0
+#endif
+
+namespace simd
+{
+
+// Набор инструкций, которым выполняется ядро
+enum class Isa
+{
+    Scalar,
+    SSE41,
+    AVX2,
+    AVX512
+};
+
+// Сигнатура ядра: обновляет minVal/maxVal значениями из arr[0..n)
+// При n == 0 значения minVal/maxVal не меняются
+typedef void (*MinMaxKernel)(const int* arr, size_t n, int& minVal, int& maxVal);
+
+inline const char* isaName(Isa isa)
+{
+    switch (isa)
+    {
+        case Isa::SSE41:  return "SSE4.1";
+        case Isa::AVX2:   return "AVX2";
+        case Isa::AVX512: return "AVX-512";
+        default:          return "scalar";
+    }
+}
+
+// Скалярная версия
+// Без ветвлений в теле цикла: тернарный оператор компилируется в cmov
+inline void minMaxScalar(const int* arr, size_t n, int& minVal, int& maxVal)
+{
+    int mn = minVal;
+    int mx = maxVal;
+    for (size_t i = 0; i < n; i++)
+    {
+        int v = arr[i];
+        mn = v < mn ? v : mn;
+        mx = v > mx ? v : mx;
+    }
+    minVal = mn;
+    maxVal = mx;
+}
+
+#if SIMD_MINMAX_X86
+
+// SSE4.1: _mm_min_epi32/_mm_max_epi32 появились только в SSE4.1
+__attribute__((target("sse4.1")))
+inline void minMaxSse41(const int* arr, size_t n, int& minVal, int& maxVal)
+{
+    __m128i vmin0 = _mm_set1_epi32(minVal), vmin1 = vmin0;
+    __m128i vmax0 = _mm_set1_epi32(maxVal), vmax1 = vmax0;
+
+    // Два независимых аккумулятора, чтобы скрыть задержку min/max
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(arr + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(arr + i + 4));
+        vmin0 = _mm_min_epi32(vmin0, a);
+        vmax0 = _mm_max_epi32(vmax0, a);
+        vmin1 = _mm_min_epi32(vmin1, b);
+        vmax1 = _mm_max_epi32(vmax1, b);
+    }
+    __m128i vmin = _mm_min_epi32(vmin0, vmin1);
+    __m128i vmax = _mm_max_epi32(vmax0, vmax1);
+
+    // Горизонтальная свертка 4 -> 1
+    vmin = _mm_min_epi32(vmin, _mm_shuffle_epi32(vmin, _MM_SHUFFLE(1, 0, 3, 2)));
+    vmin = _mm_min_epi32(vmin, _mm_shuffle_epi32(vmin, _MM_SHUFFLE(2, 3, 0, 1)));
+    vmax = _mm_max_epi32(vmax, _mm_shuffle_epi32(vmax, _MM_SHUFFLE(1, 0, 3, 2)));
+    vmax = _mm_max_epi32(vmax, _mm_shuffle_epi32(vmax, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    minVal = _mm_cvtsi128_si32(vmin);
+    maxVal = _mm_cvtsi128_si32(vmax);
+
+    // Хвост
+    minMaxScalar(arr + i, n - i, minVal, maxVal);
+}
+
+// Горизонтальные min/max для 8 int
+// Используются и в AVX2, и в AVX-512 версии (AVX-512F включает AVX2)
+__attribute__((target("avx2")))
+inline int reduceMin256(__m256i v)
+{
+    __m128i x = _mm_min_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    x = _mm_min_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+    x = _mm_min_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(x);
+}
+
+__attribute__((target("avx2")))
+inline int reduceMax256(__m256i v)
+{
+    __m128i x = _mm_max_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    x = _mm_max_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+    x = _mm_max_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(x);
+}
+
+// AVX2: четыре аккумулятора по 8 int, 32 элемента за итерацию
+__attribute__((target("avx2")))
+inline void minMaxAvx2(const int* arr, size_t n, int& minVal, int& maxVal)
+{
+    __m256i vmin0 = _mm256_set1_epi32(minVal), vmin1 = vmin0, vmin2 = vmin0, vmin3 = vmin0;
+    __m256i vmax0 = _mm256_set1_epi32(maxVal), vmax1 = vmax0, vmax2 = vmax0, vmax3 = vmax0;
+
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(arr + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(arr + i + 8));
+        __m256i c = _mm256_loadu_si256((const __m256i*)(arr + i + 16));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(arr + i + 24));
+        vmin0 = _mm256_min_epi32(vmin0, a);
+        vmax0 = _mm256_max_epi32(vmax0, a);
+        vmin1 = _mm256_min_epi32(vmin1, b);
+        vmax1 = _mm256_max_epi32(vmax1, b);
+        vmin2 = _mm256_min_epi32(vmin2, c);
+        vmax2 = _mm256_max_epi32(vmax2, c);
+        vmin3 = _mm256_min_epi32(vmin3, d);
+        vmax3 = _mm256_max_epi32(vmax3, d);
+    }
+    __m256i vmin = _mm256_min_epi32(_mm256_min_epi32(vmin0, vmin1), _mm256_min_epi32(vmin2, vmin3));
+    __m256i vmax = _mm256_max_epi32(_mm256_max_epi32(vmax0, vmax1), _mm256_max_epi32(vmax2, vmax3));
+
+    minVal = reduceMin256(vmin);
+    maxVal = reduceMax256(vmax);
+
+    minMaxScalar(arr + i, n - i, minVal, maxVal);
+}
+
+// AVX-512: 64 элемента за итерацию, хвост обрабатывается маской
+// GCC 12 выдает ложное предупреждение о _mm512_undefined_epi32()
+// внутри своих же intrinsic-функций (GCC bug 105593)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+__attribute__((target("avx512f")))
+inline void minMaxAvx512(const int* arr, size_t n, int& minVal, int& maxVal)
+{
+    __m512i vmin0 = _mm512_set1_epi32(minVal), vmin1 = vmin0, vmin2 = vmin0, vmin3 = vmin0;
+    __m512i vmax0 = _mm512_set1_epi32(maxVal), vmax1 = vmax0, vmax2 = vmax0, vmax3 = vmax0;
+
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64)
+    {
+        __m512i a = _mm512_loadu_si512(arr + i);
+        __m512i b = _mm512_loadu_si512(arr + i + 16);
+        __m512i c = _mm512_loadu_si512(arr + i + 32);
+        __m512i d = _mm512_loadu_si512(arr + i + 48);
+        vmin0 = _mm512_min_epi32(vmin0, a);
+        vmax0 = _mm512_max_epi32(vmax0, a);
+        vmin1 = _mm512_min_epi32(vmin1, b);
+        vmax1 = _mm512_max_epi32(vmax1, b);
+        vmin2 = _mm512_min_epi32(vmin2, c);
+        vmax2 = _mm512_max_epi32(vmax2, c);
+        vmin3 = _mm512_min_epi32(vmin3, d);
+        vmax3 = _mm512_max_epi32(vmax3, d);
+    }
+    __m512i vmin = _mm512_min_epi32(_mm512_min_epi32(vmin0, vmin1), _mm512_min_epi32(vmin2, vmin3));
+    __m512i vmax = _mm512_max_epi32(_mm512_max_epi32(vmax0, vmax1), _mm512_max_epi32(vmax2, vmax3));
+
+    // Оставшиеся элементы по 16, последний неполный вектор - через маску
+    for (; i < n; i += 16)
+    {
+        size_t rest = n - i;
+        __mmask16 mask = rest >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << rest) - 1);
+        vmin = _mm512_mask_min_epi32(vmin, mask, vmin, _mm512_maskz_loadu_epi32(mask, arr + i));
+        vmax = _mm512_mask_max_epi32(vmax, mask, vmax, _mm512_maskz_loadu_epi32(mask, arr + i));
+    }
+
+    // Свертка 16 -> 8, дальше как в AVX2
+    minVal = reduceMin256(_mm256_min_epi32(_mm512_castsi512_si256(vmin),
+                                           _mm512_extracti64x4_epi64(vmin, 1)));
+    maxVal = reduceMax256(_mm256_max_epi32(_mm512_castsi512_si256(vmax),
+                                           _mm512_extracti64x4_epi64(vmax, 1)));
+}
+#pragma GCC diagnostic pop
+
+#endif // SIMD_MINMAX_X86
+
+// Лучший набор инструкций, который поддерживает процессор
+inline Isa detectIsa()
+{
+#if SIMD_MINMAX_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return Isa::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return Isa::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1"))
+    {
+        return Isa::SSE41;
+    }
+#endif
+    return Isa::Scalar;
+}
+
+// Проверка, может ли процессор выполнить ядро для isa
+inline bool isaSupported(Isa isa)
+{
+    return isa <= detectIsa();
+}
+
+// Ядро для конкретного набора инструкций
+// Если процессор его не поддерживает - возвращается скалярное
+inline MinMaxKernel minMaxKernelFor(Isa isa)
+{
+#if SIMD_MINMAX_X86
+    if (isaSupported(isa))
+    {
+        switch (isa)
+        {
+            case Isa::SSE41:  return minMaxSse41;
+            case Isa::AVX2:   return minMaxAvx2;
+            case Isa::AVX512: return minMaxAvx512;
+            default:          break;
+        }
+    }
+#endif
+    (void)isa;
+    return minMaxScalar;
+}
+
+// Набор инструкций по умолчанию
+// Переменная окружения MINMAX_ISA=scalar|sse41|avx2|avx512 позволяет
+// принудительно выбрать более простую версию (удобно для сравнения)
+inline Isa defaultIsa()
+{
+    static const Isa isa = []()
+    {
+        Isa best = detectIsa();
+        const char* env = getenv("MINMAX_ISA");
+        if (env == NULL)
+        {
+            return best;
+        }
+
+        Isa wanted = best;
+        if (strcmp(env, "scalar") == 0)      wanted = Isa::Scalar;
+        else if (strcmp(env, "sse41") == 0)  wanted = Isa::SSE41;
+        else if (strcmp(env, "avx2") == 0)   wanted = Isa::AVX2;
+        else if (strcmp(env, "avx512") == 0) wanted = Isa::AVX512;
+
+        return wanted < best ? wanted : best;
+    }();
+    return isa;
+}
+
+// Ядро, выбранное по CPUID (выбор делается один раз)
+inline MinMaxKernel minMaxKernel()
+{
+    static const MinMaxKernel kernel = minMaxKernelFor(defaultIsa());
+    return kernel;
+}
+
+} // namespace simd
+
+#endif // SIMD_MINMAX_H
@@ -0,0 +1,261 @@
+/*
+ * Сортирующие сети для маленьких кусков массива (до 64 элементов).
+ *
+ * Сортировка вставками на маленьких кусках постоянно ошибается
+ * в предсказании ветвлений: каждое сравнение - случайный if.
+ * Битоническая сеть выполняет один и тот же набор операций
+ * min/max независимо от данных, поэтому ветвлений нет совсем,
+ * а на AVX2 одна инструкция сравнивает сразу 8 пар.
+ *
+ * Устройство:
+ *   - 8 элементов лежат в одном регистре AVX2 и сортируются
+ *     битонической сетью из 6 шагов (перестановка + min + max + смешивание)
+ *   - 16, 32, 64 элемента - это 2, 4, 8 регистров: каждый регистр
+ *     сортируется отдельно, затем соседние группы сливаются
+ *     битоническим слиянием (разворот второй половины, min/max
+ *     между регистрами, затем шаги внутри регистров)
+ *   - неполный кусок дополняется INT_MAX при загрузке
+ *
+ * Если процессор не поддерживает AVX2, используется сортировка вставками.
+ */
+
+#ifndef SORT_NETWORK_H
+#define SORT_NETWORK_H
+
+#include <climits>
+#include <cstddef>
+
+#include "simd_minmax.h"
+
+namespace netsort
+{
+
+// Самый большой кусок, который сортирует сеть
+const size_t MAX_BLOCK = 64;
+
+// Сортировка вставками (запасной вариант и эталон для сравнения)
+inline void insertionSort(int* arr, size_t n)
+{
+    for (size_t i = 1; i < n; i++)
+    {
+        int key = arr[i];
+        size_t j = i;
+        while (j > 0 && arr[j - 1] > key)
+        {
+            arr[j] = arr[j - 1];
+            j--;
+        }
+        arr[j] = key;
+    }
+}
+
+#if SIMD_MINMAX_X86
+
+namespace detail
+{
+
+// Один шаг битонической сети внутри регистра:
+// элемент i сравнивается с элементом i ^ j; в блоках размера k
+// с нечетным номером порядок убывающий (при k == 8 все по возрастанию)
+__attribute__((target("avx2")))
+inline __m256i stage(__m256i v, int j, int k)
+{
+    __m256i perm = _mm256_setr_epi32(0 ^ j, 1 ^ j, 2 ^ j, 3 ^ j, 4 ^ j, 5 ^ j, 6 ^ j, 7 ^ j);
+
+    // Элемент берет максимум, если он старший в паре (при возрастании)
+    // или младший (при убывании)
+    int takeMax[8];
+    for (int i = 0; i < 8; i++)
+    {
+        bool upper = (i & j) != 0;
+        bool descending = k < 8 && (i & k) != 0;
+        takeMax[i] = upper != descending ? -1 : 0;
+    }
+    __m256i mask = _mm256_setr_epi32(takeMax[0], takeMax[1], takeMax[2], takeMax[3],
+                                     takeMax[4], takeMax[5], takeMax[6], takeMax[7]);
+
+    __m256i other = _mm256_permutevar8x32_epi32(v, perm);
+    __m256i mn = _mm256_min_epi32(v, other);
+    __m256i mx = _mm256_max_epi32(v, other);
+    return _mm256_blendv_epi8(mn, mx, mask);
+}
+
+// Полная сортировка 8 элементов регистра (битоническая сеть)
+__attribute__((target("avx2")))
+inline __m256i sortRegister(__m256i v)
+{
+    v = stage(v, 1, 2);
+    v = stage(v, 2, 4);
+    v = stage(v, 1, 4);
+    v = stage(v, 4, 8);
+    v = stage(v, 2, 8);
+    v = stage(v, 1, 8);
+    return v;
+}
+
+// Досортировка битонической последовательности внутри регистра
+__attribute__((target("avx2")))
+inline __m256i cleanRegister(__m256i v)
+{
+    v = stage(v, 4, 8);
+    v = stage(v, 2, 8);
+    v = stage(v, 1, 8);
+    return v;
+}
+
+// Разворот 8 элементов регистра
+__attribute__((target("avx2")))
+inline __m256i reverseRegister(__m256i v)
+{
+    return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+}
+
+// Слияние двух отсортированных половин v[0..r/2) и v[r/2..r)
+// (r регистров, r - степень двойки)
+__attribute__((target("avx2")))
+inline void mergeRegisters(__m256i* v, int r)
+{
+    int half = r / 2;
+
+    // Разворачиваем вторую половину - получается битоническая последовательность
+    for (int i = 0; i < half / 2; i++)
+    {
+        __m256i t = v[half + i];
+        v[half + i] = v[r - 1 - i];
+        v[r - 1 - i] = t;
+    }
+    for (int i = half; i < r; i++)
+    {
+        v[i] = reverseRegister(v[i]);
+    }
+
+    // Шаги между регистрами
+    for (int d = half; d >= 1; d /= 2)
+    {
+        for (int i = 0; i < r; i++)
+        {
+            if ((i & d) == 0)
+            {
+                __m256i lo = _mm256_min_epi32(v[i], v[i + d]);
+                __m256i hi = _mm256_max_epi32(v[i], v[i + d]);
+                v[i] = lo;
+                v[i + d] = hi;
+            }
+        }
+    }
+
+    // Шаги внутри регистров
+    for (int i = 0; i < r; i++)
+    {
+        v[i] = cleanRegister(v[i]);
+    }
+}
+
+} // namespace detail
+
+// Сортировка куска из n <= 64 элементов сетью AVX2
+__attribute__((target("avx2")))
+inline void sortBlockAvx2(int* arr, size_t n)
+{
+    if (n < 2)
+    {
+        return;
+    }
+
+    // Число регистров - степень двойки, достаточная для n элементов
+    int regs = 1;
+    while ((size_t)regs * 8 < n)
+    {
+        regs *= 2;
+    }
+
+    // Загрузка с дополнением INT_MAX (они уйдут в конец)
+    __m256i v[8];
+    const __m256i pad = _mm256_set1_epi32(INT_MAX);
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    for (int r = 0; r < regs; r++)
+    {
+        long rest = (long)n - r * 8;
+        if (rest >= 8)
+        {
+            v[r] = _mm256_loadu_si256((const __m256i*)(arr + r * 8));
+        }
+        else if (rest > 0)
+        {
+            __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)rest), lane);
+            v[r] = _mm256_blendv_epi8(pad, _mm256_maskload_epi32(arr + r * 8, mask), mask);
+        }
+        else
+        {
+            v[r] = pad;
+        }
+    }
+
+    for (int r = 0; r < regs; r++)
+    {
+        v[r] = detail::sortRegister(v[r]);
+    }
+    for (int width = 2; width <= regs; width *= 2)
+    {
+        for (int g = 0; g < regs; g += width)
+        {
+            detail::mergeRegisters(v + g, width);
+        }
+    }
+
+    // Сохраняем только первые n элементов
+    for (int r = 0; r < regs; r++)
+    {
+        long rest = (long)n - r * 8;
+        if (rest >= 8)
+        {
+            _mm256_storeu_si256((__m256i*)(arr + r * 8), v[r]);
+        }
+        else if (rest > 0)
+        {
+            __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)rest), lane);
+            _mm256_maskstore_epi32(arr + r * 8, mask, v[r]);
+        }
+    }
+}
+
+#endif // SIMD_MINMAX_X86
+
+// Сигнатура сортировки маленького куска
+typedef void (*BlockSort)(int* arr, size_t n);
+
+// Есть ли у процессора AVX2 для сети
+inline bool networkAvailable()
+{
+    return simd::isaSupported(simd::Isa::AVX2);
+}
+
+// Сортировка куска из n <= 64 элементов: сеть, если есть AVX2,
+// иначе сортировка вставками (выбор делается один раз)
+inline BlockSort blockSort()
+{
+#if SIMD_MINMAX_X86
+    static const BlockSort sort = networkAvailable() ? sortBlockAvx2 : insertionSort;
+    return sort;
+#else
+    return insertionSort;
+#endif
+}
+
+inline void sortBlock(int* arr, size_t n)
+{
+    blockSort()(arr, n);
+}
+
+// Сортировка каждого куска размера chunk (chunk <= 64)
+inline void sortChunks(int* arr, size_t n, size_t chunk, BlockSort sort = blockSort())
+{
+    for (size_t start = 0; start < n; start += chunk)
+    {
+        sort(arr + start, n - start < chunk ? n - start : chunk);
+    }
+}
+
+} // namespace netsort
+
+#endif // SORT_NETWORK_H
@@ -4,3 +4,33 @@ __kernel void vector_add(__global const float* A,
     int id = get_global_id(0);  // Определение глобального ID
     C[id] = A[id] + B[id];      // Выполнение операции сложения
 }
+
+// Вариант с VEC элементами на рабочий элемент (-DVEC=1|2|4|8|16):
+// векторные загрузки vloadN, хвост массива - поэлементно
+#ifndef VEC
+#define VEC 4
+#endif
+#define CONCAT(a, b) a##b
+#define VLOAD(n) CONCAT(vload, n)
+#define VSTORE(n) CONCAT(vstore, n)
+
+__kernel void vector_add_vec(__global const float* A,
+                             __global const float* B,
+                             __global float* C,
+                             const int n) {
+    int id = get_global_id(0);
+    int first = id * VEC;
+#if VEC == 1
+    if (first < n) {
+        C[first] = A[first] + B[first];
+    }
+#else
+    if (first + VEC <= n) {
+        VSTORE(VEC)(VLOAD(VEC)(id, A) + VLOAD(VEC)(id, B), id, C);
+    } else {
+        for (int i = first; i < n; i++) {
+            C[i] = A[i] + B[i];
+        }
+    }
+#endif
+}
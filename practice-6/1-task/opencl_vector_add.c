@@ -1,3 +1,5 @@
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,8 +12,42 @@
 #include <CL/cl.h>
 #endif
 
+#include "../common/mapped_file.h"
+#include "../common/cl_autotune.h"
+#include "../common/cl_trace.h"
+#include "../common/elementwise.h"
+#include "../common/cl_runtime.h"
+
 #define ARRAY_SIZE 16777216  // 16M элементов для заметного измерения времени
 
+// Элементов на рабочий элемент в vector_add_vec по умолчанию (-DVEC);
+// автонастройка (--tune) подбирает свое значение и размер группы
+#define DEFAULT_VEC 4
+#define TUNE_REPS 3
+
+// Режим памяти буферов: копирование (запись и чтение) или zero-copy
+// (буферы на памяти хоста, результат через clEnqueueMapBuffer);
+// auto - zero-copy, если устройство делит память с хостом
+#define MEMORY_AUTO 0
+#define MEMORY_COPY 1
+#define MEMORY_ZERO_COPY 2
+
+// Драйверы (Intel, POCL) работают с памятью хоста без копии, если она
+// выровнена по странице, а размер кратен 64 байтам
+#define ZERO_COPY_ALIGNMENT 4096
+
+// Потоковый режим: кусок по умолчанию (элементов) и число очередей
+#define STREAM_DEFAULT_CHUNK (1 << 22)
+#define STREAM_MAX_QUEUES 3
+
+// Слияние операций (--fused): ширина вектора и векторов на рабочий элемент
+#define FUSED_DEFAULT_WIDTH 4
+#define FUSED_DEFAULT_EPT 4
+
+// Пакет задач (--batch): сколько первых задач выполнить каждую со своей
+// средой OpenCL для сравнения
+#define BATCH_ISOLATED_JOBS 8
+
 // Функция для получения времени в секундах
 double get_time() {
 #ifdef __APPLE__
@@ -27,39 +63,736 @@ double get_time() {
 #endif
 }
 
-// Функция для чтения файла ядра
-char* read_kernel_file(const char* filename, size_t* length) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        fprintf(stderr, "Ошибка: не удалось открыть файл %s\n", filename);
+// Массив float, выровненный по странице, с размером, кратным 64 байтам
+float* alloc_page_aligned(size_t n) {
+    size_t size = (n * sizeof(float) + 63) / 64 * 64;
+    void* p = NULL;
+    if (posix_memalign(&p, ZERO_COPY_ALIGNMENT, size) != 0) {
         return NULL;
     }
+    return (float*)p;
+}
 
-    fseek(file, 0, SEEK_END);
-    *length = ftell(file);
-    rewind(file);
+// Буфер zero-copy на памяти хоста host: выровненная память используется
+// напрямую (CL_MEM_USE_HOST_PTR), иначе драйвер выделяет доступную хосту
+// память сам (CL_MEM_ALLOC_HOST_PTR), и вход копируется в нее один раз
+cl_mem create_zero_copy_buffer(cl_context context, cl_mem_flags access, void* host,
+                               size_t size, int input, cl_int* err) {
+    if ((uintptr_t)host % ZERO_COPY_ALIGNMENT == 0) {
+        return clCreateBuffer(context, access | CL_MEM_USE_HOST_PTR, size, host, err);
+    }
+    cl_mem_flags flags = access | CL_MEM_ALLOC_HOST_PTR | (input ? CL_MEM_COPY_HOST_PTR : 0);
+    return clCreateBuffer(context, flags, size, input ? host : NULL, err);
+}
 
-    char* source = (char*)malloc(*length + 1);
-    if (!source) {
-        fclose(file);
-        return NULL;
+// Результат из bufferC в C: чтение (копирование) или отображение буфера.
+// При CL_MEM_USE_HOST_PTR отображение возвращает саму память C, и map
+// только синхронизирует ее с устройством. Время - по событию команды
+cl_int fetch_result(cl_command_queue queue, cl_mem bufferC, float* C, size_t size,
+                    int zero_copy, cl_trace* trace, const char* name, double* seconds) {
+    cl_event event;
+    cl_int err;
+    if (!zero_copy) {
+        err = clEnqueueReadBuffer(queue, bufferC, CL_TRUE, 0, size, C, 0, NULL, &event);
+        if (err == CL_SUCCESS) {
+            *seconds = trace_add(trace, "read", name, event);
+        }
+        return err;
     }
 
-    fread(source, 1, *length, file);
-    source[*length] = '\0';
-    fclose(file);
+    void* mapped = clEnqueueMapBuffer(queue, bufferC, CL_TRUE, CL_MAP_READ, 0, size, 0, NULL,
+                                      &event, &err);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    *seconds = trace_add(trace, "map", name, event);
+    if (mapped != C) {
+        memcpy(C, mapped, size);  // Буфер CL_MEM_ALLOC_HOST_PTR
+    }
+    err = clEnqueueUnmapMemObject(queue, bufferC, mapped, 0, NULL, NULL);
+    clFinish(queue);
+    return err;
+}
 
-    return source;
+// Число элементов, где C[i] != A[i] + B[i]
+int count_errors(const float* A, const float* B, const float* C, size_t n) {
+    int errors = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (C[i] != A[i] + B[i]) {
+            errors++;
+        }
+    }
+    return errors;
+}
+
+// Глобальный размер vector_add_vec: по рабочему элементу на vec
+// элементов, с округлением до кратного группе (local = 0 - выбирает драйвер)
+size_t vec_global_size(size_t n, int vec, size_t local) {
+    size_t items = (n + vec - 1) / vec;
+    return local > 0 ? (items + local - 1) / local * local : items;
+}
+
+// Комплект буферов потокового режима и события его последнего куска
+typedef struct {
+    cl_mem a, b, c;
+    cl_event write_a, write_b, kernel, read;
+    size_t chunk;
+} stream_slot;
+
+// Суммарное время команд по стадиям, сек
+typedef struct {
+    double write;
+    double kernel;
+    double read;
+} stream_totals;
+
+// Ожидание последнего куска комплекта: время его команд копится в totals
+// (первые команды - еще и в trace), события освобождаются
+void stream_collect(stream_slot* slot, cl_trace* trace, stream_totals* totals) {
+    char name[48];
+    if (slot->write_a) {
+        snprintf(name, sizeof(name), "запись A #%zu", slot->chunk);
+        totals->write += trace_add(trace, "write", name, slot->write_a);
+    }
+    if (slot->write_b) {
+        snprintf(name, sizeof(name), "запись B #%zu", slot->chunk);
+        totals->write += trace_add(trace, "write", name, slot->write_b);
+    }
+    if (slot->kernel) {
+        snprintf(name, sizeof(name), "vector_add_vec #%zu", slot->chunk);
+        totals->kernel += trace_add(trace, "kernel", name, slot->kernel);
+    }
+    if (slot->read) {
+        snprintf(name, sizeof(name), "чтение C #%zu", slot->chunk);
+        totals->read += trace_add(trace, "read", name, slot->read);
+    }
+    slot->write_a = slot->write_b = slot->kernel = slot->read = NULL;
+}
+
+// Потоковый режим: векторы идут через устройство кусками по chunk
+// элементов, поэтому их размер не ограничен памятью устройства.
+// Комплектов буферов - два (три при трех очередях): пока ядро считает
+// один кусок, другие записываются и читаются. Очереди: одна - все
+// команды по порядку (без перекрытия, для сравнения), две - запись
+// и ядро с чтением, три - запись, ядро и чтение. Чтение не ставится
+// в очередь записи: там оно ждало бы ядро и задерживало запись
+// следующего куска. Команды куска связаны событиями: ядро ждет обе
+// записи, чтение - ядро; все неблокирующие.
+// Возвращает 0 или 1 при ошибке
+int stream_vector_add(cl_context context, cl_device_id device, cl_kernel kernel, int vec,
+                      size_t local, const float* A, const float* B, float* C, size_t n,
+                      size_t chunk, int queue_count, const char* trace_path) {
+    cl_int err = CL_SUCCESS;
+    int slot_count = queue_count == 3 ? 3 : 2;
+    size_t chunk_bytes = chunk * sizeof(float);
+
+    cl_ulong max_alloc = 0;
+    cl_ulong global_mem = 0;
+    clGetDeviceInfo(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(max_alloc), &max_alloc, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(global_mem), &global_mem, NULL);
+
+    printf("=== Потоковый режим ===\n");
+    printf("Данные: %.2f ГБ (A, B и C), память устройства: %.2f ГБ\n",
+           3.0 * n * sizeof(float) / 1e9, global_mem / 1e9);
+    printf("Кусок: %zu элементов (%.2f МБ), очередей: %d, комплектов буферов: %d\n\n",
+           chunk, chunk_bytes / 1e6, queue_count, slot_count);
+    if (chunk_bytes > max_alloc || 3.0 * slot_count * chunk_bytes > (double)global_mem) {
+        fprintf(stderr, "Кусок слишком велик для устройства (буфер до %.2f МБ)\n",
+                max_alloc / 1e6);
+        return 1;
+    }
+
+    cl_command_queue queues[STREAM_MAX_QUEUES] = {NULL};
+    stream_slot slots[STREAM_MAX_QUEUES];
+    memset(slots, 0, sizeof(slots));
+    for (int q = 0; q < queue_count && err == CL_SUCCESS; q++) {
+        queues[q] = clrt_create_queue(context, device, &err);
+    }
+    for (int i = 0; i < slot_count && err == CL_SUCCESS; i++) {
+        slots[i].a = clCreateBuffer(context, CL_MEM_READ_ONLY, chunk_bytes, NULL, &err);
+        if (err == CL_SUCCESS) {
+            slots[i].b = clCreateBuffer(context, CL_MEM_READ_ONLY, chunk_bytes, NULL, &err);
+        }
+        if (err == CL_SUCCESS) {
+            slots[i].c = clCreateBuffer(context, CL_MEM_WRITE_ONLY, chunk_bytes, NULL, &err);
+        }
+    }
+    cl_command_queue write_queue = queues[0];
+    cl_command_queue kernel_queue = queues[queue_count > 1 ? 1 : 0];
+    cl_command_queue read_queue = queues[queue_count - 1];
+
+    cl_trace trace;
+    trace_init(&trace);
+    stream_totals totals = {0.0, 0.0, 0.0};
+    size_t chunks = (n + chunk - 1) / chunk;
+
+    double start = get_time();
+    for (size_t i = 0; i < chunks && err == CL_SUCCESS; i++) {
+        // Комплект свободен, когда прочитан его прошлый кусок; хост при
+        // этом уходит вперед устройства не больше чем на slot_count кусков
+        stream_slot* slot = &slots[i % slot_count];
+        stream_collect(slot, &trace, &totals);
+        slot->chunk = i;
+
+        size_t offset = i * chunk;
+        size_t length = n - offset < chunk ? n - offset : chunk;
+        size_t bytes = length * sizeof(float);
+        err = clEnqueueWriteBuffer(write_queue, slot->a, CL_FALSE, 0, bytes, A + offset,
+                                   0, NULL, &slot->write_a);
+        if (err == CL_SUCCESS) {
+            err = clEnqueueWriteBuffer(write_queue, slot->b, CL_FALSE, 0, bytes, B + offset,
+                                       0, NULL, &slot->write_b);
+        }
+
+        // Аргументы фиксируются при постановке ядра в очередь
+        int count = (int)length;
+        size_t global_size = vec_global_size(length, vec, local);
+        clSetKernelArg(kernel, 0, sizeof(cl_mem), &slot->a);
+        clSetKernelArg(kernel, 1, sizeof(cl_mem), &slot->b);
+        clSetKernelArg(kernel, 2, sizeof(cl_mem), &slot->c);
+        clSetKernelArg(kernel, 3, sizeof(int), &count);
+        if (err == CL_SUCCESS) {
+            cl_event writes[2] = {slot->write_a, slot->write_b};
+            err = clEnqueueNDRangeKernel(kernel_queue, kernel, 1, NULL, &global_size,
+                                         local ? &local : NULL, 2, writes, &slot->kernel);
+        }
+        if (err == CL_SUCCESS) {
+            err = clEnqueueReadBuffer(read_queue, slot->c, CL_FALSE, 0, bytes, C + offset,
+                                      1, &slot->kernel, &slot->read);
+        }
+
+        // Без flush команды могут копиться в очереди до первого ожидания
+        for (int q = 0; q < queue_count; q++) {
+            clFlush(queues[q]);
+        }
+    }
+    for (size_t i = 0; i < (size_t)slot_count; i++) {
+        stream_collect(&slots[(chunks + i) % slot_count], &trace, &totals);
+    }
+    double total_time = get_time() - start;
+
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "Ошибка потокового режима: %d\n", err);
+    } else {
+        // Без перекрытия время было бы суммой всех команд; разница -
+        // передачи, спрятанные за вычислениями (и друг за другом)
+        double transfer = totals.write + totals.read;
+        double serial = transfer + totals.kernel;
+        double hidden = serial - total_time;
+        hidden = hidden < 0 ? 0 : hidden > transfer ? transfer : hidden;
+        printf("Кусков: %zu, время: %.6f сек\n", chunks, total_time);
+        printf("Пропускная способность: %.2f ГБ/с (A, B и C), %.1f млн элементов/с\n",
+               3.0 * n * sizeof(float) / total_time / 1e9, n / total_time / 1e6);
+        printf("Команды (сумма): запись %.6f, ядро %.6f, чтение %.6f сек\n",
+               totals.write, totals.kernel, totals.read);
+        printf("Скрыто передач за вычислениями: %.6f из %.6f сек (%.0f%%)\n\n", hidden,
+               transfer, transfer > 0 ? 100.0 * hidden / transfer : 0.0);
+        if (trace_path) {
+            trace_write_chrome(&trace, trace_path);
+        }
+    }
+
+    for (int i = 0; i < slot_count; i++) {
+        if (slots[i].a) clReleaseMemObject(slots[i].a);
+        if (slots[i].b) clReleaseMemObject(slots[i].b);
+        if (slots[i].c) clReleaseMemObject(slots[i].c);
+    }
+    for (int q = 0; q < queue_count; q++) {
+        if (queues[q]) clReleaseCommandQueue(queues[q]);
+    }
+    return err == CL_SUCCESS ? 0 : 1;
 }
 
-int main() {
+// Автонастройка vector_add_vec: VEC (своя сборка на каждое значение)
+// и размер рабочей группы, включая выбор драйвера (NULL); лучший
+// вариант пишется в кэш
+int tune_vector_add(cl_context context, cl_device_id device, cl_command_queue queue,
+                    const char* source, size_t length, float* A, float* B, size_t n,
+                    const char* cache_path) {
+    static const int vecs[] = {1, 2, 4, 8, 16};
     cl_int err;
+    size_t buffer_size = n * sizeof(float);
+    cl_mem bufferA = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                    buffer_size, A, &err);
+    cl_mem bufferB = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                    buffer_size, B, &err);
+    cl_mem bufferC = clCreateBuffer(context, CL_MEM_WRITE_ONLY, buffer_size, NULL, &err);
+    if (!bufferA || !bufferB || !bufferC) {
+        fprintf(stderr, "Ошибка создания буферов\n");
+        return 1;
+    }
+    int count = (int)n;
+
+    printf("=== Автонастройка vector_add_vec (%zu элементов) ===\n", n);
+    double best = -1.0;
+    int best_vec = 0;
+    size_t best_local = 0;
+    for (size_t v = 0; v < sizeof(vecs) / sizeof(vecs[0]); v++) {
+        char options[32];
+        snprintf(options, sizeof(options), "-DVEC=%d", vecs[v]);
+        cl_program program = autotune_build(context, device, source, length, options);
+        cl_kernel kernel = program ? clCreateKernel(program, "vector_add_vec", &err) : NULL;
+        if (!kernel) {
+            if (program) {
+                clReleaseProgram(program);
+            }
+            continue;
+        }
+        clSetKernelArg(kernel, 0, sizeof(cl_mem), &bufferA);
+        clSetKernelArg(kernel, 1, sizeof(cl_mem), &bufferB);
+        clSetKernelArg(kernel, 2, sizeof(cl_mem), &bufferC);
+        clSetKernelArg(kernel, 3, sizeof(int), &count);
+
+        // Размер 0 в списке - локальный размер NULL
+        size_t groups[AUTOTUNE_MAX_GROUPS + 1];
+        groups[0] = 0;
+        int group_count = 1 + autotune_group_sizes(device, kernel, groups + 1,
+                                                   AUTOTUNE_MAX_GROUPS);
+        double vec_best = -1.0;
+        size_t vec_local = 0;
+        for (int g = 0; g < group_count; g++) {
+            size_t global_size = vec_global_size(n, vecs[v], groups[g]);
+            double seconds = autotune_time_kernel(queue, kernel, 1, &global_size,
+                                                  groups[g] ? &groups[g] : NULL, TUNE_REPS);
+            if (seconds > 0 && (vec_best < 0 || seconds < vec_best)) {
+                vec_best = seconds;
+                vec_local = groups[g];
+            }
+        }
+        if (vec_best > 0) {
+            char local_text[32];
+            snprintf(local_text, sizeof(local_text), "%zu", vec_local);
+            printf("  VEC %2d: лучшая группа %s - %.6f сек (%.2f ГБ/с)\n", vecs[v],
+                   vec_local ? local_text : "NULL", vec_best,
+                   3.0 * buffer_size / vec_best / 1e9);
+            if (best < 0 || vec_best < best) {
+                best = vec_best;
+                best_vec = vecs[v];
+                best_local = vec_local;
+            }
+        }
+        clReleaseKernel(kernel);
+        clReleaseProgram(program);
+    }
+
+    if (best > 0) {
+        char key[AUTOTUNE_MAX_LINE];
+        char value[64];
+        autotune_key(device, "vector_add_vec", key, sizeof(key));
+        snprintf(value, sizeof(value), "%d %zu", best_vec, best_local);
+        autotune_cache_store(cache_path, key, value);
+        printf("  Выбрано: VEC %d, группа %zu (0 - NULL)\n", best_vec, best_local);
+    }
+    printf("Кэш автонастройки: %s\n\n", cache_path);
+
+    clReleaseMemObject(bufferA);
+    clReleaseMemObject(bufferB);
+    clReleaseMemObject(bufferC);
+    return 0;
+}
+
+// Максимальное относительное отклонение out от ref
+double max_relative_error(const float* out, const float* ref, size_t n) {
+    double worst = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        double scale = ref[i] < 0 ? -ref[i] : ref[i];
+        double diff = out[i] - ref[i];
+        diff = (diff < 0 ? -diff : diff) / (scale > 1.0 ? scale : 1.0);
+        if (diff > worst) {
+            worst = diff;
+        }
+    }
+    return worst;
+}
+
+// Слияние операций: out = clamp(s0 * A + B, s1, s2) * s3 - три ядра
+// (fma, clamp, mul; промежуточный массив T) против одного
+// сгенерированного ядра, на устройстве и на CPU (OpenMP + SIMD).
+// Возвращает 0 или 1 при ошибке
+int fused_vector_demo(cl_context context, cl_device_id device, cl_command_queue queue,
+                      const float* A, const float* B, size_t n, int width, int ept,
+                      const char* cache_dir, const char* trace_path) {
+    const float scalars[4] = {0.5f, 1000.0f, 3.0e7f, 0.25f};
+
+    // Слитое выражение и его части по отдельности
+    ew_expr fused, axpy, clamp, scale;
+    ew_init(&fused);
+    int t = ew_fma(&fused, ew_scalar(&fused, 0), ew_input(&fused, 0), ew_input(&fused, 1));
+    t = ew_clamp(&fused, t, ew_scalar(&fused, 1), ew_scalar(&fused, 2));
+    ew_mul(&fused, t, ew_scalar(&fused, 3));
+    ew_init(&axpy);
+    ew_fma(&axpy, ew_scalar(&axpy, 0), ew_input(&axpy, 0), ew_input(&axpy, 1));
+    ew_init(&clamp);
+    ew_clamp(&clamp, ew_input(&clamp, 0), ew_scalar(&clamp, 0), ew_scalar(&clamp, 1));
+    ew_init(&scale);
+    ew_mul(&scale, ew_input(&scale, 0), ew_scalar(&scale, 0));
 
-    // Данные для вычислений (выделяем в куче из-за большого размера)
-    float* A = (float*)malloc(ARRAY_SIZE * sizeof(float));
-    float* B = (float*)malloc(ARRAY_SIZE * sizeof(float));
-    float* C = (float*)malloc(ARRAY_SIZE * sizeof(float));
-    float* C_cpu = (float*)malloc(ARRAY_SIZE * sizeof(float));  // Для сравнения с CPU
+    char signature[EW_MAX_SIGNATURE];
+    ew_signature(&fused, signature, sizeof(signature));
+    printf("=== Слияние поэлементных операций ===\n");
+    printf("Выражение: %s, float%d, %d на рабочий элемент\n\n", signature, width, ept);
+
+    size_t bytes = n * sizeof(float);
+    float* out = (float*)malloc(bytes);
+    float* temp = (float*)malloc(bytes);
+    float* ref = (float*)malloc(bytes);
+    if (!out || !temp || !ref) {
+        fprintf(stderr, "Ошибка выделения памяти\n");
+        free(out);
+        free(temp);
+        free(ref);
+        return 1;
+    }
+
+    // Эталон: обычный цикл
+    for (size_t i = 0; i < n; i++) {
+        float v = scalars[0] * A[i] + B[i];
+        v = v < scalars[1] ? scalars[1] : v;
+        v = v > scalars[2] ? scalars[2] : v;
+        ref[i] = v * scalars[3];
+    }
+
+    // CPU: по отдельности (три прохода по памяти) и слитно (один)
+    const float* fused_inputs[2] = {A, B};
+    const float* temp_inputs[1] = {temp};
+    double cpu_start = get_time();
+    ew_eval_cpu(&axpy, fused_inputs, scalars, temp, n);
+    ew_eval_cpu(&clamp, temp_inputs, scalars + 1, temp, n);
+    ew_eval_cpu(&scale, temp_inputs, scalars + 3, out, n);
+    double cpu_separate = get_time() - cpu_start;
+    double cpu_separate_error = max_relative_error(out, ref, n);
+    cpu_start = get_time();
+    ew_eval_cpu(&fused, fused_inputs, scalars, out, n);
+    double cpu_fused = get_time() - cpu_start;
+    double cpu_fused_error = max_relative_error(out, ref, n);
+
+    // Устройство: ядра собираются (или берутся из кэша) до замеров
+    ew_cl_cache cache;
+    ew_cl_init(&cache, context, device, cache_dir);
+    double build_start = get_time();
+    int built = ew_cl_kernel(&cache, &fused, width, ept) && ew_cl_kernel(&cache, &axpy, width, ept)
+                && ew_cl_kernel(&cache, &clamp, width, ept)
+                && ew_cl_kernel(&cache, &scale, width, ept);
+    double build_time = get_time() - build_start;
+
+    cl_int err = built ? CL_SUCCESS : CL_BUILD_PROGRAM_FAILURE;
+    cl_mem bufferA = NULL, bufferB = NULL, bufferT = NULL, bufferOut = NULL;
+    if (err == CL_SUCCESS) {
+        bufferA = clCreateBuffer(context, CL_MEM_READ_ONLY, bytes, NULL, &err);
+    }
+    if (err == CL_SUCCESS) {
+        bufferB = clCreateBuffer(context, CL_MEM_READ_ONLY, bytes, NULL, &err);
+    }
+    if (err == CL_SUCCESS) {
+        bufferT = clCreateBuffer(context, CL_MEM_READ_WRITE, bytes, NULL, &err);
+    }
+    if (err == CL_SUCCESS) {
+        bufferOut = clCreateBuffer(context, CL_MEM_WRITE_ONLY, bytes, NULL, &err);
+    }
+
+    cl_trace trace;
+    trace_init(&trace);
+    double separate_time = 0.0, fused_time = 0.0, gpu_separate_error = 0.0, gpu_fused_error = 0.0;
+    cl_event event;
+    if (err == CL_SUCCESS) {
+        err = clEnqueueWriteBuffer(queue, bufferA, CL_FALSE, 0, bytes, A, 0, NULL, &event);
+    }
+    if (err == CL_SUCCESS) {
+        trace_add(&trace, "write", "запись A", event);
+        err = clEnqueueWriteBuffer(queue, bufferB, CL_FALSE, 0, bytes, B, 0, NULL, &event);
+    }
+    if (err == CL_SUCCESS) {
+        trace_add(&trace, "write", "запись B", event);
+    }
+
+    // Три ядра: T = s0 * A + B, T = clamp(T), out = T * s3
+    cl_mem inputs[2] = {bufferA, bufferB};
+    int count = (int)n;
+    if (err == CL_SUCCESS) {
+        err = ew_cl_run(&cache, queue, &axpy, width, ept, bufferT, inputs, scalars, count,
+                        &event);
+    }
+    if (err == CL_SUCCESS) {
+        separate_time += trace_add(&trace, "kernel", "fma", event);
+        err = ew_cl_run(&cache, queue, &clamp, width, ept, bufferT, &bufferT, scalars + 1, count,
+                        &event);
+    }
+    if (err == CL_SUCCESS) {
+        separate_time += trace_add(&trace, "kernel", "clamp", event);
+        err = ew_cl_run(&cache, queue, &scale, width, ept, bufferOut, &bufferT, scalars + 3,
+                        count, &event);
+    }
+    if (err == CL_SUCCESS) {
+        separate_time += trace_add(&trace, "kernel", "mul", event);
+        err = clEnqueueReadBuffer(queue, bufferOut, CL_TRUE, 0, bytes, out, 0, NULL, NULL);
+        gpu_separate_error = max_relative_error(out, ref, n);
+    }
+
+    // Одно ядро
+    if (err == CL_SUCCESS) {
+        err = ew_cl_run(&cache, queue, &fused, width, ept, bufferOut, inputs, scalars, count,
+                        &event);
+    }
+    if (err == CL_SUCCESS) {
+        fused_time = trace_add(&trace, "kernel", "слитое ядро", event);
+        err = clEnqueueReadBuffer(queue, bufferOut, CL_TRUE, 0, bytes, out, 0, NULL, NULL);
+        gpu_fused_error = max_relative_error(out, ref, n);
+    }
+
+    int failed = err != CL_SUCCESS;
+    if (failed) {
+        fprintf(stderr, "Ошибка слияния операций: %d\n", err);
+    } else {
+        // Отклонение - от разных округлений fma (одно на устройстве, два в цикле)
+        const double tolerance = 1e-5;
+        int passed = cpu_separate_error <= tolerance && cpu_fused_error <= tolerance
+                     && gpu_separate_error <= tolerance && gpu_fused_error <= tolerance;
+        printf("Ядер сгенерировано: %d за %.3f сек (%s)\n\n", cache.builds, build_time,
+               cache_dir ? "с кэшем программ" : "без кэша программ");
+        printf("                     время, сек   массивов через память   отклонение\n");
+        printf("CPU, три прохода:    %10.6f   %21d   %10.2e\n", cpu_separate, 7,
+               cpu_separate_error);
+        printf("CPU, слитно:         %10.6f   %21d   %10.2e\n", cpu_fused, 3, cpu_fused_error);
+        printf("OpenCL, три ядра:    %10.6f   %21d   %10.2e\n", separate_time, 7,
+               gpu_separate_error);
+        printf("OpenCL, одно ядро:   %10.6f   %21d   %10.2e\n\n", fused_time, 3,
+               gpu_fused_error);
+        if (fused_time > 0) {
+            printf("Ускорение слиянием: CPU %.2fx, OpenCL %.2fx (%.2f ГБ/с)\n",
+                   cpu_fused > 0 ? cpu_separate / cpu_fused : 0.0, separate_time / fused_time,
+                   3.0 * bytes / fused_time / 1e9);
+        }
+        printf("Проверка: %s (допуск %.0e)\n\n", passed ? "PASSED" : "FAILED", tolerance);
+        failed = !passed;
+
+        trace_print(&trace);
+        if (trace_path) {
+            trace_write_chrome(&trace, trace_path);
+        }
+    }
+
+    if (bufferA) clReleaseMemObject(bufferA);
+    if (bufferB) clReleaseMemObject(bufferB);
+    if (bufferT) clReleaseMemObject(bufferT);
+    if (bufferOut) clReleaseMemObject(bufferOut);
+    ew_cl_release(&cache);
+    free(out);
+    free(temp);
+    free(ref);
+    return failed;
+}
+
+// Пакет задач (--batch J): n элементов делятся на J независимых сложений.
+// Первые задачи (не больше BATCH_ISOLATED_JOBS) выполняются по-старому -
+// каждая со своей средой: контекст, очередь, чтение kernel.cl, программа
+// с теми же параметрами options (из кэша программ), буферы. Затем все J задач идут пакетом в общей среде rt: ядро уже
+// собрано, буферы берутся из пула. Возвращает 0 или 1 при ошибке
+int batch_vector_add(cl_runtime* rt, const char* options, const float* A, const float* B,
+                     float* C, size_t n, int job_count) {
+    clrt_job* jobs = (clrt_job*)malloc(job_count * sizeof(clrt_job));
+    if (!jobs) {
+        fprintf(stderr, "Ошибка выделения памяти\n");
+        return 1;
+    }
+    for (int j = 0; j < job_count; j++) {
+        size_t first = n * j / job_count;
+        size_t last = n * (j + 1) / job_count;
+        jobs[j].type = CLRT_VECTOR_ADD;
+        jobs[j].a = A + first;
+        jobs[j].b = B + first;
+        jobs[j].c = C + first;
+        jobs[j].n = (int)(last - first);
+        jobs[j].m = jobs[j].k = 0;
+    }
+    printf("=== Пакет задач ===\n");
+    printf("Задач: %d по ~%zu элементов\n\n", job_count, n / job_count);
+
+    // Каждая задача со своей средой на том же устройстве
+    clrt_device_spec same_device;
+    clrt_default_device(&same_device);
+    same_device.index = rt->device_index;
+    int isolated = job_count < BATCH_ISOLATED_JOBS ? job_count : BATCH_ISOLATED_JOBS;
+    cl_int err = CL_SUCCESS;
+    double isolated_start = get_time();
+    for (int j = 0; j < isolated && err == CL_SUCCESS; j++) {
+        cl_runtime own;
+        size_t length;
+        int from_cache = 0;
+        err = CL_INVALID_VALUE;
+        char* source = clrt_read_source("kernel.cl", &length);
+        if (source && clrt_init(&own, &same_device, rt->cache_dir) == 0) {
+            cl_program program = clrt_build(&own, source, length, options, &from_cache);
+            if (program && clrt_kernel_create(&own, program, "vector_add")) {
+                err = clrt_run_batch(&own, &jobs[j], 1);
+            }
+            clrt_release(&own);
+        }
+        free(source);
+    }
+    double isolated_time = (get_time() - isolated_start) / isolated;
+
+    // Все задачи пакетом в общей среде
+    double batch_time = 0.0;
+    if (err == CL_SUCCESS) {
+        double batch_start = get_time();
+        err = clrt_run_batch(rt, jobs, job_count);
+        batch_time = get_time() - batch_start;
+    }
+    free(jobs);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "Ошибка пакета задач: %d\n", err);
+        return 1;
+    }
+
+    int errors = count_errors(A, B, C, n);
+    printf("Отдельно (своя среда, первые %d): %.6f сек на задачу\n", isolated, isolated_time);
+    printf("Пакетом (общая среда):           %.6f сек на задачу, всего %.6f сек\n",
+           batch_time / job_count, batch_time);
+    printf("Ускорение на задачу: %.2fx\n", isolated_time / (batch_time / job_count));
+    printf("Пул буферов: %d созданий, %d повторных выдач\n", rt->allocations, rt->reuses);
+    printf("Проверка: %s (%d ошибок)\n", errors == 0 ? "PASSED" : "FAILED", errors);
+    return errors != 0;
+}
+
+// Запуск: ./opencl_vector_add                  - синтетические данные
+//         ./opencl_vector_add A.bin B.bin C.bin  - float32 из файлов,
+//         отображенных в память; результат пишется в C.bin
+//         --tune                               - автонастройка vector_add_vec
+//         --tune-cache FILE                    - файл кэша автонастройки
+//         --kernel-cache DIR                   - каталог кэша программ
+//         --no-kernel-cache                    - собирать из исходника
+//         --trace FILE                         - временная шкала команд
+//                                                (Chrome trace JSON)
+//         --memory auto|copy|zero-copy         - копирование в буферы
+//                                                или zero-copy
+//         --stream [--chunk N] [--queues Q]    - потоковый режим кусками
+//         --size N                             - размер синтетических данных
+//         --fused [--width W] [--ept N]        - слияние поэлементных операций
+//         --batch J                            - J задач пакетом в общей среде
+//         --device номер|gpu|cpu|имя           - выбор устройства
+//         --list-devices                       - список устройств
+int main(int argc, char* argv[]) {
+    cl_int err;
+
+    int tune = 0;
+    const char* cache_path = AUTOTUNE_DEFAULT_CACHE;
+    const char* program_cache_dir = CLRT_DEFAULT_CACHE_DIR;
+    const char* trace_path = NULL;
+    int memory_mode = MEMORY_AUTO;
+    int stream = 0;
+    long long chunk = STREAM_DEFAULT_CHUNK;
+    int queue_count = 2;
+    long long size = ARRAY_SIZE;
+    int fused = 0;
+    int width = FUSED_DEFAULT_WIDTH;
+    int ept = FUSED_DEFAULT_EPT;
+    int batch = 0;
+    clrt_device_spec device_spec;
+    clrt_default_device(&device_spec);
+    const char* paths[3];
+    int path_count = 0;
+    int usage_error = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--tune") == 0) {
+            tune = 1;
+        } else if (strcmp(argv[i], "--tune-cache") == 0 && i + 1 < argc) {
+            cache_path = argv[++i];
+        } else if (strcmp(argv[i], "--kernel-cache") == 0 && i + 1 < argc) {
+            program_cache_dir = argv[++i];
+        } else if (strcmp(argv[i], "--no-kernel-cache") == 0) {
+            program_cache_dir = NULL;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--memory") == 0 && i + 1 < argc) {
+            i++;
+            memory_mode = strcmp(argv[i], "auto") == 0 ? MEMORY_AUTO
+                        : strcmp(argv[i], "copy") == 0 ? MEMORY_COPY
+                        : strcmp(argv[i], "zero-copy") == 0 ? MEMORY_ZERO_COPY : -1;
+            usage_error |= memory_mode < 0;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            stream = 1;
+        } else if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc) {
+            chunk = atoll(argv[++i]);
+            usage_error |= chunk < 1 || chunk > INT_MAX;
+        } else if (strcmp(argv[i], "--queues") == 0 && i + 1 < argc) {
+            queue_count = atoi(argv[++i]);
+            usage_error |= queue_count < 1 || queue_count > STREAM_MAX_QUEUES;
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            size = atoll(argv[++i]);
+            usage_error |= size < 1;
+        } else if (strcmp(argv[i], "--fused") == 0) {
+            fused = 1;
+        } else if (strcmp(argv[i], "--width") == 0 && i + 1 < argc) {
+            width = atoi(argv[++i]);
+            usage_error |= width != 1 && width != 2 && width != 4 && width != 8 && width != 16;
+        } else if (strcmp(argv[i], "--ept") == 0 && i + 1 < argc) {
+            ept = atoi(argv[++i]);
+            usage_error |= ept < 1;
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch = atoi(argv[++i]);
+            usage_error |= batch < 1;
+        } else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+            usage_error |= clrt_parse_device(argv[++i], &device_spec) != 0;
+        } else if (strcmp(argv[i], "--list-devices") == 0) {
+            return clrt_list_devices() > 0 ? 0 : 1;
+        } else if (strncmp(argv[i], "--", 2) != 0 && path_count < 3) {
+            paths[path_count++] = argv[i];
+        } else {
+            usage_error = 1;
+        }
+    }
+    if (usage_error || (path_count != 0 && path_count != 3) || stream + fused + (batch > 0) > 1) {
+        fprintf(stderr, "Использование: %s [--tune] [--tune-cache FILE] [--kernel-cache DIR]"
+                " [--no-kernel-cache] [--trace FILE] [--memory auto|copy|zero-copy]"
+                " [--stream] [--chunk N] [--queues 1|2|3] [--size N]"
+                " [--fused] [--width 1|2|4|8|16] [--ept N] [--batch J]"
+                " [--device номер|gpu|cpu|имя] [--list-devices] [A.bin B.bin C.bin]\n",
+                argv[0]);
+        return 1;
+    }
+    int from_files = path_count == 3;
+
+    size_t n = (size_t)size;
+    float* A;
+    float* B;
+    float* C;
+    mapped_file file_a, file_b, file_c;
+
+    if (from_files) {
+        // Входы и выход - отображения файлов, без копирования в malloc-буферы
+        if (mapped_file_open(&file_a, paths[0]) != 0 || mapped_file_open(&file_b, paths[1]) != 0) {
+            return 1;
+        }
+        if (file_a.size != file_b.size || file_a.size < sizeof(float)) {
+            fprintf(stderr, "Ошибка: файлы %s и %s должны быть одного ненулевого размера\n",
+                    paths[0], paths[1]);
+            return 1;
+        }
+        n = file_a.size / sizeof(float);
+        if (mapped_file_create(&file_c, paths[2], n * sizeof(float)) != 0) {
+            return 1;
+        }
+        A = (float*)file_a.data;
+        B = (float*)file_b.data;
+        C = (float*)file_c.data;
+    } else {
+        // Данные для вычислений (выделяем в куче из-за большого размера);
+        // выравнивание по странице нужно для zero-copy, отображения файлов
+        // выровнены и так
+        A = alloc_page_aligned(n);
+        B = alloc_page_aligned(n);
+        C = alloc_page_aligned(n);
+    }
+    // Целиком ядра считают не больше INT_MAX элементов (аргумент int),
+    // потоковый режим - кусками
+    if (!stream && n > INT_MAX) {
+        fprintf(stderr, "Ошибка: %zu элементов - слишком много без --stream\n", n);
+        return 1;
+    }
+    if ((size_t)chunk > n) {
+        chunk = (long long)n;
+    }
+    float* C_cpu = (float*)malloc(n * sizeof(float));  // Для сравнения с CPU
 
     if (!A || !B || !C || !C_cpu) {
         fprintf(stderr, "Ошибка выделения памяти\n");
@@ -67,163 +800,188 @@ int main() {
     }
 
     // Инициализация массивов
-    for (int i = 0; i < ARRAY_SIZE; i++) {
-        A[i] = (float)i;
-        B[i] = (float)(i * 2);
+    if (!from_files) {
+        for (size_t i = 0; i < n; i++) {
+            A[i] = (float)i;
+            B[i] = (float)(i * 2);
+        }
     }
 
     printf("=== OpenCL Vector Addition ===\n");
-    printf("Размер массива: %d элементов (%.2f MB)\n\n", ARRAY_SIZE,
-           (float)(ARRAY_SIZE * sizeof(float)) / (1024 * 1024));
+    if (from_files) {
+        printf("Данные: %s + %s -> %s (отображены в память)\n", paths[0], paths[1], paths[2]);
+    }
+    printf("Размер массива: %zu элементов (%.2f MB)\n\n", n,
+           (float)(n * sizeof(float)) / (1024 * 1024));
 
     // ========================================
     // Измерение времени на CPU (последовательное выполнение)
     // ========================================
 
     double cpu_start = get_time();
-    for (int i = 0; i < ARRAY_SIZE; i++) {
+    for (size_t i = 0; i < n; i++) {
         C_cpu[i] = A[i] + B[i];
     }
     double cpu_end = get_time();
     double cpu_time = cpu_end - cpu_start;
 
     // Используем результат, чтобы компилятор не удалил вычисления
-    volatile float dummy = C_cpu[ARRAY_SIZE / 2];
+    volatile float dummy = C_cpu[n / 2];
     (void)dummy;
 
     printf("CPU (последовательно): %.6f сек\n\n", cpu_time);
 
     // ========================================
-    // Шаг 1: Инициализация платформы и устройства
+    // Шаг 1-2: Среда OpenCL (устройство, контекст, очередь)
     // ========================================
 
-    cl_platform_id platform;
-    err = clGetPlatformIDs(1, &platform, NULL);
-    if (err != CL_SUCCESS) {
-        fprintf(stderr, "Ошибка получения платформы: %d\n", err);
-        return 1;
-    }
-
-    // Получение информации о платформе
-    char platform_name[256];
-    clGetPlatformInfo(platform, CL_PLATFORM_NAME, sizeof(platform_name), platform_name, NULL);
-    printf("Платформа: %s\n", platform_name);
-
-    cl_device_id device;
-    err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &device, NULL);
-    if (err != CL_SUCCESS) {
-        // Если GPU недоступен, пробуем CPU
-        printf("GPU не найден, используем CPU...\n");
-        err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &device, NULL);
-        if (err != CL_SUCCESS) {
-            fprintf(stderr, "Ошибка получения устройства: %d\n", err);
-            return 1;
-        }
-    }
-
-    // Получение информации об устройстве
-    char device_name[256];
-    clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(device_name), device_name, NULL);
-    printf("Устройство: %s\n\n", device_name);
-
-    // ========================================
-    // Шаг 2: Создание контекста и командной очереди
-    // ========================================
+    // Время запуска OpenCL: от платформы до готовых ядер (без автонастройки)
+    double startup_start = get_time();
 
-    cl_context context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
-    if (err != CL_SUCCESS) {
-        fprintf(stderr, "Ошибка создания контекста: %d\n", err);
+    // Платформа и устройство (--device или первый GPU), контекст и
+    // очередь с профилированием - в общей среде OpenCL
+    cl_runtime rt;
+    if (clrt_init(&rt, &device_spec, program_cache_dir) != 0) {
         return 1;
     }
-    printf("Контекст создан успешно\n");
+    cl_device_id device = rt.device;
+    cl_context context = rt.context;
+    cl_command_queue queue = rt.queue;
+    printf("Платформа: %s\n", rt.platform_name);
+    printf("Устройство: %s\n", rt.device_name);
 
-    // Создание командной очереди (используем deprecated функцию для совместимости)
-#ifdef CL_VERSION_2_0
-    cl_command_queue queue = clCreateCommandQueueWithProperties(context, device, 0, &err);
-#else
-    cl_command_queue queue = clCreateCommandQueue(context, device, 0, &err);
-#endif
-    if (err != CL_SUCCESS) {
-        fprintf(stderr, "Ошибка создания очереди: %d\n", err);
-        clReleaseContext(context);
-        return 1;
-    }
-    printf("Командная очередь создана успешно\n");
+    // Общая с хостом память (CPU, встроенная графика): копирование в
+    // буферы и обратно - лишний проход по памяти
+    cl_bool unified = CL_FALSE;
+    clGetDeviceInfo(device, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(unified), &unified, NULL);
+    int zero_copy = memory_mode == MEMORY_ZERO_COPY || (memory_mode == MEMORY_AUTO && unified);
+    printf("Память: %s (общая с хостом: %s)\n\n", zero_copy ? "zero-copy" : "копирование",
+           unified ? "да" : "нет");
 
     // ========================================
     // Шаг 3: Загрузка и компиляция ядра
     // ========================================
 
     size_t kernel_length;
-    char* kernel_source = read_kernel_file("kernel.cl", &kernel_length);
+    char* kernel_source = clrt_read_source("kernel.cl", &kernel_length);
     if (!kernel_source) {
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
+        clrt_release(&rt);
         return 1;
     }
 
-    cl_program program = clCreateProgramWithSource(context, 1,
-                                                   (const char**)&kernel_source,
-                                                   &kernel_length, &err);
-    free(kernel_source);
-
-    if (err != CL_SUCCESS) {
-        fprintf(stderr, "Ошибка создания программы: %d\n", err);
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
-        return 1;
+    double tune_time = 0.0;
+    if (tune) {
+        double tune_start = get_time();
+        tune_vector_add(context, device, queue, kernel_source, kernel_length, A, B, n,
+                        cache_path);
+        tune_time = get_time() - tune_start;
     }
 
-    // Компиляция программы
-    err = clBuildProgram(program, 1, &device, NULL, NULL, NULL);
-    if (err != CL_SUCCESS) {
-        fprintf(stderr, "Ошибка компиляции программы: %d\n", err);
-
-        // Вывод лога ошибок компиляции
-        size_t log_size;
-        clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
-        char* log = (char*)malloc(log_size);
-        clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, log_size, log, NULL);
-        fprintf(stderr, "Лог компиляции:\n%s\n", log);
-        free(log);
+    // VEC и группа vector_add_vec из кэша автонастройки, если они есть
+    int vec = DEFAULT_VEC;
+    size_t vec_local = 0;
+    char key[AUTOTUNE_MAX_LINE];
+    char value[64];
+    autotune_key(device, "vector_add_vec", key, sizeof(key));
+    if (autotune_cache_load(cache_path, key, value, sizeof(value)) == 0) {
+        int cached_vec;
+        size_t cached_local;
+        if (sscanf(value, "%d %zu", &cached_vec, &cached_local) == 2 && cached_vec > 0) {
+            vec = cached_vec;
+            vec_local = cached_local;
+            printf("vector_add_vec: VEC %d, группа %zu из кэша автонастройки\n", vec, vec_local);
+        }
+    }
 
-        clReleaseProgram(program);
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
+    // Компиляция программы (или двоичный код из кэша программ)
+    char build_options[32];
+    snprintf(build_options, sizeof(build_options), "-DVEC=%d", vec);
+    int from_cache = 0;
+    double build_start = get_time();
+    cl_program program = clrt_build(&rt, kernel_source, kernel_length, build_options,
+                                    &from_cache);
+    double build_time = get_time() - build_start;
+    free(kernel_source);
+    if (!program) {
+        clrt_release(&rt);
         return 1;
     }
     printf("Ядро скомпилировано успешно\n");
 
-    // Создание объекта ядра
-    cl_kernel kernel = clCreateKernel(program, "vector_add", &err);
-    if (err != CL_SUCCESS) {
-        fprintf(stderr, "Ошибка создания ядра: %d\n", err);
-        clReleaseProgram(program);
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
+    // Создание объектов ядер (освобождаются вместе со средой)
+    cl_kernel kernel = clrt_kernel_create(&rt, program, "vector_add");
+    cl_kernel vec_kernel = kernel ? clrt_kernel_create(&rt, program, "vector_add_vec") : NULL;
+    if (!vec_kernel) {
+        clrt_release(&rt);
         return 1;
     }
-    printf("Ядро создано успешно\n\n");
+    double startup_time = get_time() - startup_start - tune_time;
+    printf("Ядро создано успешно\n");
+    const char* build_source = from_cache ? "двоичный код из кэша" : "из исходника";
+    printf("Запуск OpenCL: %.3f сек, из них сборка программы %.3f сек (%s)\n\n",
+           startup_time, build_time, build_source);
+
+    // Потоковый режим (вместо целых буферов - куски), слияние операций
+    // (свои буферы и ядра) и пакет задач (буферы из пула): шаги 4-6 не нужны
+    if (stream || fused || batch) {
+        int failed;
+        if (stream) {
+            failed = stream_vector_add(context, device, vec_kernel, vec, vec_local, A, B, C, n,
+                                       (size_t)chunk, queue_count, trace_path);
+            int stream_errors = failed ? 0 : count_errors(A, B, C, n);
+            if (!failed) {
+                printf("Проверка: %s (%d ошибок)\n", stream_errors == 0 ? "PASSED" : "FAILED",
+                       stream_errors);
+            }
+            failed = failed || stream_errors != 0;
+        } else if (fused) {
+            failed = fused_vector_demo(context, device, queue, A, B, n, width, ept,
+                                       program_cache_dir, trace_path);
+        } else {
+            failed = batch_vector_add(&rt, build_options, A, B, C, n, batch);
+        }
+
+        clrt_release(&rt);
+        if (from_files) {
+            mapped_file_close(&file_a);
+            mapped_file_close(&file_b);
+            mapped_file_close(&file_c);
+            if (!fused && !failed) {
+                printf("Результат записан в %s\n", paths[2]);
+            }
+        } else {
+            free(A);
+            free(B);
+            free(C);
+        }
+        free(C_cpu);
+        return failed;
+    }
 
     // ========================================
     // Шаг 4: Подготовка данных (буферы)
     // ========================================
 
-    size_t buffer_size = ARRAY_SIZE * sizeof(float);
+    size_t buffer_size = n * sizeof(float);
 
-    cl_mem bufferA = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-                                    buffer_size, A, &err);
-    cl_mem bufferB = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-                                    buffer_size, B, &err);
-    cl_mem bufferC = clCreateBuffer(context, CL_MEM_WRITE_ONLY,
-                                    buffer_size, NULL, &err);
+    // При копировании входные данные записываются явно (ниже), а не через
+    // CL_MEM_COPY_HOST_PTR: так время передачи видно по событиям.
+    // При zero-copy буферы лежат прямо на A, B и C
+    cl_mem bufferA, bufferB, bufferC;
+    if (zero_copy) {
+        bufferA = create_zero_copy_buffer(context, CL_MEM_READ_ONLY, A, buffer_size, 1, &err);
+        bufferB = create_zero_copy_buffer(context, CL_MEM_READ_ONLY, B, buffer_size, 1, &err);
+        bufferC = create_zero_copy_buffer(context, CL_MEM_WRITE_ONLY, C, buffer_size, 0, &err);
+    } else {
+        bufferA = clCreateBuffer(context, CL_MEM_READ_ONLY, buffer_size, NULL, &err);
+        bufferB = clCreateBuffer(context, CL_MEM_READ_ONLY, buffer_size, NULL, &err);
+        bufferC = clCreateBuffer(context, CL_MEM_WRITE_ONLY,
+                                 buffer_size, NULL, &err);
+    }
 
     if (!bufferA || !bufferB || !bufferC) {
         fprintf(stderr, "Ошибка создания буферов\n");
-        clReleaseKernel(kernel);
-        clReleaseProgram(program);
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
+        clrt_release(&rt);
         return 1;
     }
     printf("Буферы созданы успешно\n");
@@ -233,82 +991,173 @@ int main() {
     clSetKernelArg(kernel, 1, sizeof(cl_mem), &bufferB);
     clSetKernelArg(kernel, 2, sizeof(cl_mem), &bufferC);
 
+    int count = (int)n;
+    clSetKernelArg(vec_kernel, 0, sizeof(cl_mem), &bufferA);
+    clSetKernelArg(vec_kernel, 1, sizeof(cl_mem), &bufferB);
+    clSetKernelArg(vec_kernel, 2, sizeof(cl_mem), &bufferC);
+    clSetKernelArg(vec_kernel, 3, sizeof(int), &count);
+
     // ========================================
     // Шаг 5: Выполнение ядра и считывание результатов
     // ========================================
 
-    size_t global_size = ARRAY_SIZE;
+    size_t global_size = n;
+    cl_trace trace;
+    trace_init(&trace);
 
-    printf("Запуск ядра с %zu work-items...\n", global_size);
+    // Время каждой команды - по ее событию (START..END); по часам хоста
+    // замеряется весь путь запись - ядро - чтение, чтобы видеть накладные
+    // расходы между командами
+    double host_start = get_time();
+    cl_event write_events[2];
+    cl_uint write_count = 0;
+    if (!zero_copy) {
+        err = clEnqueueWriteBuffer(queue, bufferA, CL_FALSE, 0, buffer_size, A, 0, NULL,
+                                   &write_events[0]);
+        if (err == CL_SUCCESS) {
+            err = clEnqueueWriteBuffer(queue, bufferB, CL_FALSE, 0, buffer_size, B, 0, NULL,
+                                       &write_events[1]);
+            if (err != CL_SUCCESS) {
+                clReleaseEvent(write_events[0]);
+            }
+        }
+        write_count = 2;
+    }
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "Ошибка записи данных: %d\n", err);
+        clReleaseMemObject(bufferA);
+        clReleaseMemObject(bufferB);
+        clReleaseMemObject(bufferC);
+        clrt_release(&rt);
+        return 1;
+    }
 
-    // Измерение времени выполнения OpenCL (только ядро)
-    double opencl_start = get_time();
+    printf("Запуск ядра с %zu work-items...\n", global_size);
 
-    err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_size, NULL, 0, NULL, NULL);
+    // Ядро ждет обе записи (очередь по порядку, но так зависимость явная)
+    cl_event kernel_event;
+    err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_size, NULL, write_count,
+                                 write_count ? write_events : NULL, &kernel_event);
+    double write_time = 0.0;
+    if (write_count > 0) {
+        write_time = trace_add(&trace, "write", "запись A", write_events[0])
+                     + trace_add(&trace, "write", "запись B", write_events[1]);
+    }
     if (err != CL_SUCCESS) {
         fprintf(stderr, "Ошибка запуска ядра: %d\n", err);
         clReleaseMemObject(bufferA);
         clReleaseMemObject(bufferB);
         clReleaseMemObject(bufferC);
-        clReleaseKernel(kernel);
-        clReleaseProgram(program);
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
+        clrt_release(&rt);
         return 1;
     }
+    double opencl_kernel_time = trace_add(&trace, "kernel", "vector_add", kernel_event);
 
-    // Ожидание завершения выполнения
-    clFinish(queue);
-
-    double opencl_kernel_time = get_time() - opencl_start;
-
-    // Считывание результатов
-    double read_start = get_time();
-    err = clEnqueueReadBuffer(queue, bufferC, CL_TRUE, 0, buffer_size, C, 0, NULL, NULL);
+    // Считывание результатов (при zero-copy - отображение C)
+    double read_time = -1.0;
+    err = fetch_result(queue, bufferC, C, buffer_size, zero_copy, &trace,
+                       zero_copy ? "map C" : "чтение C", &read_time);
     if (err != CL_SUCCESS) {
         fprintf(stderr, "Ошибка чтения результатов: %d\n", err);
     }
-    double read_time = get_time() - read_start;
+    double host_time = get_time() - host_start;
+    int errors = count_errors(A, B, C, n);
 
     printf("Ядро выполнено успешно!\n\n");
 
+    // ========================================
+    // Шаг 6: vector_add_vec (VEC элементов на рабочий элемент)
+    // ========================================
+
+    char local_text[32] = "NULL";
+    if (vec_local > 0) {
+        snprintf(local_text, sizeof(local_text), "%zu", vec_local);
+    }
+    size_t vec_global = vec_global_size(n, vec, vec_local);
+    printf("Запуск vector_add_vec: VEC %d, %zu work-items, группа %s...\n", vec, vec_global,
+           local_text);
+
+    // Прогревочный запуск: первый запуск с новой группой может компилироваться
+    double vec_kernel_time = -1.0;
+    int vec_errors = 0;
+    err = clEnqueueNDRangeKernel(queue, vec_kernel, 1, NULL, &vec_global,
+                                 vec_local ? &vec_local : NULL, 0, NULL, NULL);
+    clFinish(queue);
+    if (err == CL_SUCCESS) {
+        cl_event vec_event;
+        err = clEnqueueNDRangeKernel(queue, vec_kernel, 1, NULL, &vec_global,
+                                     vec_local ? &vec_local : NULL, 0, NULL, &vec_event);
+        if (err == CL_SUCCESS) {
+            vec_kernel_time = trace_add(&trace, "kernel", "vector_add_vec", vec_event);
+        }
+    }
+    if (err == CL_SUCCESS) {
+        double vec_read_time;
+        err = fetch_result(queue, bufferC, C, buffer_size, zero_copy, &trace,
+                           zero_copy ? "map C (vector_add_vec)" : "чтение C (vector_add_vec)",
+                           &vec_read_time);
+    }
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "Ошибка запуска vector_add_vec: %d\n", err);
+        vec_kernel_time = -1.0;
+    } else {
+        vec_errors = count_errors(A, B, C, n);
+        printf("Ядро выполнено успешно!\n\n");
+    }
+
     // ========================================
     // Сравнение времени выполнения
     // ========================================
 
+    trace_print(&trace);
+    if (trace_path) {
+        trace_write_chrome(&trace, trace_path);
+        printf("\n");
+    }
+
     printf("=== Сравнение времени выполнения ===\n");
     printf("CPU (последовательно):    %.6f сек\n", cpu_time);
+    const char* memory_note = zero_copy ? " (zero-copy: без записи, чтение - map)" : "";
+    printf("OpenCL (запись данных):   %.6f сек%s\n", write_time, memory_note);
     printf("OpenCL (только ядро):     %.6f сек\n", opencl_kernel_time);
-    printf("OpenCL (чтение данных):   %.6f сек\n", read_time);
+    printf("OpenCL (чтение данных):   %.6f сек%s\n", read_time, memory_note);
     printf("OpenCL (ядро + чтение):   %.6f сек\n", opencl_kernel_time + read_time);
+    printf("OpenCL (все команды):     %.6f сек\n", write_time + opencl_kernel_time + read_time);
+    printf("Хост (запись..чтение):    %.6f сек\n", host_time);
+    if (vec_kernel_time > 0) {
+        printf("OpenCL VEC %-2d (ядро):     %.6f сек\n", vec, vec_kernel_time);
+    }
     printf("\n");
 
     if (opencl_kernel_time > 0) {
         printf("Ускорение (только ядро):  %.2fx\n", cpu_time / opencl_kernel_time);
-        printf("Ускорение (с передачей):  %.2fx\n", cpu_time / (opencl_kernel_time + read_time));
+        printf("Ускорение (с передачей):  %.2fx\n",
+               cpu_time / (write_time + opencl_kernel_time + read_time));
+    }
+    if (vec_kernel_time > 0) {
+        printf("vector_add_vec относительно vector_add: %.2fx\n",
+               opencl_kernel_time / vec_kernel_time);
     }
     printf("\n");
 
     // Вывод результатов (первые и последние 5 элементов)
     printf("=== Результаты ===\n");
     printf("Первые 5 элементов:\n");
-    for (int i = 0; i < 5; i++) {
-        printf("  A[%d] + B[%d] = %.1f + %.1f = %.1f\n", i, i, A[i], B[i], C[i]);
+    for (size_t i = 0; i < 5 && i < n; i++) {
+        printf("  A[%zu] + B[%zu] = %.1f + %.1f = %.1f\n", i, i, A[i], B[i], C[i]);
     }
     printf("...\n");
     printf("Последние 5 элементов:\n");
-    for (int i = ARRAY_SIZE - 5; i < ARRAY_SIZE; i++) {
-        printf("  A[%d] + B[%d] = %.1f + %.1f = %.1f\n", i, i, A[i], B[i], C[i]);
+    for (size_t i = n < 5 ? 0 : n - 5; i < n; i++) {
+        printf("  A[%zu] + B[%zu] = %.1f + %.1f = %.1f\n", i, i, A[i], B[i], C[i]);
     }
 
-    // Проверка корректности
-    int errors = 0;
-    for (int i = 0; i < ARRAY_SIZE; i++) {
-        if (C[i] != A[i] + B[i]) {
-            errors++;
-        }
+    // Проверка корректности (C выше - результат последнего ядра)
+    printf("\nПроверка vector_add: %s (%d ошибок)\n", errors == 0 ? "PASSED" : "FAILED", errors);
+    if (vec_kernel_time > 0) {
+        printf("Проверка vector_add_vec: %s (%d ошибок)\n",
+               vec_errors == 0 ? "PASSED" : "FAILED", vec_errors);
     }
-    printf("\nПроверка: %s (%d ошибок)\n", errors == 0 ? "PASSED" : "FAILED", errors);
 
     // ========================================
     // Освобождение ресурсов
@@ -317,15 +1166,19 @@ int main() {
     clReleaseMemObject(bufferA);
     clReleaseMemObject(bufferB);
     clReleaseMemObject(bufferC);
-    clReleaseKernel(kernel);
-    clReleaseProgram(program);
-    clReleaseCommandQueue(queue);
-    clReleaseContext(context);
-
-    // Освобождение памяти хоста
-    free(A);
-    free(B);
-    free(C);
+    clrt_release(&rt);
+
+    // Освобождение памяти хоста (результат в файле сбрасывается на диск)
+    if (from_files) {
+        mapped_file_close(&file_a);
+        mapped_file_close(&file_b);
+        mapped_file_close(&file_c);
+        printf("Результат записан в %s\n", paths[2]);
+    } else {
+        free(A);
+        free(B);
+        free(C);
+    }
     free(C_cpu);
 
     printf("\nРесурсы освобождены. Программа завершена.\n");
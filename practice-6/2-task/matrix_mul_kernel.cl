@@ -19,3 +19,119 @@ __kernel void matrix_multiply(__global const float* A,
 
     C[row * K + col] = sum;
 }
+
+// Параметры плиточного ядра задаются при сборке (-DTILE=16 -DWPT=4):
+// TILE - сторона плитки, WPT - элементов C на рабочий элемент
+// (TILE должно делиться на WPT)
+#ifndef TILE
+#define TILE 16
+#endif
+#ifndef WPT
+#define WPT 4
+#endif
+#define RTS (TILE / WPT)  // Рабочих элементов по строкам плитки
+
+// Плиточное умножение: рабочая группа TILE x RTS считает плитку C
+// TILE x TILE. Плитки A и B по очереди загружаются в локальную память,
+// каждый рабочий элемент копит WPT элементов столбца C в регистрах.
+// Измерение 0 - столбцы C (соседние элементы читают соседние адреса),
+// измерение 1 - строки C с шагом RTS
+__kernel void matrix_multiply_tiled(__global const float* A,
+                                    __global const float* B,
+                                    __global float* C,
+                                    const int N,
+                                    const int M,
+                                    const int K) {
+    const int lcol = get_local_id(0);
+    const int lrow = get_local_id(1);
+    const int col = get_group_id(0) * TILE + lcol;  // Столбец в C (и B)
+    const int first_row = get_group_id(1) * TILE;   // Первая строка плитки C
+
+    __local float Asub[TILE][TILE];
+    __local float Bsub[TILE][TILE];
+
+    float acc[WPT];
+    for (int w = 0; w < WPT; w++) {
+        acc[w] = 0.0f;
+    }
+
+    const int tiles = (M + TILE - 1) / TILE;
+    for (int t = 0; t < tiles; t++) {
+        // Загрузка плиток; за краями матриц - нули
+        const int a_col = t * TILE + lcol;
+        for (int w = 0; w < WPT; w++) {
+            const int r = lrow + w * RTS;
+            const int a_row = first_row + r;
+            const int b_row = t * TILE + r;
+            Asub[r][lcol] = (a_row < N && a_col < M) ? A[a_row * M + a_col] : 0.0f;
+            Bsub[r][lcol] = (b_row < M && col < K) ? B[b_row * K + col] : 0.0f;
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for (int i = 0; i < TILE; i++) {
+            const float b = Bsub[i][lcol];
+            for (int w = 0; w < WPT; w++) {
+                acc[w] += Asub[lrow + w * RTS][i] * b;
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    for (int w = 0; w < WPT; w++) {
+        const int row = first_row + lrow + w * RTS;
+        if (row < N && col < K) {
+            C[row * K + col] = acc[w];
+        }
+    }
+}
+
+// Пакет малых умножений C_b = A_b * B_b (b < count): один рабочий элемент -
+// один элемент C, элементы всех матриц пакета пронумерованы подряд.
+// Рабочая группа из G элементов покрывает G / (N * K) малых матриц
+// целиком (для 8x8 при группе 256 - четыре), соседние элементы строки C
+// читают соседние адреса B. Один запуск вместо запуска на матрицу
+inline void small_multiply(__global const float* A, __global const float* B,
+                           __global float* C, int row, int col, int M, int K) {
+    float sum = 0.0f;
+    for (int i = 0; i < M; i++) {
+        sum += A[row * M + i] * B[i * K + col];
+    }
+    C[row * K + col] = sum;
+}
+
+// Шаговый пакет: матрица b начинается с b * stride (в элементах)
+__kernel void matrix_multiply_batched(__global const float* A,
+                                      __global const float* B,
+                                      __global float* C,
+                                      const int N,
+                                      const int M,
+                                      const int K,
+                                      const int count,
+                                      const int stride_a,
+                                      const int stride_b,
+                                      const int stride_c) {
+    const int id = get_global_id(0);
+    const int b = id / (N * K);
+    if (b >= count) return;
+    const int element = id - b * (N * K);
+    small_multiply(A + b * stride_a, B + b * stride_b, C + b * stride_c,
+                   element / K, element % K, M, K);
+}
+
+// Пакет по смещениям: offsets[3 * b + 0..2] - начала A_b, B_b и C_b в
+// буферах (аналог массива указателей на хосте)
+__kernel void matrix_multiply_batched_indexed(__global const float* A,
+                                              __global const float* B,
+                                              __global float* C,
+                                              __global const int* offsets,
+                                              const int N,
+                                              const int M,
+                                              const int K,
+                                              const int count) {
+    const int id = get_global_id(0);
+    const int b = id / (N * K);
+    if (b >= count) return;
+    const int element = id - b * (N * K);
+    small_multiply(A + offsets[3 * b], B + offsets[3 * b + 1], C + offsets[3 * b + 2],
+                   element / K, element % K, M, K);
+}
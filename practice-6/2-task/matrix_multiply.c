@@ -1,7 +1,19 @@
+#ifdef __linux__
+#define _GNU_SOURCE  // sched_setaffinity для привязки потоков
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
+#include <limits.h>
+
+#include "../common/omp_scaling.h"
+#include "../common/gemm.h"
+#include "../common/cl_autotune.h"
+#include "../common/cl_trace.h"
+#include "../common/cl_runtime.h"
 
 #ifdef __APPLE__
 #include <OpenCL/opencl.h>
@@ -10,11 +22,42 @@
 #include <CL/cl.h>
 #endif
 
-// Размеры матриц: A[N x M], B[M x K], C[N x K]
+// Размеры матриц по умолчанию: A[N x M], B[M x K], C[N x K]
+// (другие - ключом --dims)
 #define N 512
 #define M 512
 #define K 512
 
+// Плиточное ядро: сторона плитки в локальной памяти и число элементов C
+// на рабочий элемент (передаются в ядро через -DTILE и -DWPT).
+// Значения по умолчанию; автонастройка (--tune) подбирает свои
+#define TILE_SIZE 16
+#define TILE_WPT 4
+
+// Запусков на вариант при автонастройке (плюс прогревочный)
+#define TUNE_REPS 3
+
+// Варианты ядра (--kernel)
+#define KERNEL_NAIVE 1
+#define KERNEL_TILED 2
+
+// Пакет задач (--batch): сколько первых задач выполнить каждую со своей
+// средой OpenCL для сравнения
+#define BATCH_ISOLATED_JOBS 8
+
+// Разбиение по устройствам (--multi-device): исполнители - все устройства
+// OpenCL и потоки OpenMP хоста; строк C в большом калибровочном запуске
+// (малый - вчетверо меньше)
+#define MULTI_MAX_WORKERS (CLRT_MAX_DEVICES + 1)
+#define MULTI_CALIBRATION_ROWS 64
+
+// Пакет малых умножений (--batched-gemm): сторона матриц без --dims,
+// сколько первых произведений считать по одному существующим ядром
+// и рабочая группа пакетного ядра
+#define BATCHED_DEFAULT_DIM 32
+#define BATCHED_LOOP_JOBS 256
+#define BATCHED_GROUP 256
+
 // Функция для получения времени в секундах
 double get_time() {
 #ifdef __APPLE__
@@ -30,34 +73,30 @@ double get_time() {
 #endif
 }
 
-// Функция для чтения файла ядра
-char* read_kernel_file(const char* filename, size_t* length) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        fprintf(stderr, "Ошибка: не удалось открыть файл %s\n", filename);
-        return NULL;
-    }
-
-    fseek(file, 0, SEEK_END);
-    *length = ftell(file);
-    rewind(file);
-
-    char* source = (char*)malloc(*length + 1);
-    if (!source) {
-        fclose(file);
-        return NULL;
+// Последовательное умножение матриц на CPU
+void matrix_multiply_cpu(const float* A, const float* B, float* C,
+                         int n, int m, int k) {
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < k; j++) {
+            float sum = 0.0f;
+            for (int l = 0; l < m; l++) {
+                sum += A[i * m + l] * B[l * k + j];
+            }
+            C[i * k + j] = sum;
+        }
     }
+}
 
-    fread(source, 1, *length, file);
-    source[*length] = '\0';
-    fclose(file);
-
-    return source;
+// GFLOP/s умножения A[n x m] * B[m x k]: 2 * n * m * k операций
+double gemm_gflops(int n, int m, int k, double seconds) {
+    return seconds > 0 ? 2.0 * n * m * k / seconds / 1e9 : 0;
 }
 
-// Последовательное умножение матриц на CPU
-void matrix_multiply_cpu(const float* A, const float* B, float* C,
-                         int n, int m, int k) {
+// Параллельное умножение на CPU: строки C делятся между потоками
+// статически, тот же цикл i-j-l, что и в последовательной версии
+void matrix_multiply_cpu_parallel(const float* A, const float* B, float* C,
+                                  int n, int m, int k) {
+    #pragma omp parallel for schedule(static)
     for (int i = 0; i < n; i++) {
         for (int j = 0; j < k; j++) {
             float sum = 0.0f;
@@ -69,19 +108,101 @@ void matrix_multiply_cpu(const float* A, const float* B, float* C,
     }
 }
 
-// Проверка корректности результатов
-int verify_results(const float* C_gpu, const float* C_cpu, int n, int k) {
+// Заполнение матрицы rows x cols со статическим разбиением строк, как
+// в matrix_multiply_cpu_parallel и в цикле блоков строк gemm_multiply:
+// страницы строк A и C попадают на узел NUMA потока, который их потом
+// считает (first touch). B читают все потоки, ее страницы просто
+// распределяются по узлам
+void init_matrix_first_touch(float* X, int rows, int cols, unsigned seed) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            unsigned h = ((unsigned)(i * cols + j) + seed) * 2654435761u;
+            X[(size_t)i * cols + j] = (float)((h >> 16) % 100) / 10.0f;
+        }
+    }
+}
+
+// Одна точка масштабирования: медиана reps запусков умножения
+// A[n x size] * B[size x size] блочным GEMM или наивным циклом
+double measure_cpu_parallel(int n, int size, int reps, int blocked) {
+    float* A = (float*)malloc((size_t)n * size * sizeof(float));
+    float* B = (float*)malloc((size_t)size * size * sizeof(float));
+    float* C = (float*)malloc((size_t)n * size * sizeof(float));
+    if (!A || !B || !C) {
+        fprintf(stderr, "Ошибка выделения памяти\n");
+        exit(1);
+    }
+    init_matrix_first_touch(A, n, size, 1);
+    init_matrix_first_touch(B, size, size, 2);
+    init_matrix_first_touch(C, n, size, 0);
+
+    void (*multiply)(const float*, const float*, float*, int, int, int) =
+        blocked ? gemm_multiply : matrix_multiply_cpu_parallel;
+
+    double samples[SCALING_MAX_POINTS];
+    multiply(A, B, C, n, size, size);  // Прогрев
+    for (int r = 0; r < reps; r++) {
+        double start = get_time();
+        multiply(A, B, C, n, size, size);
+        samples[r] = get_time() - start;
+    }
+
+    free(A);
+    free(B);
+    free(C);
+    return scaling_median(samples, reps);
+}
+
+// Режим масштабирования CPU умножения по числу потоков
+// Сильное: матрицы size x size; слабое: строк A и C - size * p,
+// то есть работа растет вместе с числом потоков
+int run_scaling(int modes, int size, const int* threads, int thread_count,
+                int reps, scaling_pinning* pin, int blocked) {
+    printf("=== Масштабирование CPU умножения матриц ===\n");
+#ifndef _OPENMP
+    printf("ВНИМАНИЕ: собрано без OpenMP - все точки в одном потоке\n");
+#endif
+    if (scaling_plan(pin) != 0) {
+        printf("Привязка потоков недоступна, потоки не привязаны\n");
+    }
+    printf("Привязано к процессорам: %d\n\n", pin->cpu_count);
+
+    for (int weak = 0; weak <= 1; weak++) {
+        if (!(modes & (1 << weak))) {
+            continue;
+        }
+        scaling_point points[SCALING_MAX_POINTS];
+        for (int t = 0; t < thread_count; t++) {
+            scaling_pin_threads(pin, threads[t]);
+            int rows = weak ? size * threads[t] : size;
+            points[t].threads = threads[t];
+            points[t].size = rows;
+            points[t].seconds = measure_cpu_parallel(rows, size, reps, blocked);
+        }
+        scaling_print_table(blocked ? "gemm_multiply (строк C)"
+                                    : "matrix_multiply_cpu_parallel (строк C)",
+                            weak, points, thread_count);
+    }
+    return 0;
+}
+
+// Проверка корректности результатов против последовательной версии
+// Погрешность относительная: другой порядок сложения и FMA (блочный GEMM,
+// GPU) дают расхождение порядка m * eps от величины элемента
+int verify_results(const float* C_test, const float* C_cpu, int n, int k, const char* label) {
     int errors = 0;
     float max_diff = 0.0f;
 
-    for (int i = 0; i < n * k; i++) {
-        float diff = fabs(C_gpu[i] - C_cpu[i]);
+    for (size_t i = 0; i < (size_t)n * k; i++) {
+        float diff = fabsf(C_test[i] - C_cpu[i]);
         if (diff > max_diff) max_diff = diff;
-        if (diff > 1e-3) {  // Допустимая погрешность для float
+        float scale = fabsf(C_cpu[i]) > 1.0f ? fabsf(C_cpu[i]) : 1.0f;
+        if (diff > 1e-4f * scale) {
             errors++;
             if (errors <= 5) {
-                printf("  Ошибка в позиции %d: GPU=%.6f, CPU=%.6f, diff=%.6f\n",
-                       i, C_gpu[i], C_cpu[i], diff);
+                printf("  Ошибка в позиции %zu: %s=%.6f, CPU=%.6f, diff=%.6f\n",
+                       i, label, C_test[i], C_cpu[i], diff);
             }
         }
     }
@@ -90,34 +211,1141 @@ int verify_results(const float* C_gpu, const float* C_cpu, int n, int k) {
     return errors;
 }
 
-int main() {
+// Аргументы обоих ядер одинаковые: A, B, C, N, M, K
+void set_matmul_args(cl_kernel kernel, cl_mem bufferA, cl_mem bufferB, cl_mem bufferC,
+                     int n, int m, int k) {
+    clSetKernelArg(kernel, 0, sizeof(cl_mem), &bufferA);
+    clSetKernelArg(kernel, 1, sizeof(cl_mem), &bufferB);
+    clSetKernelArg(kernel, 2, sizeof(cl_mem), &bufferC);
+    clSetKernelArg(kernel, 3, sizeof(int), &n);
+    clSetKernelArg(kernel, 4, sizeof(int), &m);
+    clSetKernelArg(kernel, 5, sizeof(int), &k);
+}
+
+// Запуск ядра умножения и чтение C. Первый запуск - прогревочный:
+// реализации вроде POCL компилируют код рабочей группы при первом
+// запуске с новым локальным размером. Время ядра и чтения - по событиям
+// профилирования, команды попадают в trace под именем name.
+// Возвращает CL_SUCCESS или код ошибки
+cl_int run_matmul_kernel(cl_command_queue queue, cl_kernel kernel, cl_mem bufferC,
+                         float* C, size_t size_C, const size_t* global_size,
+                         const size_t* local_size, cl_trace* trace, const char* name,
+                         double* kernel_time, double* read_time) {
+    cl_int err = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, global_size, local_size,
+                                        0, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    clFinish(queue);
+
+    cl_event kernel_event;
+    err = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, global_size, local_size,
+                                 0, NULL, &kernel_event);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    *kernel_time = trace_add(trace, "kernel", name, kernel_event);
+
+    char read_name[64];
+    snprintf(read_name, sizeof(read_name), "чтение C (%s)", name);
+    cl_event read_event;
+    err = clEnqueueReadBuffer(queue, bufferC, CL_TRUE, 0, size_C, C, 0, NULL, &read_event);
+    if (err == CL_SUCCESS) {
+        *read_time = trace_add(trace, "read", read_name, read_event);
+    }
+    return err;
+}
+
+// Автонастройка на текущих размерах: локальный размер наивного ядра
+// (все разбиения допустимых групп на lx x ly) и TILE/WPT плиточного
+// (каждый вариант - своя сборка). Лучшие варианты пишутся в кэш
+int tune_matmul(cl_context context, cl_device_id device, cl_command_queue queue,
+                const char* source, size_t length, float* A, float* B,
+                int n, int m, int k, const char* cache_path) {
     cl_int err;
+    size_t size_C = (size_t)n * k * sizeof(float);
+    cl_mem bufferA = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                    (size_t)n * m * sizeof(float), A, &err);
+    cl_mem bufferB = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                    (size_t)m * k * sizeof(float), B, &err);
+    cl_mem bufferC = clCreateBuffer(context, CL_MEM_WRITE_ONLY, size_C, NULL, &err);
+    if (!bufferA || !bufferB || !bufferC) {
+        fprintf(stderr, "Ошибка создания буферов\n");
+        return 1;
+    }
+
+    size_t item_sizes[3] = {1, 1, 1};
+    cl_ulong local_mem = 0;
+    clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_ITEM_SIZES, sizeof(item_sizes), item_sizes, NULL);
+    clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(local_mem), &local_mem, NULL);
+
+    char key[AUTOTUNE_MAX_LINE];
+    char value[64];
+    printf("=== Автонастройка (A[%d x %d] * B[%d x %d]) ===\n", n, m, m, k);
+
+    // Наивное ядро: размер группы и его разбиение по измерениям
+    cl_program program = autotune_build(context, device, source, length, NULL);
+    cl_kernel kernel = program ? clCreateKernel(program, "matrix_multiply", &err) : NULL;
+    if (kernel) {
+        set_matmul_args(kernel, bufferA, bufferB, bufferC, n, m, k);
+        size_t groups[AUTOTUNE_MAX_GROUPS];
+        int group_count = autotune_group_sizes(device, kernel, groups, AUTOTUNE_MAX_GROUPS);
+        double best = -1.0;
+        size_t best_local[2] = {0, 0};
+
+        printf("Наивное ядро:\n");
+        for (int g = 0; g < group_count; g++) {
+            double group_best = -1.0;
+            size_t group_local[2] = {0, 0};
+            for (size_t lx = 1; lx <= groups[g]; lx *= 2) {
+                size_t local_size[2] = {lx, groups[g] / lx};
+                if (local_size[0] > item_sizes[0] || local_size[1] > item_sizes[1]) {
+                    continue;
+                }
+                size_t global_size[2] = {
+                    (n + local_size[0] - 1) / local_size[0] * local_size[0],
+                    (k + local_size[1] - 1) / local_size[1] * local_size[1]
+                };
+                double seconds = autotune_time_kernel(queue, kernel, 2, global_size, local_size,
+                                                      TUNE_REPS);
+                if (seconds > 0 && (group_best < 0 || seconds < group_best)) {
+                    group_best = seconds;
+                    group_local[0] = local_size[0];
+                    group_local[1] = local_size[1];
+                }
+            }
+            if (group_best < 0) {
+                continue;
+            }
+            printf("  группа %4zu: лучшее %zu x %zu - %.6f сек (%.2f GFLOP/s)\n", groups[g],
+                   group_local[0], group_local[1], group_best,
+                   gemm_gflops(n, m, k, group_best));
+            if (best < 0 || group_best < best) {
+                best = group_best;
+                best_local[0] = group_local[0];
+                best_local[1] = group_local[1];
+            }
+        }
+        if (best > 0) {
+            autotune_key(device, "matrix_multiply", key, sizeof(key));
+            snprintf(value, sizeof(value), "%zu %zu", best_local[0], best_local[1]);
+            autotune_cache_store(cache_path, key, value);
+            printf("  Выбрано: %zu x %zu\n\n", best_local[0], best_local[1]);
+        }
+        clReleaseKernel(kernel);
+    }
+    if (program) {
+        clReleaseProgram(program);
+    }
+
+    // Плиточное ядро: TILE и WPT задаются при сборке, группа - TILE x TILE/WPT
+    static const int tiles[] = {8, 16, 32};
+    static const int wpts[] = {1, 2, 4, 8};
+    double best = -1.0;
+    int best_tile = 0;
+    int best_wpt = 0;
+
+    printf("Плиточное ядро:\n");
+    for (size_t t = 0; t < sizeof(tiles) / sizeof(tiles[0]); t++) {
+        for (size_t w = 0; w < sizeof(wpts) / sizeof(wpts[0]); w++) {
+            int tile = tiles[t];
+            int wpt = wpts[w];
+            size_t local_size[2] = {tile, tile / wpt};
+            if (wpt > tile || local_size[0] > item_sizes[0] || local_size[1] > item_sizes[1]
+                || 2 * (cl_ulong)tile * tile * sizeof(float) > local_mem) {
+                continue;
+            }
+
+            char options[64];
+            snprintf(options, sizeof(options), "-DTILE=%d -DWPT=%d", tile, wpt);
+            program = autotune_build(context, device, source, length, options);
+            kernel = program ? clCreateKernel(program, "matrix_multiply_tiled", &err) : NULL;
+            if (kernel && autotune_max_group(device, kernel) >= local_size[0] * local_size[1]) {
+                set_matmul_args(kernel, bufferA, bufferB, bufferC, n, m, k);
+                size_t global_size[2] = {
+                    (size_t)(k + tile - 1) / tile * tile,
+                    (size_t)(n + tile - 1) / tile * (tile / wpt)
+                };
+                double seconds = autotune_time_kernel(queue, kernel, 2, global_size, local_size,
+                                                      TUNE_REPS);
+                if (seconds > 0) {
+                    printf("  TILE %2d, WPT %d (группа %2zu x %2zu): %.6f сек (%.2f GFLOP/s)\n",
+                           tile, wpt, local_size[0], local_size[1], seconds,
+                           gemm_gflops(n, m, k, seconds));
+                    if (best < 0 || seconds < best) {
+                        best = seconds;
+                        best_tile = tile;
+                        best_wpt = wpt;
+                    }
+                }
+            }
+            if (kernel) {
+                clReleaseKernel(kernel);
+            }
+            if (program) {
+                clReleaseProgram(program);
+            }
+        }
+    }
+    if (best > 0) {
+        autotune_key(device, "matrix_multiply_tiled", key, sizeof(key));
+        snprintf(value, sizeof(value), "%d %d", best_tile, best_wpt);
+        autotune_cache_store(cache_path, key, value);
+        printf("  Выбрано: TILE %d, WPT %d\n", best_tile, best_wpt);
+    }
+    printf("Кэш автонастройки: %s\n\n", cache_path);
+
+    clReleaseMemObject(bufferA);
+    clReleaseMemObject(bufferB);
+    clReleaseMemObject(bufferC);
+    return 0;
+}
+
+// Пакет задач (--batch J): J независимых умножений A[n x m] * B[m x k].
+// Первые задачи (не больше BATCH_ISOLATED_JOBS) выполняются по-старому -
+// каждая со своей средой: контекст, очередь, чтение ядра, программа с
+// теми же параметрами options (из кэша программ), буферы. Затем все J
+// задач идут пакетом в общей среде rt: ядро уже собрано, буферы берутся
+// из пула. Возвращает 0 или 1 при ошибке
+int batch_matmul(cl_runtime* rt, const char* options, int n, int m, int k, int job_count) {
+    size_t size_A = (size_t)n * m;
+    size_t size_B = (size_t)m * k;
+    size_t size_C = (size_t)n * k;
+    size_t per_job = size_A + size_B + 2 * size_C;
+    float* data = (float*)malloc(per_job * job_count * sizeof(float));
+    clrt_job* jobs = (clrt_job*)malloc(job_count * sizeof(clrt_job));
+    if (!data || !jobs) {
+        fprintf(stderr, "Ошибка выделения памяти\n");
+        free(data);
+        free(jobs);
+        return 1;
+    }
+    printf("\n=== Пакет задач ===\n");
+    printf("Задач: %d, каждая A[%d x %d] * B[%d x %d] (%.2f MB на все)\n\n", job_count,
+           n, m, m, k, per_job * job_count * sizeof(float) / (1024.0 * 1024.0));
+
+    // Данные задачи: A, B, C (OpenCL) и эталон CPU подряд
+    srand(7);
+    for (int j = 0; j < job_count; j++) {
+        float* A = data + per_job * j;
+        float* B = A + size_A;
+        for (size_t i = 0; i < size_A + size_B; i++) {
+            A[i] = (float)(rand() % 100) / 10.0f;
+        }
+        jobs[j].type = CLRT_MATMUL;
+        jobs[j].a = A;
+        jobs[j].b = B;
+        jobs[j].c = B + size_B;
+        jobs[j].n = n;
+        jobs[j].m = m;
+        jobs[j].k = k;
+        matrix_multiply_cpu(A, B, B + size_B + size_C, n, m, k);
+    }
+
+    // Каждая задача со своей средой на том же устройстве
+    clrt_device_spec same_device;
+    clrt_default_device(&same_device);
+    same_device.index = rt->device_index;
+    int isolated = job_count < BATCH_ISOLATED_JOBS ? job_count : BATCH_ISOLATED_JOBS;
+    cl_int err = CL_SUCCESS;
+    double isolated_start = get_time();
+    for (int j = 0; j < isolated && err == CL_SUCCESS; j++) {
+        cl_runtime own;
+        size_t length;
+        int from_cache = 0;
+        err = CL_INVALID_VALUE;
+        char* source = clrt_read_source("matrix_mul_kernel.cl", &length);
+        if (source && clrt_init(&own, &same_device, rt->cache_dir) == 0) {
+            cl_program program = clrt_build(&own, source, length, options, &from_cache);
+            if (program && clrt_kernel_create(&own, program, "matrix_multiply")) {
+                err = clrt_run_batch(&own, &jobs[j], 1);
+            }
+            clrt_release(&own);
+        }
+        free(source);
+    }
+    double isolated_time = (get_time() - isolated_start) / isolated;
+
+    // Все задачи пакетом в общей среде
+    double batch_time = 0.0;
+    if (err == CL_SUCCESS) {
+        double batch_start = get_time();
+        err = clrt_run_batch(rt, jobs, job_count);
+        batch_time = get_time() - batch_start;
+    }
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "Ошибка пакета задач: %d\n", err);
+        free(data);
+        free(jobs);
+        return 1;
+    }
+
+    // Проверка с той же относительной погрешностью, что verify_results
+    int errors = 0;
+    for (int j = 0; j < job_count; j++) {
+        const float* C = jobs[j].c;
+        const float* C_cpu = C + size_C;
+        for (size_t i = 0; i < size_C; i++) {
+            float scale = fabsf(C_cpu[i]) > 1.0f ? fabsf(C_cpu[i]) : 1.0f;
+            errors += fabsf(C[i] - C_cpu[i]) > 1e-4f * scale;
+        }
+    }
+    printf("Отдельно (своя среда, первые %d): %.6f сек на задачу\n", isolated, isolated_time);
+    printf("Пакетом (общая среда):           %.6f сек на задачу, всего %.6f сек"
+           " (%.2f GFLOP/s)\n", batch_time / job_count, batch_time,
+           gemm_gflops(n, m, k, batch_time / job_count));
+    printf("Ускорение на задачу: %.2fx\n", isolated_time / (batch_time / job_count));
+    printf("Пул буферов: %d созданий, %d повторных выдач\n", rt->allocations, rt->reuses);
+    printf("Результат: %s (%d ошибок)\n", errors == 0 ? "PASSED" : "FAILED", errors);
+    free(data);
+    free(jobs);
+    return errors != 0;
+}
+
+// Исполнитель разбиения строк C: устройство OpenCL со своей средой или
+// потоки OpenMP хоста (rt == NULL, блочный GEMM)
+typedef struct {
+    cl_runtime* rt;
+    cl_kernel kernel;
+    int tiled;              // Плиточное ядро, иначе наивное
+    cl_mem a, b, c;         // Буферы на все n строк, B записан заранее
+    double latency;         // Постоянная часть времени (запуск, передачи), сек
+    double row_time;        // Время на строку C сверх latency, сек
+    int first_row, rows;    // Своя полоса строк C
+    double seconds;         // Время полосы (устройство - по событиям)
+} multi_worker;
+
+// Постановка полосы строк исполнителя OpenCL в его очередь без ожидания:
+// запись строк A, ядро на rows строк, чтение строк C. События записи и
+// чтения возвращаются для времени полосы
+cl_int multi_enqueue(multi_worker* w, const float* A, float* C, int m, int k, int tile,
+                     int wpt, cl_event* write_event, cl_event* read_event) {
+    cl_command_queue queue = w->rt->queue;
+    cl_int err = clEnqueueWriteBuffer(queue, w->a, CL_FALSE, 0,
+                                      (size_t)w->rows * m * sizeof(float),
+                                      A + (size_t)w->first_row * m, 0, NULL, write_event);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    set_matmul_args(w->kernel, w->a, w->b, w->c, w->rows, m, k);
+    if (w->tiled) {
+        size_t local_size[2] = {tile, tile / wpt};
+        size_t global_size[2] = {
+            (size_t)(k + tile - 1) / tile * tile,
+            (size_t)(w->rows + tile - 1) / tile * (tile / wpt)
+        };
+        err = clEnqueueNDRangeKernel(queue, w->kernel, 2, NULL, global_size, local_size,
+                                     0, NULL, NULL);
+    } else {
+        size_t global_size[2] = {w->rows, k};
+        err = clEnqueueNDRangeKernel(queue, w->kernel, 2, NULL, global_size, NULL,
+                                     0, NULL, NULL);
+    }
+    if (err == CL_SUCCESS) {
+        err = clEnqueueReadBuffer(queue, w->c, CL_FALSE, 0, (size_t)w->rows * k * sizeof(float),
+                                  C + (size_t)w->first_row * k, 0, NULL, read_event);
+    }
+    clFlush(queue);
+    return err;
+}
+
+// Одновременный запуск всех исполнителей на своих полосах: сначала
+// полосы устройств ставятся в очереди, затем хост считает свою, затем
+// ожидание очередей. Время полосы устройства - от начала записи A до
+// конца чтения C по его часам. Возвращает общее время или -1 при ошибке
+double multi_run(multi_worker* workers, int count, const float* A, const float* B, float* C,
+                 int m, int k, int tile, int wpt) {
+    cl_event write_events[MULTI_MAX_WORKERS];
+    cl_event read_events[MULTI_MAX_WORKERS];
+    cl_int err = CL_SUCCESS;
+    double start = get_time();
+    for (int i = 0; i < count; i++) {
+        write_events[i] = read_events[i] = NULL;
+        workers[i].seconds = 0.0;
+        if (workers[i].rt && workers[i].rows > 0 && err == CL_SUCCESS) {
+            err = multi_enqueue(&workers[i], A, C, m, k, tile, wpt, &write_events[i],
+                                &read_events[i]);
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        if (!workers[i].rt && workers[i].rows > 0 && err == CL_SUCCESS) {
+            double host_start = get_time();
+            gemm_multiply(A + (size_t)workers[i].first_row * m, B,
+                          C + (size_t)workers[i].first_row * k, workers[i].rows, m, k);
+            workers[i].seconds = get_time() - host_start;
+        }
+    }
+    for (int i = 0; i < count; i++) {
+        if (workers[i].rt) {
+            clFinish(workers[i].rt->queue);
+        }
+    }
+    double total = get_time() - start;
+
+    for (int i = 0; i < count; i++) {
+        if (write_events[i] && read_events[i]) {
+            cl_ulong begin = 0, end = 0;
+            clGetEventProfilingInfo(write_events[i], CL_PROFILING_COMMAND_START,
+                                    sizeof(begin), &begin, NULL);
+            clGetEventProfilingInfo(read_events[i], CL_PROFILING_COMMAND_END,
+                                    sizeof(end), &end, NULL);
+            workers[i].seconds = end > begin ? (end - begin) * 1e-9 : 0.0;
+        }
+        if (write_events[i]) clReleaseEvent(write_events[i]);
+        if (read_events[i]) clReleaseEvent(read_events[i]);
+    }
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "Ошибка запуска на устройствах: %d\n", err);
+        return -1.0;
+    }
+    return total;
+}
+
+// Время исполнителя i одного на rows первых строках (после прогрева);
+// -1 при ошибке
+double multi_time_alone(multi_worker* workers, int count, int i, int rows, const float* A,
+                        const float* B, float* C, int m, int k) {
+    for (int j = 0; j < count; j++) {
+        workers[j].first_row = 0;
+        workers[j].rows = j == i ? rows : 0;
+    }
+    double seconds = multi_run(workers, count, A, B, C, m, k, TILE_SIZE, TILE_WPT);
+    if (seconds >= 0) {
+        seconds = multi_run(workers, count, A, B, C, m, k, TILE_SIZE, TILE_WPT);
+    }
+    return seconds;
+}
+
+// Полосы по модели latency + rows * row_time: общий срок T, при котором
+// все участники заканчивают одновременно, - из n = sum (T - latency) /
+// row_time. Исполнитель, у которого одна задержка не меньше T, выбывает,
+// и T пересчитывается. Если по модели один исполнитель (single) не
+// медленнее разбиения, все строки получает он. Возвращает прогноз срока
+double multi_plan(multi_worker* workers, int count, int n, int single) {
+    int active[MULTI_MAX_WORKERS];
+    for (int i = 0; i < count; i++) {
+        active[i] = 1;
+    }
+    double makespan = 0.0;
+    for (;;) {
+        double inverse = 0.0, weighted = 0.0;
+        int slowest = -1;
+        for (int i = 0; i < count; i++) {
+            if (active[i]) {
+                inverse += 1.0 / workers[i].row_time;
+                weighted += workers[i].latency / workers[i].row_time;
+                if (slowest < 0 || workers[i].latency > workers[slowest].latency) {
+                    slowest = i;
+                }
+            }
+        }
+        makespan = (n + weighted) / inverse;
+        if (workers[slowest].latency < makespan) {
+            break;
+        }
+        active[slowest] = 0;
+    }
+
+    double single_time = workers[single].latency + n * workers[single].row_time;
+    if (single_time <= makespan) {
+        for (int i = 0; i < count; i++) {
+            active[i] = i == single;
+        }
+        makespan = single_time;
+    }
+
+    // Границы полос по накопленной доле строк активных исполнителей
+    double accumulated = 0.0;
+    int first = 0;
+    int last = 0;
+    for (int i = 0; i < count; i++) {
+        last = active[i] ? i : last;
+    }
+    for (int i = 0; i < count; i++) {
+        double share = active[i] ? (makespan - workers[i].latency) / workers[i].row_time : 0.0;
+        accumulated += share > 0 ? share : 0.0;
+        int end = i >= last ? n : (int)(accumulated + 0.5);
+        end = end < first ? first : end > n ? n : end;
+        workers[i].first_row = first;
+        workers[i].rows = end - first;
+        first = end;
+    }
+    return makespan;
+}
+
+// Разбиение строк C между всеми устройствами OpenCL всех платформ
+// (--multi-device) и, с --host-omp, потоками OpenMP хоста. Устройства CPU
+// с --sub-devices U делятся на подустройства по U вычислительных блоков,
+// так разбиение проверяется на одной машине без GPU. Каждый исполнитель
+// один считает полосы двух размеров (после прогрева), по ним - модель
+// latency + rows * row_time (multi_plan). Для сравнения все строки
+// считает исполнитель, самый быстрый на всех строках по модели.
+// Возвращает 0 или 1 при ошибке
+int multi_device_matmul(const float* A, const float* B, float* C, const float* C_cpu,
+                        int n, int m, int k, int sub_units, int host_omp,
+                        const char* cache_dir) {
+    cl_platform_id owners[CLRT_MAX_DEVICES];
+    cl_device_id roots[CLRT_MAX_DEVICES];
+    int root_count = clrt_enumerate_devices(owners, roots, CLRT_MAX_DEVICES);
+
+    // Исполнители OpenCL: устройства, CPU - по подустройствам, если делятся
+    cl_platform_id platforms[CLRT_MAX_DEVICES];
+    cl_device_id devices[CLRT_MAX_DEVICES];
+    int is_sub[CLRT_MAX_DEVICES];
+    int device_count = 0;
+    for (int d = 0; d < root_count && device_count < CLRT_MAX_DEVICES; d++) {
+        cl_device_type type = 0;
+        clGetDeviceInfo(roots[d], CL_DEVICE_TYPE, sizeof(type), &type, NULL);
+        int subs = 0;
+        if (sub_units > 0 && (type & CL_DEVICE_TYPE_CPU)) {
+            subs = clrt_sub_devices(roots[d], sub_units, devices + device_count,
+                                    CLRT_MAX_DEVICES - device_count);
+            if (subs == 0) {
+                printf("Устройство %d не делится по %d вычислительных блоков, берем целиком\n",
+                       d, sub_units);
+            }
+        }
+        if (subs == 0) {
+            devices[device_count] = roots[d];
+            subs = 1;
+        }
+        for (int s = 0; s < subs; s++) {
+            platforms[device_count + s] = owners[d];
+            is_sub[device_count + s] = subs > 1 || devices[device_count] != roots[d];
+        }
+        device_count += subs;
+    }
+
+    size_t length;
+    char* source = clrt_read_source("matrix_mul_kernel.cl", &length);
+    cl_runtime* runtimes = (cl_runtime*)calloc(device_count > 0 ? device_count : 1,
+                                               sizeof(cl_runtime));
+    if (!source || !runtimes) {
+        free(source);
+        free(runtimes);
+        return 1;
+    }
+
+    printf("\n=== Разбиение строк C по устройствам ===\n");
+    char build_options[64];
+    snprintf(build_options, sizeof(build_options), "-DTILE=%d -DWPT=%d", TILE_SIZE, TILE_WPT);
+    multi_worker workers[MULTI_MAX_WORKERS];
+    int count = 0;
+    int failed = 0;
+    for (int d = 0; d < device_count; d++) {
+        multi_worker* w = &workers[count];
+        memset(w, 0, sizeof(*w));
+        cl_runtime* rt = &runtimes[d];
+        int from_cache = 0;
+        cl_int err = CL_INVALID_VALUE;
+        cl_program program = NULL;
+        if (clrt_init_device(rt, platforms[d], devices[d], cache_dir) == 0) {
+            program = clrt_build(rt, source, length, build_options, &from_cache);
+        }
+        if (program) {
+            // Плиточное ядро, если устройство принимает его рабочую группу
+            w->kernel = clrt_kernel_create(rt, program, "matrix_multiply_tiled");
+            size_t max_group = 0;
+            if (w->kernel) {
+                clGetKernelWorkGroupInfo(w->kernel, rt->device, CL_KERNEL_WORK_GROUP_SIZE,
+                                         sizeof(max_group), &max_group, NULL);
+            }
+            w->tiled = max_group >= (size_t)TILE_SIZE * (TILE_SIZE / TILE_WPT);
+            if (!w->tiled) {
+                w->kernel = clrt_kernel_create(rt, program, "matrix_multiply");
+            }
+            if (w->kernel) {
+                w->a = clrt_buffer_acquire(rt, CL_MEM_READ_ONLY,
+                                           (size_t)n * m * sizeof(float), &err);
+            }
+            if (err == CL_SUCCESS) {
+                w->b = clrt_buffer_acquire(rt, CL_MEM_READ_ONLY,
+                                           (size_t)m * k * sizeof(float), &err);
+            }
+            if (err == CL_SUCCESS) {
+                w->c = clrt_buffer_acquire(rt, CL_MEM_WRITE_ONLY,
+                                           (size_t)n * k * sizeof(float), &err);
+            }
+            if (err == CL_SUCCESS) {
+                err = clEnqueueWriteBuffer(rt->queue, w->b, CL_TRUE, 0,
+                                           (size_t)m * k * sizeof(float), B, 0, NULL, NULL);
+            }
+        }
+        if (err != CL_SUCCESS) {
+            printf("  Устройство %s пропущено (ошибка %d)\n",
+                   rt->device_name[0] ? rt->device_name : "?", err);
+            continue;
+        }
+        w->rt = rt;
+        printf("  %d: %s%s (%s ядро)\n", count, rt->device_name,
+               is_sub[d] ? " [подустройство]" : "", w->tiled ? "плиточное" : "наивное");
+        count++;
+    }
+    if (host_omp) {
+        memset(&workers[count], 0, sizeof(workers[count]));
+        int host_threads = 1;
+#ifdef _OPENMP
+        host_threads = omp_get_max_threads();
+#endif
+        printf("  %d: хост, блочный GEMM (потоков OpenMP: %d)\n", count, host_threads);
+        count++;
+    }
+    if (count == 0) {
+        fprintf(stderr, "Ошибка: нет исполнителей для разбиения\n");
+        failed = 1;
+    }
+
+    // Калибровка: каждый исполнитель один на полосах двух размеров;
+    // разность времен дает время строки, остаток - задержку
+    int large_rows = n < MULTI_CALIBRATION_ROWS ? n : MULTI_CALIBRATION_ROWS;
+    int small_rows = large_rows / 4;
+    int fastest = 0;
+    if (!failed) {
+        printf("\nКалибровка (%d и %d строк C на исполнителя):\n", small_rows, large_rows);
+    }
+    for (int i = 0; i < count && !failed; i++) {
+        double large = multi_time_alone(workers, count, i, large_rows, A, B, C, m, k);
+        double small = small_rows > 0 && large >= 0
+                     ? multi_time_alone(workers, count, i, small_rows, A, B, C, m, k) : 0.0;
+        if (large < 0 || small < 0) {
+            failed = 1;
+            break;
+        }
+        multi_worker* w = &workers[i];
+        w->row_time = small_rows > 0 ? (large - small) / (large_rows - small_rows) : 0.0;
+        w->latency = small - small_rows * w->row_time;
+        if (w->row_time <= 0.0 || w->latency < 0.0) {
+            // Шум измерения: без задержки, по большой полосе
+            w->row_time = large / large_rows;
+            w->latency = 0.0;
+        }
+        if (w->row_time < 1e-12) {
+            w->row_time = 1e-12;
+        }
+        if (w->latency + n * w->row_time
+            < workers[fastest].latency + n * workers[fastest].row_time) {
+            fastest = i;
+        }
+        printf("  %d: задержка %.6f сек, %.6f сек на строку (%.2f GFLOP/s без задержки)\n", i,
+               w->latency, w->row_time, gemm_gflops(1, m, k, w->row_time));
+    }
+
+    // Все строки на самом быстром исполнителе
+    double single_time = -1.0;
+    int single_errors = 0;
+    if (!failed) {
+        for (int j = 0; j < count; j++) {
+            workers[j].first_row = 0;
+            workers[j].rows = j == fastest ? n : 0;
+        }
+        memset(C, 0, (size_t)n * k * sizeof(float));
+        single_time = multi_run(workers, count, A, B, C, m, k, TILE_SIZE, TILE_WPT);
+        failed = single_time < 0;
+        if (!failed) {
+            printf("\nОдин исполнитель (%d): %.6f сек (%.2f GFLOP/s)\n", fastest, single_time,
+                   gemm_gflops(n, m, k, single_time));
+            single_errors = verify_results(C, C_cpu, n, k, "один");
+        }
+    }
+
+    // Полосы по модели задержки и времени строки
+    if (!failed) {
+        double predicted = multi_plan(workers, count, n, fastest);
+        int participants = 0;
+        for (int i = 0; i < count; i++) {
+            participants += workers[i].rows > 0;
+        }
+        printf("\nПрогноз: разбиение %.6f сек, один исполнитель (%d) %.6f сек\n", predicted,
+               fastest, workers[fastest].latency + n * workers[fastest].row_time);
+        if (participants == 1 && workers[fastest].rows == n) {
+            printf("Разбиение не быстрее одного исполнителя - все строки на %d\n", fastest);
+        }
+        memset(C, 0, (size_t)n * k * sizeof(float));
+        double split_time = multi_run(workers, count, A, B, C, m, k, TILE_SIZE, TILE_WPT);
+        failed = split_time < 0;
+        if (!failed) {
+            printf("\nРазбиение (%d исполнителей): %.6f сек (%.2f GFLOP/s)\n", participants,
+                   split_time, gemm_gflops(n, m, k, split_time));
+            for (int i = 0; i < count; i++) {
+                if (workers[i].rows == 0) {
+                    printf("  %d: без строк\n", i);
+                    continue;
+                }
+                printf("  %d: строки %5d..%-5d (%5.1f%%), %.6f сек\n", i, workers[i].first_row,
+                       workers[i].first_row + workers[i].rows - 1,
+                       100.0 * workers[i].rows / n, workers[i].seconds);
+            }
+            printf("Ускорение относительно одного исполнителя: %.2fx\n",
+                   single_time / split_time);
+            int errors = verify_results(C, C_cpu, n, k, "разбиение");
+            printf("Результат: %s (%d ошибок)\n",
+                   errors == 0 && single_errors == 0 ? "PASSED" : "FAILED",
+                   errors + single_errors);
+            failed = errors != 0 || single_errors != 0;
+        }
+    }
+
+    for (int d = 0; d < device_count; d++) {
+        clrt_release(&runtimes[d]);
+#ifdef CL_VERSION_1_2
+        if (is_sub[d]) {
+            clReleaseDevice(devices[d]);
+        }
+#endif
+    }
+    free(runtimes);
+    free(source);
+    return failed;
+}
+
+// Пакет малых умножений на устройстве одним запуском: offsets == NULL -
+// шаговый пакет (матрицы подряд), иначе смещения матриц в буферах по три
+// на произведение. Запись, ядро и чтение C; время ядра - по событию.
+// Возвращает CL_SUCCESS или код ошибки
+cl_int run_batched_kernel(cl_command_queue queue, cl_kernel kernel, cl_device_id device,
+                          cl_mem bufferA, cl_mem bufferB, cl_mem bufferC, cl_mem offsets,
+                          const float* A, const float* B, float* C, const int* host_offsets,
+                          int n, int m, int k, int count, double* kernel_time) {
+    size_t size_a = (size_t)count * n * m * sizeof(float);
+    size_t size_b = (size_t)count * m * k * sizeof(float);
+    size_t size_c = (size_t)count * n * k * sizeof(float);
+    cl_int err = clEnqueueWriteBuffer(queue, bufferA, CL_FALSE, 0, size_a, A, 0, NULL, NULL);
+    if (err == CL_SUCCESS) {
+        err = clEnqueueWriteBuffer(queue, bufferB, CL_FALSE, 0, size_b, B, 0, NULL, NULL);
+    }
+    if (err == CL_SUCCESS && offsets) {
+        err = clEnqueueWriteBuffer(queue, offsets, CL_FALSE, 0, (size_t)count * 3 * sizeof(int),
+                                   host_offsets, 0, NULL, NULL);
+    }
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    int stride_a = n * m, stride_b = m * k, stride_c = n * k;
+    clSetKernelArg(kernel, 0, sizeof(cl_mem), &bufferA);
+    clSetKernelArg(kernel, 1, sizeof(cl_mem), &bufferB);
+    clSetKernelArg(kernel, 2, sizeof(cl_mem), &bufferC);
+    int arg = 3;
+    if (offsets) {
+        clSetKernelArg(kernel, arg++, sizeof(cl_mem), &offsets);
+    }
+    clSetKernelArg(kernel, arg++, sizeof(int), &n);
+    clSetKernelArg(kernel, arg++, sizeof(int), &m);
+    clSetKernelArg(kernel, arg++, sizeof(int), &k);
+    clSetKernelArg(kernel, arg++, sizeof(int), &count);
+    if (!offsets) {
+        clSetKernelArg(kernel, arg++, sizeof(int), &stride_a);
+        clSetKernelArg(kernel, arg++, sizeof(int), &stride_b);
+        clSetKernelArg(kernel, arg++, sizeof(int), &stride_c);
+    }
+
+    // Группа BATCHED_GROUP, если ядро ее допускает, иначе - на выбор реализации
+    size_t max_group = 0;
+    clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(max_group),
+                             &max_group, NULL);
+    size_t local_size = BATCHED_GROUP;
+    size_t global_size = (size_t)count * n * k;
+    if (max_group >= local_size) {
+        global_size = (global_size + local_size - 1) / local_size * local_size;
+    }
+    cl_event kernel_event;
+    err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_size,
+                                 max_group >= local_size ? &local_size : NULL,
+                                 0, NULL, &kernel_event);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    err = clEnqueueReadBuffer(queue, bufferC, CL_TRUE, 0, size_c, C, 0, NULL, NULL);
+    cl_ulong start = 0, end = 0;
+    clGetEventProfilingInfo(kernel_event, CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL);
+    clGetEventProfilingInfo(kernel_event, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL);
+    *kernel_time = end > start ? (end - start) * 1e-9 : 0.0;
+    clReleaseEvent(kernel_event);
+    return err;
+}
+
+// Существующее ядро matrix_multiply по одному произведению: на каждое
+// свои буферы, запуск и блокирующее чтение C (матрицы пакета подряд).
+// Возвращает CL_SUCCESS или код ошибки
+cl_int loop_matmul_kernel(cl_runtime* rt, cl_kernel kernel, const float* A, const float* B,
+                          float* C, int n, int m, int k, int count) {
+    size_t size_a = (size_t)n * m;
+    size_t size_b = (size_t)m * k;
+    size_t size_c = (size_t)n * k;
+    cl_int err = CL_SUCCESS;
+    for (int i = 0; i < count && err == CL_SUCCESS; i++) {
+        cl_mem bufferA = clCreateBuffer(rt->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                        size_a * sizeof(float), (void*)(A + i * size_a), &err);
+        cl_mem bufferB = clCreateBuffer(rt->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+                                        size_b * sizeof(float), (void*)(B + i * size_b), &err);
+        cl_mem bufferC = clCreateBuffer(rt->context, CL_MEM_WRITE_ONLY, size_c * sizeof(float),
+                                        NULL, &err);
+        err = bufferA && bufferB && bufferC ? CL_SUCCESS : CL_MEM_OBJECT_ALLOCATION_FAILURE;
+        if (err == CL_SUCCESS) {
+            size_t global_size[2] = {n, k};
+            set_matmul_args(kernel, bufferA, bufferB, bufferC, n, m, k);
+            err = clEnqueueNDRangeKernel(rt->queue, kernel, 2, NULL, global_size, NULL,
+                                         0, NULL, NULL);
+        }
+        if (err == CL_SUCCESS) {
+            err = clEnqueueReadBuffer(rt->queue, bufferC, CL_TRUE, 0, size_c * sizeof(float),
+                                      C + i * size_c, 0, NULL, NULL);
+        }
+        if (bufferA) clReleaseMemObject(bufferA);
+        if (bufferB) clReleaseMemObject(bufferB);
+        if (bufferC) clReleaseMemObject(bufferC);
+    }
+    return err;
+}
+
+// Пакет малых умножений (--batched-gemm COUNT): COUNT независимых
+// произведений A_i[n x m] * B_i[m x k]. Сравниваются цикл по одному
+// произведению (наивное и блочный GEMM на CPU, существующее ядро
+// matrix_multiply на первых BATCHED_LOOP_JOBS) и пакетный API:
+// gemm_batched* на OpenMP и одно пакетное ядро на весь пакет.
+// С pointer_array пакет задается массивами указателей (на устройстве -
+// смещениями), произведения берут матрицы в перемешанном порядке.
+// Возвращает 0 или 1 при ошибке
+int batched_gemm_bench(cl_runtime* rt, cl_program program, int n, int m, int k, int count,
+                       int pointer_array) {
+    size_t size_a = (size_t)n * m;
+    size_t size_b = (size_t)m * k;
+    size_t size_c = (size_t)n * k;
+    size_t largest = size_a > size_b ? size_a : size_b;
+    largest = largest > size_c ? largest : size_c;
+    if (largest * count > INT_MAX) {
+        fprintf(stderr, "Пакет слишком велик для индексов ядра (%d произведений)\n", count);
+        return 1;
+    }
+    cl_kernel kernel = clrt_kernel_create(rt, program, "matrix_multiply");
+    cl_kernel batched = clrt_kernel_create(rt, program, pointer_array
+                                                        ? "matrix_multiply_batched_indexed"
+                                                        : "matrix_multiply_batched");
+    if (!kernel || !batched) {
+        return 1;
+    }
+
+    float* A = (float*)malloc(size_a * count * sizeof(float));
+    float* B = (float*)malloc(size_b * count * sizeof(float));
+    float* C = (float*)malloc(size_c * count * sizeof(float));
+    float* C_ref = (float*)malloc(size_c * count * sizeof(float));
+    const float** a_ptr = (const float**)malloc(count * sizeof(float*));
+    const float** b_ptr = (const float**)malloc(count * sizeof(float*));
+    float** c_ptr = (float**)malloc(count * sizeof(float*));
+    int* offsets = (int*)malloc((size_t)count * 3 * sizeof(int));
+    int* order = (int*)malloc(count * sizeof(int));
+    if (!A || !B || !C || !C_ref || !a_ptr || !b_ptr || !c_ptr || !offsets || !order) {
+        fprintf(stderr, "Ошибка выделения памяти\n");
+        free(A);
+        free(B);
+        free(C);
+        free(C_ref);
+        free(a_ptr);
+        free(b_ptr);
+        free(c_ptr);
+        free(offsets);
+        free(order);
+        return 1;
+    }
+
+    srand(11);
+    for (size_t i = 0; i < size_a * count; i++) {
+        A[i] = (float)(rand() % 100) / 10.0f;
+    }
+    for (size_t i = 0; i < size_b * count; i++) {
+        B[i] = (float)(rand() % 100) / 10.0f;
+    }
+    // Массив указателей: произведение i считает матрицы order[i] на их
+    // местах, так что C совпадает с эталоном при любом порядке
+    for (int i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    for (int i = count - 1; pointer_array && i > 0; i--) {
+        int j = rand() % (i + 1);
+        int t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    for (int i = 0; i < count; i++) {
+        a_ptr[i] = A + order[i] * size_a;
+        b_ptr[i] = B + order[i] * size_b;
+        c_ptr[i] = C + order[i] * size_c;
+        offsets[3 * i] = (int)(order[i] * size_a);
+        offsets[3 * i + 1] = (int)(order[i] * size_b);
+        offsets[3 * i + 2] = (int)(order[i] * size_c);
+    }
+
+    int cpu_threads = 1;
+#ifdef _OPENMP
+    cpu_threads = omp_get_max_threads();
+#endif
+    printf("\n=== Пакет малых умножений ===\n");
+    printf("Произведений: %d, каждое A[%d x %d] * B[%d x %d], пакет %s\n\n", count, n, m, m, k,
+           pointer_array ? "массивами указателей" : "шаговый");
+
+    // CPU: по одному произведению
+    double start = get_time();
+    for (int i = 0; i < count; i++) {
+        matrix_multiply_cpu(A + i * size_a, B + i * size_b, C_ref + i * size_c, n, m, k);
+    }
+    double naive_time = (get_time() - start) / count;
+    start = get_time();
+    for (int i = 0; i < count; i++) {
+        gemm_multiply(A + i * size_a, B + i * size_b, C + i * size_c, n, m, k);
+    }
+    double loop_gemm_time = (get_time() - start) / count;
+    int errors = verify_results(C, C_ref, count * n, k, "GEMM");
+
+    // CPU: пакет на OpenMP, первый запуск - прогрев
+    double cpu_batched_time = 0.0;
+    for (int rep = 0; rep < 2; rep++) {
+        memset(C, 0, size_c * count * sizeof(float));
+        start = get_time();
+        if (pointer_array) {
+            gemm_batched(a_ptr, b_ptr, c_ptr, n, m, k, count);
+        } else {
+            gemm_batched_strided(A, size_a, B, size_b, C, size_c, n, m, k, count);
+        }
+        cpu_batched_time = (get_time() - start) / count;
+    }
+    errors += verify_results(C, C_ref, count * n, k, "пакет CPU");
+
+    printf("CPU наивное по одному:      %9.3f мкс на произведение (%.2f GFLOP/s)\n",
+           naive_time * 1e6, gemm_gflops(n, m, k, naive_time));
+    printf("CPU блочный GEMM по одному: %9.3f мкс на произведение (%.2f GFLOP/s)\n",
+           loop_gemm_time * 1e6, gemm_gflops(n, m, k, loop_gemm_time));
+    printf("CPU пакет (потоков: %d):     %9.3f мкс на произведение (%.2f GFLOP/s)\n\n",
+           cpu_threads, cpu_batched_time * 1e6, gemm_gflops(n, m, k, cpu_batched_time));
+
+    // OpenCL: существующее ядро по одному на первых произведениях
+    int loop_jobs = count < BATCHED_LOOP_JOBS ? count : BATCHED_LOOP_JOBS;
+    memset(C, 0, size_c * count * sizeof(float));
+    start = get_time();
+    cl_int err = loop_matmul_kernel(rt, kernel, A, B, C, n, m, k, loop_jobs);
+    double cl_loop_time = (get_time() - start) / loop_jobs;
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "Ошибка запуска ядра по одному: %d\n", err);
+    } else {
+        errors += verify_results(C, C_ref, loop_jobs * n, k, "ядро по одному");
+    }
+
+    // OpenCL: весь пакет одним запуском, первый запуск - прогрев
+    cl_mem bufferA = NULL, bufferB = NULL, bufferC = NULL, bufferOffsets = NULL;
+    if (err == CL_SUCCESS) {
+        bufferA = clrt_buffer_acquire(rt, CL_MEM_READ_ONLY, size_a * count * sizeof(float), &err);
+    }
+    if (err == CL_SUCCESS) {
+        bufferB = clrt_buffer_acquire(rt, CL_MEM_READ_ONLY, size_b * count * sizeof(float), &err);
+    }
+    if (err == CL_SUCCESS) {
+        bufferC = clrt_buffer_acquire(rt, CL_MEM_WRITE_ONLY, size_c * count * sizeof(float),
+                                      &err);
+    }
+    if (err == CL_SUCCESS && pointer_array) {
+        bufferOffsets = clrt_buffer_acquire(rt, CL_MEM_READ_ONLY,
+                                            (size_t)count * 3 * sizeof(int), &err);
+    }
+    double cl_batched_time = 0.0, cl_batched_kernel = 0.0;
+    for (int rep = 0; rep < 2 && err == CL_SUCCESS; rep++) {
+        memset(C, 0, size_c * count * sizeof(float));
+        start = get_time();
+        err = run_batched_kernel(rt->queue, batched, rt->device, bufferA, bufferB, bufferC,
+                                 bufferOffsets, A, B, C, offsets, n, m, k, count,
+                                 &cl_batched_kernel);
+        cl_batched_time = (get_time() - start) / count;
+        if (err != CL_SUCCESS) {
+            fprintf(stderr, "Ошибка пакетного ядра: %d\n", err);
+        }
+    }
+
+    if (err == CL_SUCCESS) {
+        errors += verify_results(C, C_ref, count * n, k, "пакетное ядро");
+        printf("OpenCL ядро по одному (первые %d): %9.3f мкс на произведение (%.2f GFLOP/s)\n",
+               loop_jobs, cl_loop_time * 1e6, gemm_gflops(n, m, k, cl_loop_time));
+        printf("OpenCL пакет (один запуск):       %9.3f мкс на произведение (%.2f GFLOP/s),"
+               " из них ядро %.3f мкс\n", cl_batched_time * 1e6,
+               gemm_gflops(n, m, k, cl_batched_time), cl_batched_kernel / count * 1e6);
+        printf("\nУскорение пакета на CPU относительно блочного GEMM по одному: %.2fx\n",
+               loop_gemm_time / cpu_batched_time);
+        printf("Ускорение пакета OpenCL относительно ядра по одному: %.2fx\n",
+               cl_loop_time / cl_batched_time);
+        printf("Результат: %s (%d ошибок)\n", errors == 0 ? "PASSED" : "FAILED", errors);
+    }
+
+    // Буферы пакета остаются в пуле среды до clrt_release
+    if (bufferA) clrt_buffer_recycle(rt, bufferA);
+    if (bufferB) clrt_buffer_recycle(rt, bufferB);
+    if (bufferC) clrt_buffer_recycle(rt, bufferC);
+    if (bufferOffsets) clrt_buffer_recycle(rt, bufferOffsets);
+    free(A);
+    free(B);
+    free(C);
+    free(C_ref);
+    free(a_ptr);
+    free(b_ptr);
+    free(c_ptr);
+    free(offsets);
+    free(order);
+    return err != CL_SUCCESS || errors != 0;
+}
+
+void print_usage(const char* program) {
+    printf("Использование: %s [--dims N,M,K] [--kernel naive|tiled|both] [--tune]"
+           " [--tune-cache FILE] [--kernel-cache DIR] [--no-kernel-cache] [--trace FILE]"
+           " [--batch J] [--device номер|gpu|cpu|имя] [--list-devices]\n", program);
+    printf("       %s --multi-device [--sub-devices U] [--host-omp] [--dims N,M,K]"
+           " [--kernel-cache DIR] [--no-kernel-cache]\n", program);
+    printf("       %s --batched-gemm COUNT [--pointer-array] [--dims N,M,K]"
+           " [--device номер|gpu|cpu|имя]\n", program);
+    printf("       %s --scaling strong|weak|both [--cpu blocked|naive] [--size N]"
+           " [--threads a,b,c] [--reps R] [--pin compact|spread|node:K|none]\n", program);
+}
+
+int main(int argc, char* argv[]) {
+    cl_int err;
+
+    // Режим масштабирования CPU версии (без OpenCL)
+    int scaling_modes = 0;                   // Бит 0 - сильное, бит 1 - слабое
+    int scaling_size = N;
+    int scaling_reps = 3;
+    int threads[SCALING_MAX_POINTS];
+    int thread_count = 0;
+    int blocked = 1;                         // Масштабирование блочного GEMM
+    scaling_pinning pin;
+    pin.placement = SCALING_PIN_COMPACT;
+    pin.node = 0;
+
+    // Размеры матриц: A[n x m] * B[m x k] = C[n x k]
+    int n = N, m = M, k = K;
+    int dims_ok = 1;
+    int dims_given = 0;
+    int kernel_mode = KERNEL_NAIVE | KERNEL_TILED;
+    int tune = 0;
+    const char* cache_path = AUTOTUNE_DEFAULT_CACHE;
+    const char* program_cache_dir = CLRT_DEFAULT_CACHE_DIR;
+    const char* trace_path = NULL;
+    int batch = 0;
+    int device_ok = 1;
+    int multi_device = 0;
+    int sub_units = 0;                       // Деление CPU на подустройства
+    int host_omp = 0;                        // Хост - еще один исполнитель
+    int batched = 0;                         // Произведений в пакете малых матриц
+    int pointer_array = 0;                   // Пакет массивами указателей
+    clrt_device_spec device_spec;
+    clrt_default_device(&device_spec);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--scaling") == 0 && i + 1 < argc) {
+            i++;
+            scaling_modes = strcmp(argv[i], "strong") == 0 ? 1
+                          : strcmp(argv[i], "weak") == 0 ? 2
+                          : strcmp(argv[i], "both") == 0 ? 3 : -1;
+        } else if (strcmp(argv[i], "--dims") == 0 && i + 1 < argc) {
+            dims_ok = sscanf(argv[++i], "%d,%d,%d", &n, &m, &k) == 3 && n > 0 && m > 0 && k > 0;
+            dims_given = 1;
+        } else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            i++;
+            kernel_mode = strcmp(argv[i], "naive") == 0 ? KERNEL_NAIVE
+                        : strcmp(argv[i], "tiled") == 0 ? KERNEL_TILED
+                        : strcmp(argv[i], "both") == 0 ? KERNEL_NAIVE | KERNEL_TILED : 0;
+        } else if (strcmp(argv[i], "--tune") == 0) {
+            tune = 1;
+        } else if (strcmp(argv[i], "--tune-cache") == 0 && i + 1 < argc) {
+            cache_path = argv[++i];
+        } else if (strcmp(argv[i], "--kernel-cache") == 0 && i + 1 < argc) {
+            program_cache_dir = argv[++i];
+        } else if (strcmp(argv[i], "--no-kernel-cache") == 0) {
+            program_cache_dir = NULL;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+            device_ok = clrt_parse_device(argv[++i], &device_spec) == 0;
+        } else if (strcmp(argv[i], "--multi-device") == 0) {
+            multi_device = 1;
+        } else if (strcmp(argv[i], "--sub-devices") == 0 && i + 1 < argc) {
+            sub_units = atoi(argv[++i]);
+            sub_units = sub_units > 0 ? sub_units : -1;
+        } else if (strcmp(argv[i], "--host-omp") == 0) {
+            host_omp = 1;
+        } else if (strcmp(argv[i], "--batched-gemm") == 0 && i + 1 < argc) {
+            batched = atoi(argv[++i]);
+            batched = batched > 0 ? batched : -1;
+        } else if (strcmp(argv[i], "--pointer-array") == 0) {
+            pointer_array = 1;
+        } else if (strcmp(argv[i], "--list-devices") == 0) {
+            return clrt_list_devices() > 0 ? 0 : 1;
+        } else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+            i++;
+            blocked = strcmp(argv[i], "blocked") == 0 ? 1
+                    : strcmp(argv[i], "naive") == 0 ? 0 : -1;
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            scaling_size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            thread_count = scaling_parse_cpulist(argv[++i], threads, SCALING_MAX_POINTS);
+        } else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            scaling_reps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--pin") == 0 && i + 1 < argc
+                   && scaling_parse_placement(argv[i + 1], &pin) == 0) {
+            i++;
+        } else {
+            scaling_modes = -1;
+        }
+        if (scaling_modes < 0 || scaling_size < 1 || scaling_reps < 1
+            || scaling_reps > SCALING_MAX_POINTS || !dims_ok || blocked < 0
+            || kernel_mode == 0 || batch < 0 || !device_ok || sub_units < 0 || batched < 0
+            || (batch > 0) + (batched > 0) + multi_device > 1) {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (scaling_modes > 0) {
+        if (thread_count == 0) {
+            thread_count = scaling_default_threads(threads, SCALING_MAX_POINTS);
+        }
+        for (int t = 0; t < thread_count; t++) {
+            if (threads[t] < 1) {
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+        return run_scaling(scaling_modes, scaling_size, threads, thread_count,
+                           scaling_reps, &pin, blocked);
+    }
+
+    // Пакет малых матриц без --dims - BATCHED_DEFAULT_DIM со всех сторон
+    if (batched > 0 && !dims_given) {
+        n = m = k = BATCHED_DEFAULT_DIM;
+    }
 
     printf("=== OpenCL Matrix Multiplication ===\n");
     printf("Размеры матриц: A[%d x %d] * B[%d x %d] = C[%d x %d]\n\n",
-           N, M, M, K, N, K);
+           n, m, m, k, n, k);
 
     // Выделение памяти для матриц
-    size_t size_A = N * M * sizeof(float);
-    size_t size_B = M * K * sizeof(float);
-    size_t size_C = N * K * sizeof(float);
+    size_t size_A = (size_t)n * m * sizeof(float);
+    size_t size_B = (size_t)m * k * sizeof(float);
+    size_t size_C = (size_t)n * k * sizeof(float);
 
     float* A = (float*)malloc(size_A);
     float* B = (float*)malloc(size_B);
     float* C_gpu = (float*)malloc(size_C);
     float* C_cpu = (float*)malloc(size_C);
+    float* C_blocked = (float*)malloc(size_C);
 
-    if (!A || !B || !C_gpu || !C_cpu) {
+    if (!A || !B || !C_gpu || !C_cpu || !C_blocked) {
         fprintf(stderr, "Ошибка выделения памяти\n");
         return 1;
     }
 
     // Инициализация матриц случайными значениями
     srand(42);
-    for (int i = 0; i < N * M; i++) {
+    for (size_t i = 0; i < (size_t)n * m; i++) {
         A[i] = (float)(rand() % 100) / 10.0f;
     }
-    for (int i = 0; i < M * K; i++) {
+    for (size_t i = 0; i < (size_t)m * k; i++) {
         B[i] = (float)(rand() % 100) / 10.0f;
     }
 
@@ -127,212 +1355,345 @@ int main() {
 
     printf("Выполнение на CPU...\n");
     double cpu_start = get_time();
-    matrix_multiply_cpu(A, B, C_cpu, N, M, K);
+    matrix_multiply_cpu(A, B, C_cpu, n, m, k);
     double cpu_time = get_time() - cpu_start;
-    printf("CPU время: %.6f сек\n\n", cpu_time);
+    printf("CPU время: %.6f сек (%.2f GFLOP/s)\n\n", cpu_time, gemm_gflops(n, m, k, cpu_time));
 
     // ========================================
-    // OpenCL: Инициализация
+    // CPU: Блочный GEMM (упаковка, кэш-блоки, SIMD, OpenMP)
     // ========================================
 
-    cl_platform_id platform;
-    err = clGetPlatformIDs(1, &platform, NULL);
-    if (err != CL_SUCCESS) {
-        fprintf(stderr, "Ошибка получения платформы: %d\n", err);
-        return 1;
-    }
-
-    char platform_name[256];
-    clGetPlatformInfo(platform, CL_PLATFORM_NAME, sizeof(platform_name), platform_name, NULL);
-    printf("Платформа: %s\n", platform_name);
+    int cpu_threads = 1;
+#ifdef _OPENMP
+    cpu_threads = omp_get_max_threads();
+#endif
+    printf("Выполнение блочного GEMM на CPU (микроядро %s, потоков: %d)...\n",
+           gemm_kernel_name(), cpu_threads);
+    gemm_multiply(A, B, C_blocked, n, m, k);  // Прогрев: страницы C и буферы упаковки
+    double blocked_start = get_time();
+    gemm_multiply(A, B, C_blocked, n, m, k);
+    double blocked_time = get_time() - blocked_start;
+    printf("CPU время (блочный): %.6f сек (%.2f GFLOP/s)\n", blocked_time,
+           gemm_gflops(n, m, k, blocked_time));
+    printf("Ускорение относительно наивного: %.2fx\n", cpu_time / blocked_time);
+    int blocked_errors = verify_results(C_blocked, C_cpu, n, k, "GEMM");
+    printf("Блочный GEMM: %s (%d ошибок)\n\n", blocked_errors == 0 ? "PASSED" : "FAILED",
+           blocked_errors);
 
-    cl_device_id device;
-    err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &device, NULL);
-    if (err != CL_SUCCESS) {
-        printf("GPU не найден, используем CPU...\n");
-        err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &device, NULL);
-        if (err != CL_SUCCESS) {
-            fprintf(stderr, "Ошибка получения устройства: %d\n", err);
-            return 1;
-        }
+    // Разбиение строк C между всеми устройствами (и хостом)
+    if (multi_device) {
+        int failed = multi_device_matmul(A, B, C_gpu, C_cpu, n, m, k, sub_units, host_omp,
+                                         program_cache_dir);
+        free(A);
+        free(B);
+        free(C_gpu);
+        free(C_cpu);
+        free(C_blocked);
+        return failed;
     }
 
-    char device_name[256];
-    clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(device_name), device_name, NULL);
-    printf("Устройство: %s\n\n", device_name);
+    // ========================================
+    // OpenCL: Инициализация
+    // ========================================
 
-    // Создание контекста и очереди
-    cl_context context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
-    if (err != CL_SUCCESS) {
-        fprintf(stderr, "Ошибка создания контекста: %d\n", err);
-        return 1;
-    }
+    // Время запуска OpenCL: от платформы до готовых ядер (без автонастройки)
+    double startup_start = get_time();
 
-#ifdef CL_VERSION_2_0
-    cl_command_queue queue = clCreateCommandQueueWithProperties(context, device, 0, &err);
-#else
-    cl_command_queue queue = clCreateCommandQueue(context, device, 0, &err);
-#endif
-    if (err != CL_SUCCESS) {
-        fprintf(stderr, "Ошибка создания очереди: %d\n", err);
-        clReleaseContext(context);
+    // Платформа и устройство (--device или первый GPU), контекст и
+    // очередь с профилированием - в общей среде OpenCL
+    cl_runtime rt;
+    if (clrt_init(&rt, &device_spec, program_cache_dir) != 0) {
         return 1;
     }
+    cl_device_id device = rt.device;
+    cl_context context = rt.context;
+    cl_command_queue queue = rt.queue;
+    printf("Платформа: %s\n", rt.platform_name);
+    printf("Устройство: %s\n\n", rt.device_name);
 
     // ========================================
     // OpenCL: Загрузка и компиляция ядра
     // ========================================
 
     size_t kernel_length;
-    char* kernel_source = read_kernel_file("matrix_mul_kernel.cl", &kernel_length);
+    char* kernel_source = clrt_read_source("matrix_mul_kernel.cl", &kernel_length);
     if (!kernel_source) {
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
+        clrt_release(&rt);
         return 1;
     }
 
-    cl_program program = clCreateProgramWithSource(context, 1,
-                                                   (const char**)&kernel_source,
-                                                   &kernel_length, &err);
-    free(kernel_source);
+    double tune_time = 0.0;
+    if (tune) {
+        double tune_start = get_time();
+        tune_matmul(context, device, queue, kernel_source, kernel_length, A, B, n, m, k,
+                    cache_path);
+        tune_time = get_time() - tune_start;
+    }
 
-    if (err != CL_SUCCESS) {
-        fprintf(stderr, "Ошибка создания программы: %d\n", err);
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
-        return 1;
+    // Параметры из кэша автонастройки, если для устройства они есть
+    char key[AUTOTUNE_MAX_LINE];
+    char value[64];
+    size_t naive_local[2] = {16, 16};
+    int tile = TILE_SIZE;
+    int wpt = TILE_WPT;
+    autotune_key(device, "matrix_multiply", key, sizeof(key));
+    if (autotune_cache_load(cache_path, key, value, sizeof(value)) == 0) {
+        size_t lx, ly;
+        if (sscanf(value, "%zu %zu", &lx, &ly) == 2 && lx > 0 && ly > 0) {
+            naive_local[0] = lx;
+            naive_local[1] = ly;
+            printf("Наивное ядро: группа %zu x %zu из кэша автонастройки\n", lx, ly);
+        }
+    }
+    autotune_key(device, "matrix_multiply_tiled", key, sizeof(key));
+    if (autotune_cache_load(cache_path, key, value, sizeof(value)) == 0) {
+        int cached_tile, cached_wpt;
+        if (sscanf(value, "%d %d", &cached_tile, &cached_wpt) == 2 && cached_wpt > 0
+            && cached_tile >= cached_wpt && cached_tile % cached_wpt == 0) {
+            tile = cached_tile;
+            wpt = cached_wpt;
+            printf("Плиточное ядро: TILE %d, WPT %d из кэша автонастройки\n", tile, wpt);
+        }
     }
 
-    err = clBuildProgram(program, 1, &device, NULL, NULL, NULL);
-    if (err != CL_SUCCESS) {
-        fprintf(stderr, "Ошибка компиляции программы: %d\n", err);
-        size_t log_size;
-        clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
-        char* log = (char*)malloc(log_size);
-        clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, log_size, log, NULL);
-        fprintf(stderr, "Лог компиляции:\n%s\n", log);
-        free(log);
-        clReleaseProgram(program);
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
+    // Компиляция программы (или двоичный код из кэша программ)
+    char build_options[64];
+    snprintf(build_options, sizeof(build_options), "-DTILE=%d -DWPT=%d", tile, wpt);
+    int from_cache = 0;
+    double build_start = get_time();
+    cl_program program = clrt_build(&rt, kernel_source, kernel_length, build_options,
+                                    &from_cache);
+    double build_time = get_time() - build_start;
+    free(kernel_source);
+    if (!program) {
+        clrt_release(&rt);
         return 1;
     }
 
-    cl_kernel kernel = clCreateKernel(program, "matrix_multiply", &err);
-    if (err != CL_SUCCESS) {
-        fprintf(stderr, "Ошибка создания ядра: %d\n", err);
-        clReleaseProgram(program);
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
+    // Ядра освобождаются вместе со средой
+    cl_kernel kernel = clrt_kernel_create(&rt, program, "matrix_multiply");
+    cl_kernel tiled_kernel = kernel ? clrt_kernel_create(&rt, program, "matrix_multiply_tiled")
+                                    : NULL;
+    if (!tiled_kernel) {
+        clrt_release(&rt);
         return 1;
     }
 
-    printf("Ядро скомпилировано успешно\n");
+    double startup_time = get_time() - startup_start - tune_time;
+    const char* build_source = from_cache ? "двоичный код из кэша" : "из исходника";
+    printf("Ядра скомпилированы успешно (%s)\n", build_options);
+    printf("Запуск OpenCL: %.3f сек, из них сборка программы %.3f сек (%s)\n",
+           startup_time, build_time, build_source);
+
+    // Пакет задач: свои матрицы, буферы из пула среды
+    if (batch > 0) {
+        int failed = batch_matmul(&rt, build_options, n, m, k, batch);
+        clrt_release(&rt);
+        free(A);
+        free(B);
+        free(C_gpu);
+        free(C_cpu);
+        free(C_blocked);
+        return failed;
+    }
+
+    // Пакет малых умножений: пакетный API против цикла по одному
+    if (batched > 0) {
+        int failed = batched_gemm_bench(&rt, program, n, m, k, batched, pointer_array);
+        clrt_release(&rt);
+        free(A);
+        free(B);
+        free(C_gpu);
+        free(C_cpu);
+        free(C_blocked);
+        return failed;
+    }
 
     // ========================================
     // OpenCL: Создание буферов
     // ========================================
 
-    cl_mem bufferA = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-                                    size_A, A, &err);
-    cl_mem bufferB = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
-                                    size_B, B, &err);
+    // A и B копируются явной записью, а не через CL_MEM_COPY_HOST_PTR:
+    // так время передачи видно по событиям
+    cl_mem bufferA = clCreateBuffer(context, CL_MEM_READ_ONLY, size_A, NULL, &err);
+    cl_mem bufferB = clCreateBuffer(context, CL_MEM_READ_ONLY, size_B, NULL, &err);
     cl_mem bufferC = clCreateBuffer(context, CL_MEM_WRITE_ONLY,
                                     size_C, NULL, &err);
 
-    if (!bufferA || !bufferB || !bufferC) {
+    cl_trace trace;
+    trace_init(&trace);
+    double write_time = -1.0;
+    if (bufferA && bufferB && bufferC) {
+        cl_event write_events[2];
+        err = clEnqueueWriteBuffer(queue, bufferA, CL_FALSE, 0, size_A, A, 0, NULL,
+                                   &write_events[0]);
+        if (err == CL_SUCCESS) {
+            err = clEnqueueWriteBuffer(queue, bufferB, CL_FALSE, 0, size_B, B, 0, NULL,
+                                       &write_events[1]);
+            write_time = trace_add(&trace, "write", "запись A", write_events[0]);
+            if (err == CL_SUCCESS) {
+                write_time += trace_add(&trace, "write", "запись B", write_events[1]);
+            }
+        }
+        if (err != CL_SUCCESS) {
+            fprintf(stderr, "Ошибка записи данных: %d\n", err);
+        } else {
+            printf("\nGPU время (запись A, B): %.6f сек\n", write_time);
+        }
+    }
+
+    if (!bufferA || !bufferB || !bufferC || err != CL_SUCCESS) {
+        if (bufferA) clReleaseMemObject(bufferA);
+        if (bufferB) clReleaseMemObject(bufferB);
+        if (bufferC) clReleaseMemObject(bufferC);
         fprintf(stderr, "Ошибка создания буферов\n");
-        clReleaseKernel(kernel);
-        clReleaseProgram(program);
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
+        clrt_release(&rt);
         return 1;
     }
 
-    // Установка аргументов ядра
-    int n_val = N, m_val = M, k_val = K;
-    clSetKernelArg(kernel, 0, sizeof(cl_mem), &bufferA);
-    clSetKernelArg(kernel, 1, sizeof(cl_mem), &bufferB);
-    clSetKernelArg(kernel, 2, sizeof(cl_mem), &bufferC);
-    clSetKernelArg(kernel, 3, sizeof(int), &n_val);
-    clSetKernelArg(kernel, 4, sizeof(int), &m_val);
-    clSetKernelArg(kernel, 5, sizeof(int), &k_val);
+    set_matmul_args(kernel, bufferA, bufferB, bufferC, n, m, k);
+    set_matmul_args(tiled_kernel, bufferA, bufferB, bufferC, n, m, k);
+
+    int failed = 0;
 
     // ========================================
-    // OpenCL: Выполнение ядра
+    // OpenCL: Наивное ядро
     // ========================================
 
-    // Глобальный размер соответствует размеру результирующей матрицы C[N x K]
-    size_t global_size[2] = {N, K};
-    size_t local_size[2] = {16, 16};  // Размер рабочей группы
+    double gpu_kernel_time = 0.0, read_time = 0.0;
+    if (kernel_mode & KERNEL_NAIVE) {
+        // Глобальный размер соответствует размеру результирующей матрицы C[N x K]
+        size_t global_size[2] = {n, k};
+        size_t local_size[2] = {naive_local[0], naive_local[1]};  // Размер рабочей группы
 
-    // Округление глобального размера до кратного локальному
-    global_size[0] = ((N + local_size[0] - 1) / local_size[0]) * local_size[0];
-    global_size[1] = ((K + local_size[1] - 1) / local_size[1]) * local_size[1];
+        // Округление глобального размера до кратного локальному
+        global_size[0] = ((n + local_size[0] - 1) / local_size[0]) * local_size[0];
+        global_size[1] = ((k + local_size[1] - 1) / local_size[1]) * local_size[1];
 
-    printf("Глобальный размер: %zu x %zu\n", global_size[0], global_size[1]);
-    printf("Локальный размер:  %zu x %zu\n\n", local_size[0], local_size[1]);
+        printf("\n=== Наивное ядро ===\n");
+        printf("Глобальный размер: %zu x %zu\n", global_size[0], global_size[1]);
+        printf("Локальный размер:  %zu x %zu\n\n", local_size[0], local_size[1]);
 
-    printf("Выполнение на GPU...\n");
-    double gpu_start = get_time();
+        printf("Выполнение на GPU...\n");
+        err = run_matmul_kernel(queue, kernel, bufferC, C_gpu, size_C, global_size, local_size,
+                                &trace, "matrix_multiply", &gpu_kernel_time, &read_time);
+        if (err != CL_SUCCESS) {
+            fprintf(stderr, "Ошибка запуска наивного ядра: %d\n", err);
+            kernel_mode &= ~KERNEL_NAIVE;
+            failed = 1;
+        } else {
+            printf("GPU время (ядро):   %.6f сек (%.2f GFLOP/s)\n", gpu_kernel_time,
+                   gemm_gflops(n, m, k, gpu_kernel_time));
+            printf("GPU время (чтение): %.6f сек\n", read_time);
+            printf("GPU время (всего):  %.6f сек\n\n", gpu_kernel_time + read_time);
 
-    err = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, global_size, local_size,
-                                 0, NULL, NULL);
-    if (err != CL_SUCCESS) {
-        fprintf(stderr, "Ошибка запуска ядра: %d\n", err);
-        clReleaseMemObject(bufferA);
-        clReleaseMemObject(bufferB);
-        clReleaseMemObject(bufferC);
-        clReleaseKernel(kernel);
-        clReleaseProgram(program);
-        clReleaseCommandQueue(queue);
-        clReleaseContext(context);
-        return 1;
+            int errors = verify_results(C_gpu, C_cpu, n, k, "GPU");
+            printf("Результат: %s (%d ошибок)\n", errors == 0 ? "PASSED" : "FAILED", errors);
+            failed |= errors != 0;
+        }
     }
 
-    clFinish(queue);
-    double gpu_kernel_time = get_time() - gpu_start;
+    // ========================================
+    // OpenCL: Плиточное ядро (локальная память, WPT элементов на поток)
+    // ========================================
 
-    // Чтение результатов
-    double read_start = get_time();
-    err = clEnqueueReadBuffer(queue, bufferC, CL_TRUE, 0, size_C, C_gpu, 0, NULL, NULL);
-    double read_time = get_time() - read_start;
+    double tiled_time = 0.0, tiled_read_time = 0.0;
+    if (kernel_mode & KERNEL_TILED) {
+        // Измерение 0 - столбцы C, измерение 1 - строки C по wpt на элемент
+        size_t local_size[2] = {tile, tile / wpt};
+        size_t global_size[2] = {
+            (size_t)(k + tile - 1) / tile * tile,
+            (size_t)(n + tile - 1) / tile * (tile / wpt)
+        };
 
-    if (err != CL_SUCCESS) {
-        fprintf(stderr, "Ошибка чтения результатов: %d\n", err);
-    }
+        printf("\n=== Плиточное ядро (TILE %d, WPT %d) ===\n", tile, wpt);
+        printf("Глобальный размер: %zu x %zu\n", global_size[0], global_size[1]);
+        printf("Локальный размер:  %zu x %zu\n\n", local_size[0], local_size[1]);
 
-    printf("GPU время (ядро):   %.6f сек\n", gpu_kernel_time);
-    printf("GPU время (чтение): %.6f сек\n", read_time);
-    printf("GPU время (всего):  %.6f сек\n\n", gpu_kernel_time + read_time);
+        size_t max_group = 0;
+        clGetKernelWorkGroupInfo(tiled_kernel, device, CL_KERNEL_WORK_GROUP_SIZE,
+                                 sizeof(max_group), &max_group, NULL);
+        if (max_group < local_size[0] * local_size[1]) {
+            printf("Рабочая группа %zu больше допустимой для ядра (%zu), вариант пропущен\n",
+                   local_size[0] * local_size[1], max_group);
+            kernel_mode &= ~KERNEL_TILED;
+        } else {
+            printf("Выполнение на GPU...\n");
+            err = run_matmul_kernel(queue, tiled_kernel, bufferC, C_gpu, size_C, global_size,
+                                    local_size, &trace, "matrix_multiply_tiled", &tiled_time,
+                                    &tiled_read_time);
+            if (err != CL_SUCCESS) {
+                fprintf(stderr, "Ошибка запуска плиточного ядра: %d\n", err);
+                kernel_mode &= ~KERNEL_TILED;
+                failed = 1;
+            } else {
+                printf("GPU время (ядро):   %.6f сек (%.2f GFLOP/s)\n", tiled_time,
+                       gemm_gflops(n, m, k, tiled_time));
+                printf("GPU время (чтение): %.6f сек\n", tiled_read_time);
+                printf("GPU время (всего):  %.6f сек\n\n", tiled_time + tiled_read_time);
 
-    // ========================================
-    // Проверка корректности
-    // ========================================
-
-    printf("=== Проверка корректности ===\n");
-    int errors = verify_results(C_gpu, C_cpu, N, K);
-    printf("Результат: %s (%d ошибок)\n\n", errors == 0 ? "PASSED" : "FAILED", errors);
+                int errors = verify_results(C_gpu, C_cpu, n, k, "GPU");
+                printf("Результат: %s (%d ошибок)\n", errors == 0 ? "PASSED" : "FAILED",
+                       errors);
+                failed |= errors != 0;
+            }
+        }
+    }
 
     // ========================================
     // Сравнение производительности
     // ========================================
 
-    printf("=== Сравнение производительности ===\n");
-    printf("CPU время:              %.6f сек\n", cpu_time);
-    printf("GPU время (ядро):       %.6f сек\n", gpu_kernel_time);
-    printf("GPU время (с чтением):  %.6f сек\n", gpu_kernel_time + read_time);
     printf("\n");
-    printf("Ускорение (только ядро): %.2fx\n", cpu_time / gpu_kernel_time);
-    printf("Ускорение (с передачей): %.2fx\n", cpu_time / (gpu_kernel_time + read_time));
+    trace_print(&trace);
+    if (trace_path) {
+        trace_write_chrome(&trace, trace_path);
+    }
+
+    printf("\n=== Сравнение производительности ===\n");
+    printf("CPU время:              %.6f сек (%.2f GFLOP/s)\n", cpu_time,
+           gemm_gflops(n, m, k, cpu_time));
+    printf("CPU время (блочный):    %.6f сек (%.2f GFLOP/s)\n", blocked_time,
+           gemm_gflops(n, m, k, blocked_time));
+    if (kernel_mode & KERNEL_NAIVE) {
+        printf("GPU наивное (ядро):     %.6f сек (%.2f GFLOP/s)\n", gpu_kernel_time,
+               gemm_gflops(n, m, k, gpu_kernel_time));
+        printf("GPU наивное (с чтением): %.6f сек\n", gpu_kernel_time + read_time);
+        printf("GPU наивное (с записью и чтением): %.6f сек\n",
+               write_time + gpu_kernel_time + read_time);
+    }
+    if (kernel_mode & KERNEL_TILED) {
+        printf("GPU плиточное (ядро):   %.6f сек (%.2f GFLOP/s)\n", tiled_time,
+               gemm_gflops(n, m, k, tiled_time));
+        printf("GPU плиточное (с чтением): %.6f сек\n", tiled_time + tiled_read_time);
+        printf("GPU плиточное (с записью и чтением): %.6f сек\n",
+               write_time + tiled_time + tiled_read_time);
+    }
+    printf("\n");
+    if (kernel_mode & KERNEL_NAIVE) {
+        printf("Ускорение наивного (только ядро): %.2fx\n", cpu_time / gpu_kernel_time);
+        printf("Ускорение наивного (с передачей): %.2fx\n",
+               cpu_time / (write_time + gpu_kernel_time + read_time));
+    }
+    if (kernel_mode & KERNEL_TILED) {
+        printf("Ускорение плиточного (только ядро): %.2fx\n", cpu_time / tiled_time);
+        printf("Ускорение плиточного относительно блочного CPU: %.2fx\n",
+               blocked_time / tiled_time);
+    }
+    if ((kernel_mode & KERNEL_NAIVE) && (kernel_mode & KERNEL_TILED)) {
+        printf("Плиточное ядро относительно наивного: %.2fx\n", gpu_kernel_time / tiled_time);
+    }
 
     // ========================================
     // Вывод примера результатов
     // ========================================
 
-    printf("\n=== Пример результатов (C[0][0..4]) ===\n");
-    for (int j = 0; j < 5 && j < K; j++) {
-        printf("C[0][%d] = %.4f (GPU) vs %.4f (CPU)\n", j, C_gpu[j], C_cpu[j]);
+    // C_gpu - результат последнего выполненного ядра
+    if (kernel_mode != 0) {
+        printf("\n=== Пример результатов (C[0][0..4]) ===\n");
+        for (int j = 0; j < 5 && j < k; j++) {
+            printf("C[0][%d] = %.4f (GPU) vs %.4f (CPU)\n", j, C_gpu[j], C_cpu[j]);
+        }
     }
 
     // ========================================
@@ -342,17 +1703,15 @@ int main() {
     clReleaseMemObject(bufferA);
     clReleaseMemObject(bufferB);
     clReleaseMemObject(bufferC);
-    clReleaseKernel(kernel);
-    clReleaseProgram(program);
-    clReleaseCommandQueue(queue);
-    clReleaseContext(context);
+    clrt_release(&rt);
 
     free(A);
     free(B);
     free(C_gpu);
     free(C_cpu);
+    free(C_blocked);
 
     printf("\nРесурсы освобождены. Программа завершена.\n");
 
-    return 0;
+    return failed ? 1 : 0;
 }
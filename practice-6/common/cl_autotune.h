@@ -0,0 +1,185 @@
+/*
+ * Автонастройка ядер OpenCL для хостов практики 6.
+ *
+ * Лучшие параметры зависят от устройства: размер рабочей группы,
+ * сторона плитки, ширина вектора. Режим автонастройки хоста
+ * перебирает варианты сборки (-D параметры) и допустимые размеры
+ * рабочей группы, замеряет каждый событиями профилирования
+ * (CL_PROFILING_COMMAND_START..END, без накладных расходов хоста)
+ * и сохраняет лучший вариант в текстовый файл кэша:
+ *
+ *   устройство|версия драйвера|задача<TAB>параметры
+ *
+ * При обычном запуске хост берет параметры из кэша, если для его
+ * устройства и драйвера там есть строка, иначе - значения по умолчанию.
+ */
+
+#ifndef PRACTICE6_CL_AUTOTUNE_H
+#define PRACTICE6_CL_AUTOTUNE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#define AUTOTUNE_DEFAULT_CACHE "autotune_cache.txt"
+#define AUTOTUNE_MAX_LINE 1024
+#define AUTOTUNE_MAX_GROUPS 32
+
+// Ключ кэша: имя устройства, версия драйвера и задача
+static void autotune_key(cl_device_id device, const char* task, char* key, size_t size) {
+    char name[256] = "";
+    char driver[256] = "";
+    clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(name), name, NULL);
+    clGetDeviceInfo(device, CL_DRIVER_VERSION, sizeof(driver), driver, NULL);
+    snprintf(key, size, "%s|%s|%s", name, driver, task);
+}
+
+// Значение ключа из кэша; 0 - найдено
+static int autotune_cache_load(const char* path, const char* key, char* value, size_t size) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return -1;
+    }
+    char line[AUTOTUNE_MAX_LINE];
+    size_t key_length = strlen(key);
+    int found = -1;
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, key, key_length) == 0 && line[key_length] == '\t') {
+            snprintf(value, size, "%s", line + key_length + 1);
+            value[strcspn(value, "\r\n")] = '\0';
+            found = 0;
+        }
+    }
+    fclose(file);
+    return found;
+}
+
+// Запись значения ключа: строка ключа заменяется, остальные сохраняются
+// (файл переписывается через временный и rename); 0 - успех
+static int autotune_cache_store(const char* path, const char* key, const char* value) {
+    char temp_path[AUTOTUNE_MAX_LINE];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    FILE* out = fopen(temp_path, "w");
+    if (!out) {
+        fprintf(stderr, "Не удалось записать кэш автонастройки %s\n", temp_path);
+        return -1;
+    }
+
+    FILE* in = fopen(path, "r");
+    if (in) {
+        char line[AUTOTUNE_MAX_LINE];
+        size_t key_length = strlen(key);
+        while (fgets(line, sizeof(line), in)) {
+            if (!(strncmp(line, key, key_length) == 0 && line[key_length] == '\t')) {
+                fputs(line, out);
+            }
+        }
+        fclose(in);
+    }
+    fprintf(out, "%s\t%s\n", key, value);
+
+    if (fclose(out) != 0 || rename(temp_path, path) != 0) {
+        fprintf(stderr, "Не удалось записать кэш автонастройки %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+// Сборка программы с параметрами; при ошибке печатает лог и возвращает NULL
+static cl_program autotune_build(cl_context context, cl_device_id device,
+                                 const char* source, size_t length, const char* options) {
+    cl_int err;
+    cl_program program = clCreateProgramWithSource(context, 1, &source, &length, &err);
+    if (err != CL_SUCCESS) {
+        return NULL;
+    }
+    err = clBuildProgram(program, 1, &device, options, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        size_t log_size = 0;
+        clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
+        char* log = (char*)malloc(log_size + 1);
+        if (log) {
+            clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, log_size, log, NULL);
+            log[log_size] = '\0';
+            fprintf(stderr, "Ошибка сборки с \"%s\":\n%s\n", options ? options : "", log);
+            free(log);
+        }
+        clReleaseProgram(program);
+        return NULL;
+    }
+    return program;
+}
+
+// Предел рабочей группы для ядра: меньшее из ограничений устройства
+// и ядра (регистры, локальная память)
+static size_t autotune_max_group(cl_device_id device, cl_kernel kernel) {
+    size_t device_max = 1;
+    size_t kernel_max = 0;
+    clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(device_max), &device_max, NULL);
+    if (clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE,
+                                 sizeof(kernel_max), &kernel_max, NULL) == CL_SUCCESS
+        && kernel_max > 0 && kernel_max < device_max) {
+        return kernel_max;
+    }
+    return device_max;
+}
+
+// Размеры рабочей группы для перебора: степени двойки, кратные
+// CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE, до предела ядра
+static int autotune_group_sizes(cl_device_id device, cl_kernel kernel,
+                                size_t* sizes, int capacity) {
+    size_t multiple = 1;
+    clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE,
+                             sizeof(multiple), &multiple, NULL);
+    if (multiple == 0) {
+        multiple = 1;
+    }
+    size_t limit = autotune_max_group(device, kernel);
+    int count = 0;
+    for (size_t size = 1; size <= limit && count < capacity; size *= 2) {
+        if (size % multiple == 0 || size < multiple) {
+            sizes[count++] = size;
+        }
+    }
+    return count;
+}
+
+// Время команды по событию (START..END), сек
+static double autotune_event_seconds(cl_event event) {
+    cl_ulong start = 0;
+    cl_ulong end = 0;
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL);
+    clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL);
+    return end > start ? (end - start) / 1e9 : 0.0;
+}
+
+// Лучшее время ядра из reps запусков после прогревочного (очередь
+// должна быть с CL_QUEUE_PROFILING_ENABLE); -1 - запуск не удался
+static double autotune_time_kernel(cl_command_queue queue, cl_kernel kernel, cl_uint dims,
+                                   const size_t* global_size, const size_t* local_size,
+                                   int reps) {
+    double best = -1.0;
+    for (int r = 0; r <= reps; r++) {
+        cl_event event;
+        cl_int err = clEnqueueNDRangeKernel(queue, kernel, dims, NULL, global_size, local_size,
+                                            0, NULL, &event);
+        if (err != CL_SUCCESS) {
+            return -1.0;
+        }
+        clWaitForEvents(1, &event);
+        double seconds = autotune_event_seconds(event);
+        clReleaseEvent(event);
+        if (r > 0 && (best < 0 || seconds < best)) {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+#endif // PRACTICE6_CL_AUTOTUNE_H
@@ -0,0 +1,226 @@
+/*
+ * Кэш скомпилированных программ OpenCL для хостов практики 6.
+ *
+ * clBuildProgram компилирует ядра драйвером при каждом запуске, и для
+ * коротких заданий это дольше самих ядер. Здесь двоичный код программы
+ * (CL_PROGRAM_BINARIES) после первой сборки сохраняется на диск, а при
+ * следующих запусках загружается через clCreateProgramWithBinary.
+ *
+ * Файл кэша - DIR/<хэш ключа>.bin: первая строка - ключ (имя устройства,
+ * версия драйвера, параметры сборки, хэш исходника), дальше - двоичный
+ * код. Другой драйвер, другие -D параметры или правка .cl дают другой
+ * ключ. Если загрузка или сборка двоичного кода не удалась (драйвер
+ * отверг его), программа собирается из исходника и файл перезаписывается.
+ */
+
+#ifndef PRACTICE6_CL_PROGRAM_CACHE_H
+#define PRACTICE6_CL_PROGRAM_CACHE_H
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#define PROGRAM_CACHE_DEFAULT_DIR "kernel_cache"
+#define PROGRAM_CACHE_MAX_KEY 1024
+
+// FNV-1a (64 бита), продолжает хэш hash
+static unsigned long long program_cache_hash(const void* data, size_t size,
+                                             unsigned long long hash) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Ключ и путь файла кэша для программы
+static void program_cache_key(cl_device_id device, const char* source, size_t length,
+                              const char* options, const char* dir,
+                              char* key, size_t key_size, char* path, size_t path_size) {
+    char name[256] = "";
+    char driver[256] = "";
+    clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(name), name, NULL);
+    clGetDeviceInfo(device, CL_DRIVER_VERSION, sizeof(driver), driver, NULL);
+    unsigned long long source_hash = program_cache_hash(source, length, 14695981039346656037ULL);
+    snprintf(key, key_size, "%s|%s|%s|%016llx", name, driver, options ? options : "",
+             source_hash);
+    snprintf(path, path_size, "%s/%016llx.bin", dir,
+             program_cache_hash(key, strlen(key), 14695981039346656037ULL));
+}
+
+// Печать лога сборки программы для устройства
+static void program_cache_print_log(cl_program program, cl_device_id device) {
+    size_t log_size = 0;
+    clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
+    char* log = (char*)malloc(log_size + 1);
+    if (log) {
+        clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, log_size, log, NULL);
+        log[log_size] = '\0';
+        fprintf(stderr, "Лог компиляции:\n%s\n", log);
+        free(log);
+    }
+}
+
+// Программа из файла кэша (уже собранная); NULL - файла нет, ключ
+// не совпал или драйвер отверг двоичный код
+static cl_program program_cache_load(cl_context context, cl_device_id device,
+                                     const char* path, const char* key, const char* options) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    char stored_key[PROGRAM_CACHE_MAX_KEY];
+    unsigned char* binary = NULL;
+    size_t size = 0;
+    if (fgets(stored_key, sizeof(stored_key), file)) {
+        stored_key[strcspn(stored_key, "\n")] = '\0';
+        long start = ftell(file);
+        if (strcmp(stored_key, key) == 0 && fseek(file, 0, SEEK_END) == 0) {
+            long end = ftell(file);
+            size = end > start ? (size_t)(end - start) : 0;
+            binary = size > 0 ? (unsigned char*)malloc(size) : NULL;
+            if (binary && (fseek(file, start, SEEK_SET) != 0
+                           || fread(binary, 1, size, file) != size)) {
+                free(binary);
+                binary = NULL;
+            }
+        }
+    }
+    fclose(file);
+    if (!binary) {
+        return NULL;
+    }
+
+    cl_int status;
+    cl_int err;
+    const unsigned char* binaries[1] = {binary};
+    cl_program program = clCreateProgramWithBinary(context, 1, &device, &size, binaries,
+                                                   &status, &err);
+    free(binary);
+    if (err != CL_SUCCESS || status != CL_SUCCESS) {
+        if (program) {
+            clReleaseProgram(program);
+        }
+        return NULL;
+    }
+    // Двоичный код тоже нужно "собрать": драйвер связывает программу
+    if (clBuildProgram(program, 1, &device, options, NULL, NULL) != CL_SUCCESS) {
+        clReleaseProgram(program);
+        return NULL;
+    }
+    return program;
+}
+
+// Запись файла кэша через временный файл и rename, чтобы параллельный
+// запуск не прочитал половину; 0 - успех
+static int program_cache_write(const char* path, const char* key,
+                               const unsigned char* binary, size_t size) {
+    char temp_path[PROGRAM_CACHE_MAX_KEY + 8];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    FILE* file = fopen(temp_path, "wb");
+    if (!file) {
+        return -1;
+    }
+    int ok = fprintf(file, "%s\n", key) > 0 && fwrite(binary, 1, size, file) == size;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(temp_path, path) != 0) {
+        remove(temp_path);
+        return -1;
+    }
+    return 0;
+}
+
+// Сохранение двоичного кода программы для device; 0 - успех
+static int program_cache_save(cl_program program, cl_device_id device, const char* dir,
+                              const char* path, const char* key) {
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        return -1;
+    }
+
+    // Двоичные коды возвращаются по всем устройствам программы
+    cl_uint device_count = 0;
+    clGetProgramInfo(program, CL_PROGRAM_NUM_DEVICES, sizeof(device_count), &device_count, NULL);
+    if (device_count == 0) {
+        return -1;
+    }
+    cl_device_id* devices = (cl_device_id*)calloc(device_count, sizeof(cl_device_id));
+    size_t* sizes = (size_t*)calloc(device_count, sizeof(size_t));
+    unsigned char** binaries = (unsigned char**)calloc(device_count, sizeof(unsigned char*));
+    cl_uint index = device_count;
+    if (devices && sizes && binaries) {
+        clGetProgramInfo(program, CL_PROGRAM_DEVICES, device_count * sizeof(cl_device_id),
+                         devices, NULL);
+        clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, device_count * sizeof(size_t),
+                         sizes, NULL);
+        for (cl_uint d = 0; d < device_count; d++) {
+            if (devices[d] == device && sizes[d] > 0) {
+                index = d;
+            }
+        }
+    }
+
+    // Память нужна только под свое устройство, остальные указатели - NULL
+    int result = -1;
+    if (index < device_count) {
+        binaries[index] = (unsigned char*)malloc(sizes[index]);
+        if (binaries[index]
+            && clGetProgramInfo(program, CL_PROGRAM_BINARIES,
+                                device_count * sizeof(unsigned char*), binaries,
+                                NULL) == CL_SUCCESS) {
+            result = program_cache_write(path, key, binaries[index], sizes[index]);
+        }
+        free(binaries[index]);
+    }
+    free(binaries);
+    free(sizes);
+    free(devices);
+    return result;
+}
+
+// Собранная программа: из кэша в dir или из исходника (dir = NULL -
+// без кэша). *from_cache = 1, если взята из кэша. При ошибке сборки
+// печатает лог и возвращает NULL
+static cl_program program_cache_build(cl_context context, cl_device_id device,
+                                      const char* source, size_t length, const char* options,
+                                      const char* dir, int* from_cache) {
+    char key[PROGRAM_CACHE_MAX_KEY];
+    char path[PROGRAM_CACHE_MAX_KEY];
+    *from_cache = 0;
+    if (dir) {
+        program_cache_key(device, source, length, options, dir, key, sizeof(key),
+                          path, sizeof(path));
+        cl_program program = program_cache_load(context, device, path, key, options);
+        if (program) {
+            *from_cache = 1;
+            return program;
+        }
+    }
+
+    cl_int err;
+    cl_program program = clCreateProgramWithSource(context, 1, &source, &length, &err);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "Ошибка создания программы: %d\n", err);
+        return NULL;
+    }
+    err = clBuildProgram(program, 1, &device, options, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "Ошибка компиляции программы: %d\n", err);
+        program_cache_print_log(program, device);
+        clReleaseProgram(program);
+        return NULL;
+    }
+    if (dir && program_cache_save(program, device, dir, path, key) != 0) {
+        fprintf(stderr, "Не удалось сохранить программу в кэш %s\n", path);
+    }
+    return program;
+}
+
+#endif // PRACTICE6_CL_PROGRAM_CACHE_H
@@ -0,0 +1,438 @@
+/*
+ * Общая среда OpenCL для хостов практики 6: выбор устройства, сборка
+ * программ, пул буферов и пакеты задач. Описание - в cl_runtime.h.
+ */
+
+#include "cl_runtime.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cl_program_cache.h"
+
+#define CLRT_MAX_PLATFORMS 8
+
+int clrt_enumerate_devices(cl_platform_id* owners, cl_device_id* devices, int max) {
+    cl_platform_id platforms[CLRT_MAX_PLATFORMS];
+    cl_uint platform_count = 0;
+    if (clGetPlatformIDs(CLRT_MAX_PLATFORMS, platforms, &platform_count) != CL_SUCCESS) {
+        return 0;
+    }
+    if (platform_count > CLRT_MAX_PLATFORMS) {
+        platform_count = CLRT_MAX_PLATFORMS;
+    }
+    int count = 0;
+    for (cl_uint p = 0; p < platform_count && count < max; p++) {
+        cl_uint found = 0;
+        if (clGetDeviceIDs(platforms[p], CL_DEVICE_TYPE_ALL, (cl_uint)(max - count),
+                           devices + count, &found) != CL_SUCCESS) {
+            continue;
+        }
+        if (found > (cl_uint)(max - count)) {
+            found = (cl_uint)(max - count);
+        }
+        for (cl_uint d = 0; d < found; d++) {
+            owners[count + d] = platforms[p];
+        }
+        count += (int)found;
+    }
+    return count;
+}
+
+static cl_device_type clrt_device_type(cl_device_id device) {
+    cl_device_type type = 0;
+    clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof(type), &type, NULL);
+    return type;
+}
+
+static const char* clrt_type_name(cl_device_type type) {
+    return (type & CL_DEVICE_TYPE_GPU) ? "GPU"
+         : (type & CL_DEVICE_TYPE_CPU) ? "CPU"
+         : (type & CL_DEVICE_TYPE_ACCELERATOR) ? "ускоритель" : "другое";
+}
+
+static int clrt_matches(const clrt_device_spec* spec, cl_device_id device, int index) {
+    if (spec->index >= 0 && spec->index != index) {
+        return 0;
+    }
+    if (spec->type != CL_DEVICE_TYPE_ALL && !(clrt_device_type(device) & spec->type)) {
+        return 0;
+    }
+    if (spec->name[0] != '\0') {
+        char name[256];
+        clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(name), name, NULL);
+        return strstr(name, spec->name) != NULL;
+    }
+    return 1;
+}
+
+void clrt_default_device(clrt_device_spec* spec) {
+    memset(spec, 0, sizeof(*spec));
+    spec->type = CL_DEVICE_TYPE_ALL;
+    spec->index = -1;
+}
+
+int clrt_parse_device(const char* text, clrt_device_spec* spec) {
+    clrt_default_device(spec);
+    if (text[0] == '\0') {
+        return -1;
+    }
+    char* end;
+    long index = strtol(text, &end, 10);
+    if (*end == '\0') {
+        spec->index = (int)index;
+        return index >= 0 ? 0 : -1;
+    }
+    if (strcmp(text, "gpu") == 0) {
+        spec->type = CL_DEVICE_TYPE_GPU;
+    } else if (strcmp(text, "cpu") == 0) {
+        spec->type = CL_DEVICE_TYPE_CPU;
+    } else if (strcmp(text, "accelerator") == 0) {
+        spec->type = CL_DEVICE_TYPE_ACCELERATOR;
+    } else {
+        snprintf(spec->name, sizeof(spec->name), "%s", text);
+    }
+    return 0;
+}
+
+int clrt_list_devices(void) {
+    cl_platform_id owners[CLRT_MAX_DEVICES];
+    cl_device_id devices[CLRT_MAX_DEVICES];
+    int count = clrt_enumerate_devices(owners, devices, CLRT_MAX_DEVICES);
+    printf("Устройства OpenCL (--device номер|gpu|cpu|accelerator|часть имени):\n");
+    for (int i = 0; i < count; i++) {
+        char platform_name[256];
+        char device_name[256];
+        clGetPlatformInfo(owners[i], CL_PLATFORM_NAME, sizeof(platform_name), platform_name,
+                          NULL);
+        clGetDeviceInfo(devices[i], CL_DEVICE_NAME, sizeof(device_name), device_name, NULL);
+        printf("  %d: %s (%s, платформа %s)\n", i, device_name,
+               clrt_type_name(clrt_device_type(devices[i])), platform_name);
+    }
+    if (count == 0) {
+        printf("  нет\n");
+    }
+    return count;
+}
+
+cl_command_queue clrt_create_queue(cl_context context, cl_device_id device, cl_int* err) {
+#ifdef CL_VERSION_2_0
+    cl_queue_properties queue_properties[] = {CL_QUEUE_PROPERTIES, CL_QUEUE_PROFILING_ENABLE, 0};
+    return clCreateCommandQueueWithProperties(context, device, queue_properties, err);
+#else
+    return clCreateCommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE, err);
+#endif
+}
+
+char* clrt_read_source(const char* path, size_t* length) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Ошибка: не удалось открыть файл %s\n", path);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+    char* source = size >= 0 ? (char*)malloc((size_t)size + 1) : NULL;
+    if (!source || fread(source, 1, (size_t)size, file) != (size_t)size) {
+        fprintf(stderr, "Ошибка чтения файла %s\n", path);
+        free(source);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+    source[size] = '\0';
+    *length = (size_t)size;
+    return source;
+}
+
+int clrt_init(cl_runtime* rt, const clrt_device_spec* spec, const char* cache_dir) {
+    memset(rt, 0, sizeof(*rt));
+
+    cl_platform_id owners[CLRT_MAX_DEVICES];
+    cl_device_id devices[CLRT_MAX_DEVICES];
+    int count = clrt_enumerate_devices(owners, devices, CLRT_MAX_DEVICES);
+    if (count == 0) {
+        fprintf(stderr, "Ошибка: устройства OpenCL не найдены\n");
+        return -1;
+    }
+
+    // Без явного выбора - первый GPU, как раньше, иначе первое устройство
+    int chosen = -1;
+    int explicit_choice = spec->type != CL_DEVICE_TYPE_ALL || spec->name[0] != '\0'
+                          || spec->index >= 0;
+    for (int i = 0; i < count && chosen < 0; i++) {
+        if (explicit_choice ? clrt_matches(spec, devices[i], i)
+                            : (clrt_device_type(devices[i]) & CL_DEVICE_TYPE_GPU) != 0) {
+            chosen = i;
+        }
+    }
+    if (chosen < 0 && explicit_choice) {
+        fprintf(stderr, "Ошибка: подходящее устройство не найдено\n");
+        clrt_list_devices();
+        return -1;
+    }
+    if (chosen < 0) {
+        chosen = 0;
+        printf("GPU не найден, используем %s...\n",
+               clrt_type_name(clrt_device_type(devices[0])));
+    }
+    if (clrt_init_device(rt, owners[chosen], devices[chosen], cache_dir) != 0) {
+        return -1;
+    }
+    rt->device_index = chosen;
+    return 0;
+}
+
+int clrt_init_device(cl_runtime* rt, cl_platform_id platform, cl_device_id device,
+                     const char* cache_dir) {
+    memset(rt, 0, sizeof(*rt));
+    rt->cache_dir = cache_dir;
+    rt->platform = platform;
+    rt->device = device;
+    rt->device_index = -1;
+    clGetPlatformInfo(rt->platform, CL_PLATFORM_NAME, sizeof(rt->platform_name),
+                      rt->platform_name, NULL);
+    clGetDeviceInfo(rt->device, CL_DEVICE_NAME, sizeof(rt->device_name), rt->device_name, NULL);
+
+    cl_int err;
+    rt->context = clCreateContext(NULL, 1, &rt->device, NULL, NULL, &err);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "Ошибка создания контекста: %d\n", err);
+        rt->context = NULL;
+        return -1;
+    }
+    rt->queue = clrt_create_queue(rt->context, rt->device, &err);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "Ошибка создания очереди: %d\n", err);
+        rt->queue = NULL;
+        clrt_release(rt);
+        return -1;
+    }
+    return 0;
+}
+
+int clrt_sub_devices(cl_device_id device, int units, cl_device_id* sub_devices, int max) {
+#ifdef CL_VERSION_1_2
+    cl_device_partition_property properties[] = {CL_DEVICE_PARTITION_EQUALLY,
+                                                  (cl_device_partition_property)units, 0};
+    cl_uint count = 0;
+    if (units < 1 || clCreateSubDevices(device, properties, 0, NULL, &count) != CL_SUCCESS
+        || count == 0 || count > (cl_uint)max
+        || clCreateSubDevices(device, properties, count, sub_devices, NULL) != CL_SUCCESS) {
+        return 0;
+    }
+    return (int)count;
+#else
+    (void)device;
+    (void)units;
+    (void)sub_devices;
+    (void)max;
+    return 0;
+#endif
+}
+
+void clrt_release(cl_runtime* rt) {
+    if (rt->queue) {
+        clFinish(rt->queue);
+    }
+    for (int i = 0; i < rt->buffer_count; i++) {
+        clReleaseMemObject(rt->buffers[i].buffer);
+    }
+    for (int i = 0; i < rt->kernel_count; i++) {
+        clReleaseKernel(rt->kernels[i].kernel);
+    }
+    for (int i = 0; i < rt->program_count; i++) {
+        clReleaseProgram(rt->programs[i].program);
+    }
+    if (rt->queue) {
+        clReleaseCommandQueue(rt->queue);
+    }
+    if (rt->context) {
+        clReleaseContext(rt->context);
+    }
+    rt->buffer_count = rt->kernel_count = rt->program_count = 0;
+    rt->queue = NULL;
+    rt->context = NULL;
+}
+
+cl_program clrt_build(cl_runtime* rt, const char* source, size_t length, const char* options,
+                      int* from_cache) {
+    const char* opts = options ? options : "";
+    unsigned long long hash = program_cache_hash(source, length, 14695981039346656037ULL);
+    hash = program_cache_hash(opts, strlen(opts) + 1, hash);
+    for (int i = 0; i < rt->program_count; i++) {
+        if (rt->programs[i].hash == hash) {
+            *from_cache = rt->programs[i].from_cache;
+            return rt->programs[i].program;
+        }
+    }
+    if (rt->program_count == CLRT_MAX_PROGRAMS) {
+        fprintf(stderr, "Слишком много программ в среде OpenCL (%d)\n", CLRT_MAX_PROGRAMS);
+        return NULL;
+    }
+    cl_program program = program_cache_build(rt->context, rt->device, source, length, options,
+                                             rt->cache_dir, from_cache);
+    if (program) {
+        clrt_program* entry = &rt->programs[rt->program_count++];
+        entry->program = program;
+        entry->hash = hash;
+        entry->from_cache = *from_cache;
+    }
+    return program;
+}
+
+cl_kernel clrt_kernel_create(cl_runtime* rt, cl_program program, const char* name) {
+    for (int i = 0; i < rt->kernel_count; i++) {
+        if (rt->kernels[i].program == program && strcmp(rt->kernels[i].name, name) == 0) {
+            return rt->kernels[i].kernel;
+        }
+    }
+    if (rt->kernel_count == CLRT_MAX_KERNELS) {
+        fprintf(stderr, "Слишком много ядер в среде OpenCL (%d)\n", CLRT_MAX_KERNELS);
+        return NULL;
+    }
+    cl_int err;
+    cl_kernel kernel = clCreateKernel(program, name, &err);
+    if (err != CL_SUCCESS) {
+        fprintf(stderr, "Ошибка создания ядра %s: %d\n", name, err);
+        return NULL;
+    }
+    clrt_kernel* entry = &rt->kernels[rt->kernel_count++];
+    entry->program = program;
+    snprintf(entry->name, sizeof(entry->name), "%s", name);
+    entry->kernel = kernel;
+    return kernel;
+}
+
+cl_kernel clrt_kernel_find(const cl_runtime* rt, const char* name) {
+    for (int i = 0; i < rt->kernel_count; i++) {
+        if (strcmp(rt->kernels[i].name, name) == 0) {
+            return rt->kernels[i].kernel;
+        }
+    }
+    return NULL;
+}
+
+cl_mem clrt_buffer_acquire(cl_runtime* rt, cl_mem_flags flags, size_t size, cl_int* err) {
+    // Наименьший свободный буфер с теми же флагами, в который помещается size
+    clrt_buffer* best = NULL;
+    for (int i = 0; i < rt->buffer_count; i++) {
+        clrt_buffer* entry = &rt->buffers[i];
+        if (!entry->in_use && entry->flags == flags && entry->size >= size
+            && (!best || entry->size < best->size)) {
+            best = entry;
+        }
+    }
+    if (best) {
+        best->in_use = 1;
+        rt->reuses++;
+        *err = CL_SUCCESS;
+        return best->buffer;
+    }
+
+    cl_mem buffer = clCreateBuffer(rt->context, flags, size, NULL, err);
+    if (*err != CL_SUCCESS) {
+        return NULL;
+    }
+    rt->allocations++;
+    // Пул полон - буфер живет без пула и освобождается при возврате
+    if (rt->buffer_count < CLRT_MAX_BUFFERS) {
+        clrt_buffer* entry = &rt->buffers[rt->buffer_count++];
+        entry->buffer = buffer;
+        entry->flags = flags;
+        entry->size = size;
+        entry->in_use = 1;
+    }
+    return buffer;
+}
+
+void clrt_buffer_recycle(cl_runtime* rt, cl_mem buffer) {
+    for (int i = 0; i < rt->buffer_count; i++) {
+        if (rt->buffers[i].buffer == buffer) {
+            rt->buffers[i].in_use = 0;
+            return;
+        }
+    }
+    clReleaseMemObject(buffer);
+}
+
+// Постановка одной задачи: запись входов, ядро, чтение результата;
+// буферы возвращаются в пул сразу (очередь упорядоченная)
+static cl_int clrt_enqueue_job(cl_runtime* rt, const clrt_job* job, cl_kernel vector_add,
+                               cl_kernel matmul) {
+    int vector = job->type == CLRT_VECTOR_ADD;
+    size_t size_a = vector ? (size_t)job->n : (size_t)job->n * job->m;
+    size_t size_b = vector ? (size_t)job->n : (size_t)job->m * job->k;
+    size_t size_c = vector ? (size_t)job->n : (size_t)job->n * job->k;
+    cl_kernel kernel = vector ? vector_add : matmul;
+    if (!kernel) {
+        fprintf(stderr, "Ядро %s не создано в среде OpenCL\n",
+                vector ? "vector_add" : "matrix_multiply");
+        return CL_INVALID_KERNEL;
+    }
+    if (size_c == 0) {
+        return CL_SUCCESS;
+    }
+
+    cl_int err;
+    cl_mem a = clrt_buffer_acquire(rt, CL_MEM_READ_ONLY, size_a * sizeof(float), &err);
+    cl_mem b = NULL, c = NULL;
+    if (err == CL_SUCCESS) {
+        b = clrt_buffer_acquire(rt, CL_MEM_READ_ONLY, size_b * sizeof(float), &err);
+    }
+    if (err == CL_SUCCESS) {
+        c = clrt_buffer_acquire(rt, CL_MEM_WRITE_ONLY, size_c * sizeof(float), &err);
+    }
+    if (err == CL_SUCCESS) {
+        err = clEnqueueWriteBuffer(rt->queue, a, CL_FALSE, 0, size_a * sizeof(float), job->a,
+                                   0, NULL, NULL);
+    }
+    if (err == CL_SUCCESS) {
+        err = clEnqueueWriteBuffer(rt->queue, b, CL_FALSE, 0, size_b * sizeof(float), job->b,
+                                   0, NULL, NULL);
+    }
+    if (err == CL_SUCCESS) {
+        // Аргументы фиксируются при постановке ядра в очередь
+        clSetKernelArg(kernel, 0, sizeof(cl_mem), &a);
+        clSetKernelArg(kernel, 1, sizeof(cl_mem), &b);
+        clSetKernelArg(kernel, 2, sizeof(cl_mem), &c);
+        if (vector) {
+            size_t global_size = (size_t)job->n;
+            err = clEnqueueNDRangeKernel(rt->queue, kernel, 1, NULL, &global_size, NULL,
+                                         0, NULL, NULL);
+        } else {
+            clSetKernelArg(kernel, 3, sizeof(int), &job->n);
+            clSetKernelArg(kernel, 4, sizeof(int), &job->m);
+            clSetKernelArg(kernel, 5, sizeof(int), &job->k);
+            size_t global_size[2] = {(size_t)job->n, (size_t)job->k};
+            err = clEnqueueNDRangeKernel(rt->queue, kernel, 2, NULL, global_size, NULL,
+                                         0, NULL, NULL);
+        }
+    }
+    if (err == CL_SUCCESS) {
+        err = clEnqueueReadBuffer(rt->queue, c, CL_FALSE, 0, size_c * sizeof(float), job->c,
+                                  0, NULL, NULL);
+    }
+    if (a) clrt_buffer_recycle(rt, a);
+    if (b) clrt_buffer_recycle(rt, b);
+    if (c) clrt_buffer_recycle(rt, c);
+    return err;
+}
+
+cl_int clrt_run_batch(cl_runtime* rt, const clrt_job* jobs, int count) {
+    cl_kernel vector_add = clrt_kernel_find(rt, "vector_add");
+    cl_kernel matmul = clrt_kernel_find(rt, "matrix_multiply");
+    cl_int err = CL_SUCCESS;
+    for (int i = 0; i < count && err == CL_SUCCESS; i++) {
+        err = clrt_enqueue_job(rt, &jobs[i], vector_add, matmul);
+        // Отправка устройству по ходу, а не при первом ожидании
+        if (i % 16 == 15) {
+            clFlush(rt->queue);
+        }
+    }
+    // Неблокирующие чтения пишут в память задач: ждем их и при ошибке
+    cl_int finish = clFinish(rt->queue);
+    return err != CL_SUCCESS ? err : finish;
+}
@@ -0,0 +1,156 @@
+/*
+ * Общая среда OpenCL для хостов практики 6.
+ *
+ * Раньше каждый хост в main() сам искал платформу и устройство, создавал
+ * контекст и очередь, читал и собирал ядро и все это освобождал - на
+ * каждый запуск и каждую задачу заново. Здесь это один объект:
+ *   - устройство выбирается по типу (gpu, cpu, accelerator), подстроке
+ *     имени или номеру в общем списке всех платформ (clrt_parse_device);
+ *     по умолчанию - первый GPU, без него - первое устройство любого типа
+ *   - программа собирается один раз на исходник и параметры сборки
+ *     (через кэш программ на диске), ядра создаются один раз на имя
+ *   - буферы берутся из пула: освобожденный буфер с теми же флагами и
+ *     подходящим размером отдается следующей задаче без clCreateBuffer
+ *   - пакет задач vector_add и matrix_multiply ставится в одну очередь
+ *     подряд, без ожидания между задачами, с одним clFinish в конце
+ *   - для разбиения работы между устройствами среду можно создать на
+ *     любом устройстве из общего списка или на подустройстве
+ * Очередь - упорядоченная (in-order) с профилированием: поэтому буфер
+ * можно вернуть в пул сразу после постановки чтения, следующая запись в
+ * него выполнится после этого чтения.
+ */
+
+#ifndef PRACTICE6_CL_RUNTIME_H
+#define PRACTICE6_CL_RUNTIME_H
+
+#include <stddef.h>
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#define CLRT_MAX_DEVICES 32
+#define CLRT_MAX_PROGRAMS 8
+#define CLRT_MAX_KERNELS 16
+#define CLRT_MAX_BUFFERS 32
+
+// Каталог кэша программ по умолчанию (PROGRAM_CACHE_DEFAULT_DIR): хостам
+// не нужно подключать cl_program_cache.h ради одной строки
+#define CLRT_DEFAULT_CACHE_DIR "kernel_cache"
+
+// Выбор устройства; пустой выбор (clrt_default_device) - GPU или любое
+typedef struct {
+    cl_device_type type;    // CL_DEVICE_TYPE_ALL - любой тип
+    char name[128];         // Подстрока имени; пустая - любое имя
+    int index;              // Номер в clrt_list_devices; -1 - любой
+} clrt_device_spec;
+
+typedef struct {
+    cl_program program;
+    unsigned long long hash;    // Хэш исходника и параметров сборки
+    int from_cache;             // Двоичный код взят из кэша программ
+} clrt_program;
+
+typedef struct {
+    cl_program program;
+    char name[64];
+    cl_kernel kernel;
+} clrt_kernel;
+
+typedef struct {
+    cl_mem buffer;
+    cl_mem_flags flags;
+    size_t size;
+    int in_use;
+} clrt_buffer;
+
+typedef struct {
+    cl_platform_id platform;
+    cl_device_id device;
+    int device_index;           // Номер устройства в clrt_list_devices
+    cl_context context;
+    cl_command_queue queue;
+    char platform_name[256];
+    char device_name[256];
+    const char* cache_dir;      // Каталог кэша программ (NULL - без него)
+
+    clrt_program programs[CLRT_MAX_PROGRAMS];
+    int program_count;
+    clrt_kernel kernels[CLRT_MAX_KERNELS];
+    int kernel_count;
+    clrt_buffer buffers[CLRT_MAX_BUFFERS];
+    int buffer_count;
+
+    int allocations;            // Вызовов clCreateBuffer из пула
+    int reuses;                 // Буферов, отданных из пула повторно
+} cl_runtime;
+
+// Задача пакета: vector_add - c = a + b на n элементов,
+// matrix_multiply - c[n x k] = a[n x m] * b[m x k]
+typedef enum {
+    CLRT_VECTOR_ADD,
+    CLRT_MATMUL
+} clrt_job_type;
+
+typedef struct {
+    clrt_job_type type;
+    const float* a;
+    const float* b;
+    float* c;
+    int n, m, k;
+} clrt_job;
+
+void clrt_default_device(clrt_device_spec* spec);
+
+// "gpu", "cpu", "accelerator", номер устройства или подстрока имени; 0 - успех
+int clrt_parse_device(const char* text, clrt_device_spec* spec);
+
+// Печатает устройства всех платформ с номерами для --device; число устройств
+int clrt_list_devices(void);
+
+// Все устройства всех платформ в порядке номеров --device и их платформы;
+// число устройств
+int clrt_enumerate_devices(cl_platform_id* platforms, cl_device_id* devices, int max);
+
+// Деление устройства на подустройства по units вычислительных блоков
+// (clCreateSubDevices, OpenCL 1.2+); число подустройств, 0 - не делится.
+// Подустройства освобождает вызывающий (clReleaseDevice)
+int clrt_sub_devices(cl_device_id device, int units, cl_device_id* sub_devices, int max);
+
+// Очередь с профилированием (clCreateCommandQueueWithProperties в OpenCL 2.0+)
+cl_command_queue clrt_create_queue(cl_context context, cl_device_id device, cl_int* err);
+
+// Исходник ядра из файла (malloc, с нулем в конце); NULL - ошибка
+char* clrt_read_source(const char* path, size_t* length);
+
+// Выбор устройства, контекст и очередь; 0 - успех
+int clrt_init(cl_runtime* rt, const clrt_device_spec* spec, const char* cache_dir);
+// То же на заданном устройстве или подустройстве (device_index = -1)
+int clrt_init_device(cl_runtime* rt, cl_platform_id platform, cl_device_id device,
+                     const char* cache_dir);
+void clrt_release(cl_runtime* rt);
+
+// Программа для исходника и параметров: собранная ранее или новая
+// (из кэша программ или исходника); NULL - ошибка
+cl_program clrt_build(cl_runtime* rt, const char* source, size_t length, const char* options,
+                      int* from_cache);
+
+// Ядро программы по имени: созданное ранее или новое; NULL - ошибка
+cl_kernel clrt_kernel_create(cl_runtime* rt, cl_program program, const char* name);
+
+// Ядро с именем из любой программы среды; NULL - не создано
+cl_kernel clrt_kernel_find(const cl_runtime* rt, const char* name);
+
+// Буфер не меньше size с флагами flags: свободный из пула или новый
+cl_mem clrt_buffer_acquire(cl_runtime* rt, cl_mem_flags flags, size_t size, cl_int* err);
+
+// Возврат буфера в пул (освобождается в clrt_release)
+void clrt_buffer_recycle(cl_runtime* rt, cl_mem buffer);
+
+// Пакет задач подряд в очереди среды; нужны ядра vector_add и/или
+// matrix_multiply (clrt_kernel_create). Возвращает CL_SUCCESS или ошибку
+cl_int clrt_run_batch(cl_runtime* rt, const clrt_job* jobs, int count);
+
+#endif // PRACTICE6_CL_RUNTIME_H
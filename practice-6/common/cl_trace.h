@@ -0,0 +1,176 @@
+/*
+ * Замер команд OpenCL по событиям профилирования для хостов практики 6.
+ *
+ * Таймер хоста вокруг clEnqueueNDRangeKernel + clFinish меряет еще и
+ * постановку в очередь, отправку драйверу и пробуждение потока, а
+ * передача данных, спрятанная в CL_MEM_COPY_HOST_PTR, не видна совсем.
+ * Здесь каждая команда (запись, ядро, чтение) ставится с событием, и
+ * по нему берутся четыре метки устройства (очередь должна быть создана
+ * с CL_QUEUE_PROFILING_ENABLE):
+ *   QUEUED - команда поставлена в очередь хостом
+ *   SUBMIT - драйвер отправил ее устройству
+ *   START  - устройство начало выполнение
+ *   END    - выполнение закончено
+ * QUEUED..START - накладные расходы очереди, START..END - сама работа.
+ *
+ * Все команды запуска собираются в таблицу и могут быть записаны как
+ * временная шкала в формате Chrome trace (chrome://tracing, Perfetto):
+ * дорожка "устройство" - выполнение, дорожка "очередь" - ожидание.
+ */
+
+#ifndef PRACTICE6_CL_TRACE_H
+#define PRACTICE6_CL_TRACE_H
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#define TRACE_MAX_COMMANDS 64
+
+// Одна команда: метки устройства в наносекундах
+typedef struct {
+    char name[48];
+    char category[16];      // "write", "kernel", "read"
+    cl_ulong queued;
+    cl_ulong submit;
+    cl_ulong start;
+    cl_ulong end;
+} trace_command;
+
+typedef struct {
+    trace_command commands[TRACE_MAX_COMMANDS];
+    int count;
+} cl_trace;
+
+static void trace_init(cl_trace* trace) {
+    trace->count = 0;
+}
+
+// Ждет завершения команды, сохраняет ее метки и освобождает событие;
+// возвращает время выполнения (START..END), сек, или -1, если меток нет
+static double trace_add(cl_trace* trace, const char* category, const char* name,
+                        cl_event event) {
+    trace_command command;
+    memset(&command, 0, sizeof(command));
+    snprintf(command.name, sizeof(command.name), "%s", name);
+    snprintf(command.category, sizeof(command.category), "%s", category);
+
+    clWaitForEvents(1, &event);
+    cl_int err = clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_QUEUED,
+                                         sizeof(cl_ulong), &command.queued, NULL);
+    err |= clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_SUBMIT,
+                                   sizeof(cl_ulong), &command.submit, NULL);
+    err |= clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START,
+                                   sizeof(cl_ulong), &command.start, NULL);
+    err |= clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END,
+                                   sizeof(cl_ulong), &command.end, NULL);
+    clReleaseEvent(event);
+    if (err != CL_SUCCESS || command.end < command.start) {
+        return -1.0;
+    }
+
+    if (trace->count < TRACE_MAX_COMMANDS) {
+        trace->commands[trace->count++] = command;
+    }
+    return (command.end - command.start) / 1e9;
+}
+
+// Начало шкалы - самая ранняя постановка в очередь
+static cl_ulong trace_origin(const cl_trace* trace) {
+    cl_ulong origin = 0;
+    for (int i = 0; i < trace->count; i++) {
+        if (i == 0 || trace->commands[i].queued < origin) {
+            origin = trace->commands[i].queued;
+        }
+    }
+    return origin;
+}
+
+// Текст, дополненный пробелами до width символов (не байт: имена
+// команд в UTF-8); left - выравнивание влево
+static void trace_print_cell(const char* text, int width, int left) {
+    int chars = 0;
+    for (const char* p = text; *p; p++) {
+        if ((*p & 0xC0) != 0x80) {
+            chars++;
+        }
+    }
+    if (left) {
+        printf("%s%*s", text, width > chars ? width - chars : 0, "");
+    } else {
+        printf("%*s%s", width > chars ? width - chars : 0, "", text);
+    }
+}
+
+// Таблица команд: метки в мс от первой команды, ожидание и выполнение
+static void trace_print(const cl_trace* trace) {
+    if (trace->count == 0) {
+        return;
+    }
+    cl_ulong origin = trace_origin(trace);
+    printf("=== Команды OpenCL (события профилирования, мс от первой команды) ===\n");
+    static const char* const columns[] = {"QUEUED", "SUBMIT", "START", "END", "ожидание",
+                                           "работа"};
+    printf("  ");
+    trace_print_cell("команда", 34, 1);
+    for (int col = 0; col < 6; col++) {
+        printf(" ");
+        trace_print_cell(columns[col], 10, 0);
+    }
+    printf("\n");
+    for (int i = 0; i < trace->count; i++) {
+        const trace_command* c = &trace->commands[i];
+        double wait = c->start > c->queued ? (c->start - c->queued) / 1e6 : 0.0;
+        printf("  ");
+        trace_print_cell(c->name, 34, 1);
+        printf(" %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+               (c->queued - origin) / 1e6, (c->submit - origin) / 1e6,
+               (c->start - origin) / 1e6, (c->end - origin) / 1e6, wait,
+               (c->end - c->start) / 1e6);
+    }
+    printf("\n");
+}
+
+// Временная шкала в формате Chrome trace (микросекунды); 0 - успех
+static int trace_write_chrome(const cl_trace* trace, const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Не удалось создать файл %s\n", path);
+        return -1;
+    }
+    cl_ulong origin = trace_origin(trace);
+    fprintf(file, "{\"traceEvents\": [\n");
+    fprintf(file, "  {\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, "
+                  "\"args\": {\"name\": \"OpenCL\"}},\n");
+    fprintf(file, "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, "
+                  "\"args\": {\"name\": \"устройство\"}},\n");
+    fprintf(file, "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, "
+                  "\"args\": {\"name\": \"очередь\"}}");
+    for (int i = 0; i < trace->count; i++) {
+        const trace_command* c = &trace->commands[i];
+        fprintf(file, ",\n  {\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, "
+                      "\"tid\": 1, \"ts\": %.3f, \"dur\": %.3f}",
+                c->name, c->category, (c->start - origin) / 1e3, (c->end - c->start) / 1e3);
+        if (c->start > c->queued) {
+            fprintf(file, ",\n  {\"name\": \"%s\", \"cat\": \"queue\", \"ph\": \"X\", "
+                          "\"pid\": 1, \"tid\": 2, \"ts\": %.3f, \"dur\": %.3f, "
+                          "\"args\": {\"submit_us\": %.3f}}",
+                    c->name, (c->queued - origin) / 1e3, (c->start - c->queued) / 1e3,
+                    (c->submit - origin) / 1e3);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Ошибка записи %s\n", path);
+        return -1;
+    }
+    printf("Временная шкала (Chrome trace): %s\n", path);
+    return 0;
+}
+
+#endif // PRACTICE6_CL_TRACE_H
@@ -0,0 +1,437 @@
+/*
+ * Слияние поэлементных операций: построение выражений, генерация ядер
+ * OpenCL и вычисление на CPU (OpenMP + SIMD). Описание - в elementwise.h.
+ */
+
+#include "elementwise.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "cl_program_cache.h"
+
+// Элементов в блоке CPU: промежуточные массивы всех узлов блока
+// (EW_MAX_NODES x 256 x 4 байта = 32 КБ) остаются в L1/L2
+#define EW_CPU_BLOCK 256
+
+static const char* const ew_names[] = {
+    "x", "s", "add", "sub", "mul", "div", "min", "max", "fma", "clamp"
+};
+
+// Число аргументов операции
+static int ew_arity(ew_op op) {
+    switch (op) {
+    case EW_INPUT:
+    case EW_SCALAR:
+        return 0;
+    case EW_FMA:
+    case EW_CLAMP:
+        return 3;
+    default:
+        return 2;
+    }
+}
+
+void ew_init(ew_expr* e) {
+    memset(e, 0, sizeof(*e));
+}
+
+static int ew_push(ew_expr* e, ew_op op, int index, int a, int b, int c) {
+    int args[3] = {a, b, c};
+    int arity = ew_arity(op);
+    int valid = !e->error && e->count < EW_MAX_NODES;
+    for (int i = 0; i < arity; i++) {
+        valid = valid && args[i] >= 0 && args[i] < e->count;
+    }
+    if (!valid) {
+        e->error = 1;
+        return -1;
+    }
+    ew_node* node = &e->nodes[e->count];
+    node->op = op;
+    node->index = index;
+    memcpy(node->arg, args, sizeof(args));
+    return e->count++;
+}
+
+int ew_input(ew_expr* e, int index) {
+    if (index < 0 || index >= EW_MAX_INPUTS) {
+        e->error = 1;
+        return -1;
+    }
+    if (index + 1 > e->inputs) {
+        e->inputs = index + 1;
+    }
+    return ew_push(e, EW_INPUT, index, -1, -1, -1);
+}
+
+int ew_scalar(ew_expr* e, int index) {
+    if (index < 0 || index >= EW_MAX_SCALARS) {
+        e->error = 1;
+        return -1;
+    }
+    if (index + 1 > e->scalars) {
+        e->scalars = index + 1;
+    }
+    return ew_push(e, EW_SCALAR, index, -1, -1, -1);
+}
+
+int ew_add(ew_expr* e, int a, int b) { return ew_push(e, EW_ADD, 0, a, b, -1); }
+int ew_sub(ew_expr* e, int a, int b) { return ew_push(e, EW_SUB, 0, a, b, -1); }
+int ew_mul(ew_expr* e, int a, int b) { return ew_push(e, EW_MUL, 0, a, b, -1); }
+int ew_div(ew_expr* e, int a, int b) { return ew_push(e, EW_DIV, 0, a, b, -1); }
+int ew_min(ew_expr* e, int a, int b) { return ew_push(e, EW_MIN, 0, a, b, -1); }
+int ew_max(ew_expr* e, int a, int b) { return ew_push(e, EW_MAX, 0, a, b, -1); }
+int ew_fma(ew_expr* e, int a, int b, int c) { return ew_push(e, EW_FMA, 0, a, b, c); }
+int ew_clamp(ew_expr* e, int x, int lo, int hi) { return ew_push(e, EW_CLAMP, 0, x, lo, hi); }
+
+// Дописывание в буфер text[size] с позиции *used; при нехватке места
+// *used становится больше size
+static void ew_append(char* text, size_t size, size_t* used, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(*used < size ? text + *used : NULL,
+                            *used < size ? size - *used : 0, format, args);
+    va_end(args);
+    *used += written > 0 ? (size_t)written : 0;
+}
+
+static void ew_signature_node(const ew_expr* e, int k, char* text, size_t size, size_t* used) {
+    const ew_node* node = &e->nodes[k];
+    if (node->op == EW_INPUT || node->op == EW_SCALAR) {
+        ew_append(text, size, used, "%s%d", ew_names[node->op], node->index);
+        return;
+    }
+    ew_append(text, size, used, "%s(", ew_names[node->op]);
+    for (int i = 0; i < ew_arity(node->op); i++) {
+        ew_append(text, size, used, i > 0 ? "," : "");
+        ew_signature_node(e, node->arg[i], text, size, used);
+    }
+    ew_append(text, size, used, ")");
+}
+
+int ew_signature(const ew_expr* e, char* text, size_t size) {
+    if (e->error || e->count == 0 || size == 0) {
+        return -1;
+    }
+    size_t used = 0;
+    text[0] = '\0';
+    ew_append(text, size, &used, "x%d s%d ", e->inputs, e->scalars);
+    ew_signature_node(e, e->count - 1, text, size, &used);
+    return used < size ? 0 : -1;
+}
+
+// ========================================
+// CPU: блоки по EW_CPU_BLOCK, операции - циклы SIMD
+// ========================================
+
+void ew_eval_cpu(const ew_expr* e, const float* const* inputs, const float* scalars,
+                 float* out, size_t n) {
+    if (e->error || e->count == 0) {
+        return;
+    }
+    long long blocks = (long long)((n + EW_CPU_BLOCK - 1) / EW_CPU_BLOCK);
+    int last = e->count - 1;
+
+    #pragma omp parallel
+    {
+        // Промежуточные значения узлов блока; входы читаются на месте
+        float* temp = NULL;
+        if (posix_memalign((void**)&temp, 64, (size_t)e->count * EW_CPU_BLOCK * sizeof(float))
+            != 0) {
+            abort();
+        }
+        const float* values[EW_MAX_NODES];
+
+        #pragma omp for schedule(static)
+        for (long long block = 0; block < blocks; block++) {
+            size_t start = (size_t)block * EW_CPU_BLOCK;
+            int length = (int)(n - start < EW_CPU_BLOCK ? n - start : EW_CPU_BLOCK);
+
+            for (int k = 0; k < e->count; k++) {
+                const ew_node* node = &e->nodes[k];
+                float* dst = k == last ? out + start : temp + (size_t)k * EW_CPU_BLOCK;
+                const float* a = node->arg[0] >= 0 ? values[node->arg[0]] : NULL;
+                const float* b = node->arg[1] >= 0 ? values[node->arg[1]] : NULL;
+                const float* c = node->arg[2] >= 0 ? values[node->arg[2]] : NULL;
+
+                switch (node->op) {
+                case EW_INPUT:
+                    if (k != last) {
+                        values[k] = inputs[node->index] + start;
+                        continue;
+                    }
+                    memcpy(dst, inputs[node->index] + start, length * sizeof(float));
+                    break;
+                case EW_SCALAR: {
+                    float s = scalars[node->index];
+                    #pragma omp simd
+                    for (int i = 0; i < length; i++) {
+                        dst[i] = s;
+                    }
+                    break;
+                }
+                case EW_ADD:
+                    #pragma omp simd
+                    for (int i = 0; i < length; i++) {
+                        dst[i] = a[i] + b[i];
+                    }
+                    break;
+                case EW_SUB:
+                    #pragma omp simd
+                    for (int i = 0; i < length; i++) {
+                        dst[i] = a[i] - b[i];
+                    }
+                    break;
+                case EW_MUL:
+                    #pragma omp simd
+                    for (int i = 0; i < length; i++) {
+                        dst[i] = a[i] * b[i];
+                    }
+                    break;
+                case EW_DIV:
+                    #pragma omp simd
+                    for (int i = 0; i < length; i++) {
+                        dst[i] = a[i] / b[i];
+                    }
+                    break;
+                case EW_MIN:
+                    #pragma omp simd
+                    for (int i = 0; i < length; i++) {
+                        dst[i] = b[i] < a[i] ? b[i] : a[i];
+                    }
+                    break;
+                case EW_MAX:
+                    #pragma omp simd
+                    for (int i = 0; i < length; i++) {
+                        dst[i] = a[i] < b[i] ? b[i] : a[i];
+                    }
+                    break;
+                case EW_FMA:
+                    // Без -mfma это умножение и сложение с двумя округлениями:
+                    // с ядром OpenCL результат совпадает до последнего бита
+                    // не всегда
+                    #pragma omp simd
+                    for (int i = 0; i < length; i++) {
+                        dst[i] = a[i] * b[i] + c[i];
+                    }
+                    break;
+                case EW_CLAMP:
+                    #pragma omp simd
+                    for (int i = 0; i < length; i++) {
+                        float t = a[i] < b[i] ? b[i] : a[i];
+                        dst[i] = c[i] < t ? c[i] : t;
+                    }
+                    break;
+                }
+                values[k] = dst;
+            }
+        }
+        free(temp);
+    }
+}
+
+// ========================================
+// OpenCL: генерация и кэш ядер
+// ========================================
+
+// Выражение узла k для типа type ("float4" или "float")
+static void ew_cl_node(const ew_node* node, const char* type, char* text, size_t size,
+                       size_t* used) {
+    int a = node->arg[0], b = node->arg[1], c = node->arg[2];
+    switch (node->op) {
+    case EW_ADD:   ew_append(text, size, used, "t%d + t%d", a, b); break;
+    case EW_SUB:   ew_append(text, size, used, "t%d - t%d", a, b); break;
+    case EW_MUL:   ew_append(text, size, used, "t%d * t%d", a, b); break;
+    case EW_DIV:   ew_append(text, size, used, "t%d / t%d", a, b); break;
+    case EW_MIN:   ew_append(text, size, used, "fmin(t%d, t%d)", a, b); break;
+    case EW_MAX:   ew_append(text, size, used, "fmax(t%d, t%d)", a, b); break;
+    case EW_FMA:   ew_append(text, size, used, "fma(t%d, t%d, t%d)", a, b, c); break;
+    case EW_CLAMP: ew_append(text, size, used, "fmin(fmax(t%d, t%d), t%d)", a, b, c); break;
+    case EW_SCALAR:
+        // Скаляр расширяется до вектора: fma и fmin требуют одинаковых типов
+        ew_append(text, size, used, "(%s)(s%d)", type, node->index);
+        break;
+    case EW_INPUT:
+        break;
+    }
+}
+
+// Тело вычисления: t0..tK по узлам, загрузка входов через load
+// ("vload4(v, x%d)" или "x%d[i]"), результат - через store
+static void ew_cl_body(const ew_expr* e, const char* type, const char* load,
+                       const char* store, const char* indent, char* text, size_t size,
+                       size_t* used) {
+    for (int k = 0; k < e->count; k++) {
+        const ew_node* node = &e->nodes[k];
+        ew_append(text, size, used, "%sconst %s t%d = ", indent, type, k);
+        if (node->op == EW_INPUT) {
+            ew_append(text, size, used, load, node->index);
+        } else {
+            ew_cl_node(node, type, text, size, used);
+        }
+        ew_append(text, size, used, ";\n");
+    }
+    ew_append(text, size, used, store, indent, e->count - 1);
+}
+
+int ew_cl_source(const ew_expr* e, int width, int ept, char* source, size_t size) {
+    char signature[EW_MAX_SIGNATURE];
+    if (ew_signature(e, signature, sizeof(signature)) != 0 || ept < 1
+        || (width != 1 && width != 2 && width != 4 && width != 8 && width != 16)) {
+        return -1;
+    }
+    char type[16];
+    char load[32];
+    char store[48];
+    if (width == 1) {
+        snprintf(type, sizeof(type), "float");
+        snprintf(load, sizeof(load), "x%%d[v]");
+        snprintf(store, sizeof(store), "%%sout[v] = t%%d;\n");
+    } else {
+        snprintf(type, sizeof(type), "float%d", width);
+        snprintf(load, sizeof(load), "vload%d(v, x%%d)", width);
+        snprintf(store, sizeof(store), "%%svstore%d(t%%d, v, out);\n", width);
+    }
+
+    size_t used = 0;
+    ew_append(source, size, &used, "// %s: %s, %d на рабочий элемент\n", signature, type, ept);
+    ew_append(source, size, &used, "__kernel void ew_fused(__global float* out");
+    for (int i = 0; i < e->inputs; i++) {
+        ew_append(source, size, &used, ", __global const float* x%d", i);
+    }
+    for (int i = 0; i < e->scalars; i++) {
+        ew_append(source, size, &used, ", const float s%d", i);
+    }
+    ew_append(source, size, &used, ", const int n) {\n");
+
+    // Векторы: рабочий элемент берет ept векторов с шагом в глобальный
+    // размер, так соседние элементы читают соседние адреса
+    ew_append(source, size, &used,
+              "    const int vectors = n / %d;\n"
+              "    const int stride = get_global_size(0);\n"
+              "    for (int k = 0; k < %d; k++) {\n"
+              "        const int v = get_global_id(0) + k * stride;\n"
+              "        if (v >= vectors) {\n"
+              "            break;\n"
+              "        }\n", width, ept);
+    ew_cl_body(e, type, load, store, "        ", source, size, &used);
+    ew_append(source, size, &used, "    }\n");
+
+    // Хвост, не кратный ширине вектора, - поэлементно
+    if (width > 1) {
+        ew_append(source, size, &used,
+                  "    const int v = vectors * %d + get_global_id(0);\n"
+                  "    if (v < n) {\n", width);
+        ew_cl_body(e, "float", "x%d[v]", "%sout[v] = t%d;\n", "        ", source, size, &used);
+        ew_append(source, size, &used, "    }\n");
+    }
+    ew_append(source, size, &used, "}\n");
+    return used < size ? 0 : -1;
+}
+
+void ew_cl_init(ew_cl_cache* cache, cl_context context, cl_device_id device,
+                const char* cache_dir) {
+    memset(cache, 0, sizeof(*cache));
+    cache->context = context;
+    cache->device = device;
+    cache->cache_dir = cache_dir;
+}
+
+void ew_cl_release(ew_cl_cache* cache) {
+    for (int i = 0; i < cache->count; i++) {
+        clReleaseKernel(cache->entries[i].kernel);
+        clReleaseProgram(cache->entries[i].program);
+    }
+    cache->count = 0;
+}
+
+cl_kernel ew_cl_kernel(ew_cl_cache* cache, const ew_expr* e, int width, int ept) {
+    char signature[EW_MAX_SIGNATURE];
+    if (ew_signature(e, signature, sizeof(signature)) != 0) {
+        return NULL;
+    }
+    for (int i = 0; i < cache->count; i++) {
+        ew_cl_entry* entry = &cache->entries[i];
+        if (entry->width == width && entry->ept == ept
+            && strcmp(entry->signature, signature) == 0) {
+            return entry->kernel;
+        }
+    }
+    if (cache->count == EW_MAX_KERNELS) {
+        fprintf(stderr, "Кэш ядер выражений заполнен (%d)\n", EW_MAX_KERNELS);
+        return NULL;
+    }
+
+    size_t size = 16384;
+    char* source = (char*)malloc(size);
+    if (!source || ew_cl_source(e, width, ept, source, size) != 0) {
+        free(source);
+        return NULL;
+    }
+    int from_cache = 0;
+    cl_program program = program_cache_build(cache->context, cache->device, source,
+                                             strlen(source), NULL, cache->cache_dir,
+                                             &from_cache);
+    free(source);
+    if (!program) {
+        return NULL;
+    }
+    cl_int err;
+    cl_kernel kernel = clCreateKernel(program, "ew_fused", &err);
+    if (err != CL_SUCCESS) {
+        clReleaseProgram(program);
+        return NULL;
+    }
+
+    ew_cl_entry* entry = &cache->entries[cache->count++];
+    snprintf(entry->signature, sizeof(entry->signature), "%s", signature);
+    entry->width = width;
+    entry->ept = ept;
+    entry->program = program;
+    entry->kernel = kernel;
+    cache->builds++;
+    return kernel;
+}
+
+cl_int ew_cl_run(ew_cl_cache* cache, cl_command_queue queue, const ew_expr* e, int width,
+                 int ept, cl_mem out, const cl_mem* inputs, const float* scalars, int n,
+                 cl_event* event) {
+    cl_kernel kernel = ew_cl_kernel(cache, e, width, ept);
+    if (!kernel) {
+        return CL_INVALID_KERNEL;
+    }
+    // Аргументы: out, входы, скаляры, n - в порядке генерации ядра
+    cl_uint arg = 0;
+    cl_int err = clSetKernelArg(kernel, arg++, sizeof(cl_mem), &out);
+    for (int i = 0; i < e->inputs && err == CL_SUCCESS; i++) {
+        err = clSetKernelArg(kernel, arg++, sizeof(cl_mem), &inputs[i]);
+    }
+    for (int i = 0; i < e->scalars && err == CL_SUCCESS; i++) {
+        err = clSetKernelArg(kernel, arg++, sizeof(float), &scalars[i]);
+    }
+    if (err == CL_SUCCESS) {
+        err = clSetKernelArg(kernel, arg++, sizeof(int), &n);
+    }
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    // Рабочих элементов - на все векторы по ept и не меньше хвоста
+    size_t vectors = (size_t)n / width;
+    size_t global_size = (vectors + ept - 1) / ept;
+    size_t tail = (size_t)n - vectors * width;
+    if (global_size < tail) {
+        global_size = tail;
+    }
+    if (global_size == 0) {
+        global_size = 1;
+    }
+    return clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_size, NULL, 0, NULL, event);
+}
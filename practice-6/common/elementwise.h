@@ -0,0 +1,135 @@
+/*
+ * Слияние поэлементных операций в одно ядро для практики 6.
+ *
+ * Цепочка вроде axpy -> clamp -> scale отдельными ядрами проходит по
+ * памяти столько раз, сколько в ней операций: каждое ядро читает
+ * промежуточный массив и пишет следующий. Здесь цепочка описывается
+ * выражением (дерево узлов: входные массивы x0..x7, скаляры s0..s7,
+ * операции), и из него генерируется одно ядро OpenCL, которое читает
+ * входы и пишет результат ровно один раз:
+ *   - векторные загрузки floatW (W = 1, 2, 4, 8, 16) через vloadW
+ *   - EPT векторов на рабочий элемент с шагом в глобальный размер
+ *     (соседние рабочие элементы читают соседние векторы)
+ *   - хвост, не кратный W, считается поэлементно
+ * Скаляры передаются аргументами ядра, поэтому ядро зависит только от
+ * формы выражения. Сгенерированные ядра кэшируются по сигнатуре
+ * (каноническая запись выражения + W + EPT) в процессе и, через
+ * cl_program_cache.h, на диске.
+ *
+ * То же выражение считается на CPU (ew_eval_cpu): блоками, которые
+ * помещаются в L1, каждая операция - цикл #pragma omp simd, блоки
+ * делятся между потоками OpenMP. Промежуточные значения живут только в
+ * кэше, проход по памяти - тоже один.
+ *
+ * Пример: out = clamp(s0 * x0 + x1, s1, s2)
+ *   ew_expr e;
+ *   ew_init(&e);
+ *   int axpy = ew_fma(&e, ew_scalar(&e, 0), ew_input(&e, 0), ew_input(&e, 1));
+ *   ew_clamp(&e, axpy, ew_scalar(&e, 1), ew_scalar(&e, 2));
+ */
+
+#ifndef PRACTICE6_ELEMENTWISE_H
+#define PRACTICE6_ELEMENTWISE_H
+
+#include <stddef.h>
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#define EW_MAX_NODES 32
+#define EW_MAX_INPUTS 8
+#define EW_MAX_SCALARS 8
+#define EW_MAX_SIGNATURE 512
+#define EW_MAX_KERNELS 16
+
+typedef enum {
+    EW_INPUT,       // Входной массив x[index]
+    EW_SCALAR,      // Скаляр s[index]
+    EW_ADD,
+    EW_SUB,
+    EW_MUL,
+    EW_DIV,
+    EW_MIN,
+    EW_MAX,
+    EW_FMA,         // a * b + c
+    EW_CLAMP        // min(max(x, lo), hi)
+} ew_op;
+
+typedef struct {
+    ew_op op;
+    int arg[3];
+    int index;
+} ew_node;
+
+// Выражение: узлы в порядке построения (аргументы всегда раньше узла),
+// результат - последний узел. Построители возвращают номер узла или -1;
+// после ошибки выражение помечается error и не запускается
+typedef struct {
+    ew_node nodes[EW_MAX_NODES];
+    int count;
+    int inputs;     // Число входных массивов (наибольший индекс + 1)
+    int scalars;
+    int error;
+} ew_expr;
+
+void ew_init(ew_expr* e);
+int ew_input(ew_expr* e, int index);
+int ew_scalar(ew_expr* e, int index);
+int ew_add(ew_expr* e, int a, int b);
+int ew_sub(ew_expr* e, int a, int b);
+int ew_mul(ew_expr* e, int a, int b);
+int ew_div(ew_expr* e, int a, int b);
+int ew_min(ew_expr* e, int a, int b);
+int ew_max(ew_expr* e, int a, int b);
+int ew_fma(ew_expr* e, int a, int b, int c);
+int ew_clamp(ew_expr* e, int x, int lo, int hi);
+
+// Каноническая запись с числом входов и скаляров (они задают аргументы
+// ядра, даже если часть не используется), например
+// "x2 s3 clamp(fma(s0,x0,x1),s1,s2)"; 0 - успех
+int ew_signature(const ew_expr* e, char* text, size_t size);
+
+// CPU: out[i] = выражение от inputs[k][i] и scalars, i < n
+void ew_eval_cpu(const ew_expr* e, const float* const* inputs, const float* scalars,
+                 float* out, size_t n);
+
+// Исходник ядра ew_fused для выражения; 0 - успех
+int ew_cl_source(const ew_expr* e, int width, int ept, char* source, size_t size);
+
+// Собранное ядро и его ключ
+typedef struct {
+    char signature[EW_MAX_SIGNATURE];
+    int width;
+    int ept;
+    cl_program program;
+    cl_kernel kernel;
+} ew_cl_entry;
+
+// Кэш ядер для контекста и устройства; cache_dir - каталог двоичного
+// кэша программ (NULL - без него)
+typedef struct {
+    cl_context context;
+    cl_device_id device;
+    const char* cache_dir;
+    ew_cl_entry entries[EW_MAX_KERNELS];
+    int count;
+    int builds;     // Сколько ядер сгенерировано и собрано
+} ew_cl_cache;
+
+void ew_cl_init(ew_cl_cache* cache, cl_context context, cl_device_id device,
+                const char* cache_dir);
+void ew_cl_release(ew_cl_cache* cache);
+
+// Ядро для выражения: из кэша или сгенерированное и собранное; NULL - ошибка
+cl_kernel ew_cl_kernel(ew_cl_cache* cache, const ew_expr* e, int width, int ept);
+
+// Запуск: out = выражение от inputs и scalars на n элементов
+// (out может совпадать с одним из входов); event - событие или NULL
+cl_int ew_cl_run(ew_cl_cache* cache, cl_command_queue queue, const ew_expr* e, int width,
+                 int ept, cl_mem out, const cl_mem* inputs, const float* scalars, int n,
+                 cl_event* event);
+
+#endif // PRACTICE6_ELEMENTWISE_H
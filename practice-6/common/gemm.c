@@ -0,0 +1,326 @@
+/*
+ * Блочное умножение матриц на CPU: упаковка, блоки по кэшам,
+ * микроядро AVX2/FMA и OpenMP по макроплиткам; пакеты малых умножений.
+ * Описание - в gemm.h.
+ */
+
+#include "gemm.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define GEMM_X86 1
+#include <immintrin.h>
+#endif
+
+// Микроядро: c[MR x NR] (шаг строк ldc) = или += a * b, где a - полоса A
+// (kc столбцов по MR), b - полоса B (kc строк по NR)
+typedef void (*gemm_kernel)(int kc, const float* a, const float* b,
+                            float* c, int ldc, int accumulate);
+
+static void gemm_kernel_generic(int kc, const float* a, const float* b,
+                                float* c, int ldc, int accumulate) {
+    float acc[GEMM_MR][GEMM_NR] = {{0}};
+    for (int p = 0; p < kc; p++) {
+        for (int i = 0; i < GEMM_MR; i++) {
+            float ai = a[p * GEMM_MR + i];
+            // Без подсказки GCC разворачивает цикл целиком и не векторизует
+            #pragma omp simd
+            for (int j = 0; j < GEMM_NR; j++) {
+                acc[i][j] += ai * b[p * GEMM_NR + j];
+            }
+        }
+    }
+    for (int i = 0; i < GEMM_MR; i++) {
+        for (int j = 0; j < GEMM_NR; j++) {
+            c[i * ldc + j] = accumulate ? c[i * ldc + j] + acc[i][j] : acc[i][j];
+        }
+    }
+}
+
+#ifdef GEMM_X86
+// 6 строк x 2 вектора по 8: 12 аккумуляторов + 2 строки B + broadcast A
+__attribute__((target("avx2,fma")))
+static void gemm_kernel_avx2(int kc, const float* a, const float* b,
+                             float* c, int ldc, int accumulate) {
+    __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+    __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+    __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+    __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+    __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+    __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+
+    for (int p = 0; p < kc; p++) {
+        __m256 b0 = _mm256_load_ps(b);
+        __m256 b1 = _mm256_load_ps(b + 8);
+        __m256 ai;
+        ai = _mm256_broadcast_ss(a + 0);
+        c00 = _mm256_fmadd_ps(ai, b0, c00);
+        c01 = _mm256_fmadd_ps(ai, b1, c01);
+        ai = _mm256_broadcast_ss(a + 1);
+        c10 = _mm256_fmadd_ps(ai, b0, c10);
+        c11 = _mm256_fmadd_ps(ai, b1, c11);
+        ai = _mm256_broadcast_ss(a + 2);
+        c20 = _mm256_fmadd_ps(ai, b0, c20);
+        c21 = _mm256_fmadd_ps(ai, b1, c21);
+        ai = _mm256_broadcast_ss(a + 3);
+        c30 = _mm256_fmadd_ps(ai, b0, c30);
+        c31 = _mm256_fmadd_ps(ai, b1, c31);
+        ai = _mm256_broadcast_ss(a + 4);
+        c40 = _mm256_fmadd_ps(ai, b0, c40);
+        c41 = _mm256_fmadd_ps(ai, b1, c41);
+        ai = _mm256_broadcast_ss(a + 5);
+        c50 = _mm256_fmadd_ps(ai, b0, c50);
+        c51 = _mm256_fmadd_ps(ai, b1, c51);
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+
+    __m256 rows[GEMM_MR][2] = {
+        {c00, c01}, {c10, c11}, {c20, c21}, {c30, c31}, {c40, c41}, {c50, c51}
+    };
+    for (int i = 0; i < GEMM_MR; i++) {
+        float* row = c + (size_t)i * ldc;
+        if (accumulate) {
+            rows[i][0] = _mm256_add_ps(rows[i][0], _mm256_loadu_ps(row));
+            rows[i][1] = _mm256_add_ps(rows[i][1], _mm256_loadu_ps(row + 8));
+        }
+        _mm256_storeu_ps(row, rows[i][0]);
+        _mm256_storeu_ps(row + 8, rows[i][1]);
+    }
+}
+#endif
+
+static gemm_kernel gemm_select_kernel(void) {
+#ifdef GEMM_X86
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return gemm_kernel_avx2;
+    }
+#endif
+    return gemm_kernel_generic;
+}
+
+const char* gemm_kernel_name(void) {
+    return gemm_select_kernel() == gemm_kernel_generic ? "generic 6x16" : "avx2-fma 6x16";
+}
+
+static float* gemm_alloc(size_t count) {
+    void* p = NULL;
+    if (posix_memalign(&p, 64, count * sizeof(float)) != 0) {
+        return NULL;
+    }
+    return (float*)p;
+}
+
+// Полоса B: kc строк x nr (<= NR) столбцов, начиная с B[0][0];
+// недостающие столбцы - нули
+static void gemm_pack_b(const float* B, int ldb, int kc, int nr, float* packed) {
+    for (int p = 0; p < kc; p++) {
+        const float* row = B + (size_t)p * ldb;
+        for (int j = 0; j < nr; j++) {
+            packed[j] = row[j];
+        }
+        for (int j = nr; j < GEMM_NR; j++) {
+            packed[j] = 0.0f;
+        }
+        packed += GEMM_NR;
+    }
+}
+
+// Блок A: mc строк x kc столбцов, полосами по MR строк (столбец полосы
+// подряд); недостающие строки последней полосы - нули
+static void gemm_pack_a(const float* A, int lda, int mc, int kc, float* packed) {
+    for (int ir = 0; ir < mc; ir += GEMM_MR) {
+        int mr = mc - ir < GEMM_MR ? mc - ir : GEMM_MR;
+        for (int p = 0; p < kc; p++) {
+            for (int i = 0; i < mr; i++) {
+                packed[i] = A[(size_t)(ir + i) * lda + p];
+            }
+            for (int i = mr; i < GEMM_MR; i++) {
+                packed[i] = 0.0f;
+            }
+            packed += GEMM_MR;
+        }
+    }
+}
+
+// Макроплитка C[mc x nc] по упакованным блокам A и B
+static void gemm_macro_kernel(gemm_kernel kernel, int mc, int nc, int kc,
+                              const float* packed_a, const float* packed_b,
+                              float* C, int ldc, int accumulate) {
+    float edge[GEMM_MR * GEMM_NR];
+    for (int jr = 0; jr < nc; jr += GEMM_NR) {
+        int nr = nc - jr < GEMM_NR ? nc - jr : GEMM_NR;
+        const float* b = packed_b + (size_t)jr * kc;
+        for (int ir = 0; ir < mc; ir += GEMM_MR) {
+            int mr = mc - ir < GEMM_MR ? mc - ir : GEMM_MR;
+            const float* a = packed_a + (size_t)ir * kc;
+            float* c = C + (size_t)ir * ldc + jr;
+            if (mr == GEMM_MR && nr == GEMM_NR) {
+                kernel(kc, a, b, c, ldc, accumulate);
+                continue;
+            }
+            // Край матрицы: плитка во временный буфер, в C - только ее часть
+            kernel(kc, a, b, edge, GEMM_NR, 0);
+            for (int i = 0; i < mr; i++) {
+                for (int j = 0; j < nr; j++) {
+                    float value = edge[i * GEMM_NR + j];
+                    c[(size_t)i * ldc + j] = accumulate ? c[(size_t)i * ldc + j] + value : value;
+                }
+            }
+        }
+    }
+}
+
+void gemm_multiply(const float* A, const float* B, float* C, int n, int m, int k) {
+    if (n <= 0 || k <= 0) {
+        return;
+    }
+    if (m <= 0) {
+        memset(C, 0, (size_t)n * k * sizeof(float));
+        return;
+    }
+    gemm_kernel kernel = gemm_select_kernel();
+
+    // Блоков строк должно хватить на все потоки: при малом n уменьшаем MC
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    int mc = (n + threads - 1) / threads;
+    mc = (mc + GEMM_MR - 1) / GEMM_MR * GEMM_MR;
+    if (mc > GEMM_MC) {
+        mc = GEMM_MC;
+    }
+
+    float* packed_b = gemm_alloc((size_t)GEMM_KC * GEMM_NC);
+    if (!packed_b) {
+        abort();
+    }
+
+    #pragma omp parallel
+    {
+        float* packed_a = gemm_alloc((size_t)mc * GEMM_KC);
+        if (!packed_a) {
+            abort();
+        }
+
+        for (int jc = 0; jc < k; jc += GEMM_NC) {
+            int nc = k - jc < GEMM_NC ? k - jc : GEMM_NC;
+            for (int pc = 0; pc < m; pc += GEMM_KC) {
+                int kc = m - pc < GEMM_KC ? m - pc : GEMM_KC;
+
+                // Блок B упаковывают все потоки вместе (неявный барьер в конце)
+                #pragma omp for schedule(static)
+                for (int jr = 0; jr < nc; jr += GEMM_NR) {
+                    int nr = nc - jr < GEMM_NR ? nc - jr : GEMM_NR;
+                    gemm_pack_b(B + (size_t)pc * k + jc + jr, k, kc, nr,
+                                packed_b + (size_t)jr * kc);
+                }
+
+                // Макроплитки по строкам - каждому потоку свой блок A;
+                // статическое разбиение отдает потоку те же строки A и C
+                // на каждом проходе (и те, что он записал при first touch);
+                // барьер в конце не дает перепаковать B раньше времени
+                #pragma omp for schedule(static)
+                for (int ic = 0; ic < n; ic += mc) {
+                    int rows = n - ic < mc ? n - ic : mc;
+                    gemm_pack_a(A + (size_t)ic * m + pc, m, rows, kc, packed_a);
+                    gemm_macro_kernel(kernel, rows, nc, kc, packed_a, packed_b,
+                                      C + (size_t)ic * k + jc, k, pc > 0);
+                }
+            }
+        }
+        free(packed_a);
+    }
+    free(packed_b);
+}
+
+// Одно умножение в одном потоке теми же блоками, упаковкой и микроядром;
+// буферы упаковки - вызывающего, на kc_max x nc_max (B) и
+// mc_max x kc_max (A). Малая матрица - одна упаковка A и B и одна
+// макроплитка
+static void gemm_single(gemm_kernel kernel, const float* A, const float* B, float* C,
+                        int n, int m, int k, float* packed_a, float* packed_b) {
+    if (m <= 0) {
+        memset(C, 0, (size_t)n * k * sizeof(float));
+        return;
+    }
+    for (int jc = 0; jc < k; jc += GEMM_NC) {
+        int nc = k - jc < GEMM_NC ? k - jc : GEMM_NC;
+        for (int pc = 0; pc < m; pc += GEMM_KC) {
+            int kc = m - pc < GEMM_KC ? m - pc : GEMM_KC;
+            for (int jr = 0; jr < nc; jr += GEMM_NR) {
+                int nr = nc - jr < GEMM_NR ? nc - jr : GEMM_NR;
+                gemm_pack_b(B + (size_t)pc * k + jc + jr, k, kc, nr,
+                            packed_b + (size_t)jr * kc);
+            }
+            for (int ic = 0; ic < n; ic += GEMM_MC) {
+                int rows = n - ic < GEMM_MC ? n - ic : GEMM_MC;
+                gemm_pack_a(A + (size_t)ic * m + pc, m, rows, kc, packed_a);
+                gemm_macro_kernel(kernel, rows, nc, kc, packed_a, packed_b,
+                                  C + (size_t)ic * k + jc, k, pc > 0);
+            }
+        }
+    }
+}
+
+// Буферы упаковки одного потока под матрицы пакета: не больше блоков
+static void gemm_batch_buffers(int n, int m, int k, float** packed_a, float** packed_b) {
+    size_t mc = n < GEMM_MC ? (size_t)(n + GEMM_MR - 1) / GEMM_MR * GEMM_MR : GEMM_MC;
+    size_t kc = m < GEMM_KC ? (size_t)(m > 0 ? m : 1) : GEMM_KC;
+    size_t nc = k < GEMM_NC ? (size_t)(k + GEMM_NR - 1) / GEMM_NR * GEMM_NR : GEMM_NC;
+    *packed_a = gemm_alloc(mc * kc);
+    *packed_b = gemm_alloc(kc * nc);
+    if (!*packed_a || !*packed_b) {
+        abort();
+    }
+}
+
+void gemm_batched_strided(const float* A, size_t stride_a, const float* B, size_t stride_b,
+                          float* C, size_t stride_c, int n, int m, int k, int count) {
+    if (n <= 0 || k <= 0) {
+        return;
+    }
+    gemm_kernel kernel = gemm_select_kernel();
+
+    #pragma omp parallel
+    {
+        float* packed_a;
+        float* packed_b;
+        gemm_batch_buffers(n, m, k, &packed_a, &packed_b);
+        #pragma omp for schedule(static)
+        for (int i = 0; i < count; i++) {
+            gemm_single(kernel, A + i * stride_a, B + i * stride_b, C + i * stride_c,
+                        n, m, k, packed_a, packed_b);
+        }
+        free(packed_a);
+        free(packed_b);
+    }
+}
+
+void gemm_batched(const float* const* A, const float* const* B, float* const* C,
+                  int n, int m, int k, int count) {
+    if (n <= 0 || k <= 0) {
+        return;
+    }
+    gemm_kernel kernel = gemm_select_kernel();
+
+    #pragma omp parallel
+    {
+        float* packed_a;
+        float* packed_b;
+        gemm_batch_buffers(n, m, k, &packed_a, &packed_b);
+        #pragma omp for schedule(static)
+        for (int i = 0; i < count; i++) {
+            gemm_single(kernel, A[i], B[i], C[i], n, m, k, packed_a, packed_b);
+        }
+        free(packed_a);
+        free(packed_b);
+    }
+}
@@ -0,0 +1,56 @@
+/*
+ * Оптимизированное умножение матриц на CPU (SGEMM) для практики 6.
+ *
+ * C[n x k] = A[n x m] * B[m x k], все матрицы хранятся по строкам,
+ * размеры произвольные. Схема - как в BLIS/GotoBLAS:
+ *   - блок B (GEMM_KC x GEMM_NC) упаковывается в полосы по GEMM_NR
+ *     столбцов и живет в L3
+ *   - блок A (GEMM_MC x GEMM_KC) каждый поток упаковывает в полосы
+ *     по GEMM_MR строк, он живет в L2
+ *   - микроядро считает плитку C GEMM_MR x GEMM_NR в регистрах, полоса
+ *     B (GEMM_KC x GEMM_NR) при этом лежит в L1
+ *   - макроплитки GEMM_MC x GEMM_NC делятся между потоками OpenMP
+ *
+ * Микроядро 6x16 на AVX2/FMA (12 аккумуляторов ymm) выбирается во время
+ * выполнения по CPUID, иначе - переносимое ядро на C, которое
+ * векторизует компилятор. Реализация в gemm.c, она собирается с -O3
+ * отдельно от программы (та собирается с -O0 ради честного базового
+ * времени наивной версии).
+ */
+
+#ifndef PRACTICE6_GEMM_H
+#define PRACTICE6_GEMM_H
+
+#include <stddef.h>
+
+// Регистровая плитка микроядра
+#define GEMM_MR 6
+#define GEMM_NR 16
+
+// Блоки по кэшам: KC - глубина (столбцы A / строки B), MC - строки A,
+// NC - столбцы B. MC кратно MR, NC кратно NR
+#define GEMM_KC 256
+#define GEMM_MC 96
+#define GEMM_NC 2048
+
+// C = A * B; A[n x m], B[m x k], C[n x k]
+void gemm_multiply(const float* A, const float* B, float* C, int n, int m, int k);
+
+// Пакет независимых малых умножений (порядка 8x8..64x64): C_i = A_i * B_i,
+// A_i[n x m], B_i[m x k], C_i[n x k]. Пакет делится между потоками OpenMP
+// непрерывными частями по многу матриц на поток, каждое умножение поток
+// считает сам той же упаковкой и микроядром - без параллельной области
+// и выделения буферов упаковки на каждое умножение.
+// Шаговый пакет: матрица i начинается с A + i * stride_a (в элементах),
+// шаг 0 - одна матрица на весь пакет
+void gemm_batched_strided(const float* A, size_t stride_a, const float* B, size_t stride_b,
+                          float* C, size_t stride_c, int n, int m, int k, int count);
+
+// Пакет массивами указателей на матрицы
+void gemm_batched(const float* const* A, const float* const* B, float* const* C,
+                  int n, int m, int k, int count);
+
+// Имя выбранного микроядра ("avx2-fma 6x16" или "generic 6x16")
+const char* gemm_kernel_name(void);
+
+#endif // PRACTICE6_GEMM_H
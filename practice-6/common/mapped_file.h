@@ -0,0 +1,116 @@
+/*
+ * Отображение двоичных файлов в память (mmap) для хостов OpenCL.
+ *
+ * Вместо заполнения массивов в программе хост может взять входные
+ * данные прямо из файла: "сырые" float32 в порядке little-endian
+ * без заголовка. Данные не разбираются и не копируются в malloc-буфер,
+ * а результат пишется в отображение выходного файла.
+ *
+ * Подсказки ядру: MADV_SEQUENTIAL (чтение вперед) и, где есть,
+ * MADV_HUGEPAGE (большие страницы). Ошибки madvise не критичны.
+ */
+
+#ifndef PRACTICE6_MAPPED_FILE_H
+#define PRACTICE6_MAPPED_FILE_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct {
+    void* data;
+    size_t size;
+    int writable;
+} mapped_file;
+
+// Файлы данных - little-endian
+static int mapped_little_endian_host(void) {
+    const uint32_t probe = 1;
+    unsigned char first;
+    memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+static void mapped_file_advise(mapped_file* file) {
+    madvise(file->data, file->size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    madvise(file->data, file->size, MADV_HUGEPAGE);
+#endif
+}
+
+// Общая часть открытия: size == 0 - взять размер файла, иначе создать файл
+static int mapped_file_map(mapped_file* file, const char* path, size_t create_size) {
+    file->data = NULL;
+    file->size = 0;
+    file->writable = create_size > 0;
+
+    if (!mapped_little_endian_host()) {
+        fprintf(stderr, "Ошибка: файлы данных little-endian, а машина big-endian\n");
+        return -1;
+    }
+
+    int fd = file->writable ? open(path, O_RDWR | O_CREAT | O_TRUNC, 0644)
+                            : open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Ошибка: не удалось открыть файл %s\n", path);
+        return -1;
+    }
+
+    size_t size = create_size;
+    if (file->writable) {
+        if (ftruncate(fd, (off_t)size) != 0) {
+            fprintf(stderr, "Ошибка: не удалось задать размер файла %s\n", path);
+            close(fd);
+            return -1;
+        }
+    } else {
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            fprintf(stderr, "Ошибка: файл %s пуст или недоступен\n", path);
+            close(fd);
+            return -1;
+        }
+        size = (size_t)info.st_size;
+    }
+
+    int protection = file->writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* address = mmap(NULL, size, protection, MAP_SHARED, fd, 0);
+    close(fd);  // Отображение держит файл само
+    if (address == MAP_FAILED) {
+        fprintf(stderr, "Ошибка: не удалось отобразить файл %s\n", path);
+        return -1;
+    }
+
+    file->data = address;
+    file->size = size;
+    mapped_file_advise(file);
+    return 0;
+}
+
+// Открыть существующий файл только для чтения
+static int mapped_file_open(mapped_file* file, const char* path) {
+    return mapped_file_map(file, path, 0);
+}
+
+// Создать файл размером size байт для записи результата
+static int mapped_file_create(mapped_file* file, const char* path, size_t size) {
+    return mapped_file_map(file, path, size);
+}
+
+// Сбросить изменения на диск и закрыть отображение
+static void mapped_file_close(mapped_file* file) {
+    if (file->data != NULL) {
+        if (file->writable) {
+            msync(file->data, file->size, MS_SYNC);
+        }
+        munmap(file->data, file->size);
+    }
+    file->data = NULL;
+    file->size = 0;
+}
+
+#endif // PRACTICE6_MAPPED_FILE_H
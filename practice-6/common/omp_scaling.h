@@ -0,0 +1,250 @@
+/*
+ * Масштабирование CPU версий по числу потоков OpenMP (C версия
+ * common/scaling.h из корня репозитория).
+ *
+ * Сильное масштабирование - задача фиксирована, слабое - растет
+ * вместе с числом потоков. Каждый поток привязывается к своему
+ * процессору (compact - подряд по узлам NUMA, spread - по очереди
+ * на каждый узел, node:K - только узел K), а данные инициализируются
+ * теми же потоками и с тем же разбиением, что и счет (first touch),
+ * чтобы страницы попали на узел NUMA потока, который их читает.
+ *
+ * Без OpenMP (например, Apple clang без -fopenmp) режим недоступен;
+ * привязка работает только на Linux.
+ */
+
+#ifndef PRACTICE6_OMP_SCALING_H
+#define PRACTICE6_OMP_SCALING_H
+
+// На Linux нужен _GNU_SOURCE до первого системного заголовка
+// (sched_setaffinity, CPU_SET) - его определяет программа
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define SCALING_MAX_CPUS 1024
+#define SCALING_MAX_POINTS 64
+
+typedef enum {
+    SCALING_PIN_NONE,
+    SCALING_PIN_COMPACT,
+    SCALING_PIN_SPREAD,
+    SCALING_PIN_NODE
+} scaling_placement;
+
+typedef struct {
+    scaling_placement placement;
+    int node;                        // Для SCALING_PIN_NODE
+    int cpus[SCALING_MAX_CPUS];      // Процессор для потока 0, 1, 2, ...
+    int cpu_count;
+} scaling_pinning;
+
+typedef struct {
+    int threads;
+    long long size;
+    double seconds;
+} scaling_point;
+
+// Разбор "0-3,8-11" в список процессоров; возвращает их число
+static int scaling_parse_cpulist(const char* text, int* cpus, int capacity) {
+    int count = 0;
+    const char* p = text;
+    while (*p) {
+        char* end;
+        long first = strtol(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for (long cpu = first; cpu <= last && count < capacity; cpu++) {
+            cpus[count++] = (int)cpu;
+        }
+        while (*p == ',' || *p == '\n' || *p == ' ') {
+            p++;
+        }
+    }
+    return count;
+}
+
+// Порядок процессоров для потоков по топологии NUMA из /sys
+// Возвращает 0 или -1, если привязка недоступна
+static int scaling_plan(scaling_pinning* pin) {
+    pin->cpu_count = 0;
+    if (pin->placement == SCALING_PIN_NONE) {
+        return 0;
+    }
+#ifdef __linux__
+    static int nodes[64][SCALING_MAX_CPUS];
+    int sizes[64];
+    int node_count = 0;
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+
+    // Узлы по возрастанию номера; пропуски в нумерации допустимы
+    for (int id = 0; id < 1024 && node_count < 64; id++) {
+        char path[96];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", id);
+        FILE* f = fopen(path, "r");
+        if (!f) {
+            continue;
+        }
+        char text[4096] = "";
+        if (!fgets(text, sizeof(text), f)) {
+            text[0] = '\0';
+        }
+        fclose(f);
+
+        int listed[SCALING_MAX_CPUS];
+        int n = scaling_parse_cpulist(text, listed, SCALING_MAX_CPUS);
+        sizes[node_count] = 0;
+        for (int c = 0; c < n; c++) {
+            if (listed[c] < CPU_SETSIZE && CPU_ISSET(listed[c], &allowed)) {
+                nodes[node_count][sizes[node_count]++] = listed[c];
+            }
+        }
+        if (sizes[node_count] > 0 && (pin->placement != SCALING_PIN_NODE || id == pin->node)) {
+            node_count++;
+        }
+    }
+
+    // Нет сведений о NUMA - все доступные процессоры одним узлом
+    if (node_count == 0 && pin->placement != SCALING_PIN_NODE) {
+        sizes[0] = 0;
+        for (int cpu = 0; cpu < CPU_SETSIZE && sizes[0] < SCALING_MAX_CPUS; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                nodes[0][sizes[0]++] = cpu;
+            }
+        }
+        node_count = sizes[0] > 0;
+    }
+
+    if (pin->placement == SCALING_PIN_SPREAD) {
+        for (int i = 0; pin->cpu_count < SCALING_MAX_CPUS; i++) {
+            int added = 0;
+            for (int n = 0; n < node_count; n++) {
+                if (i < sizes[n] && pin->cpu_count < SCALING_MAX_CPUS) {
+                    pin->cpus[pin->cpu_count++] = nodes[n][i];
+                    added = 1;
+                }
+            }
+            if (!added) {
+                break;
+            }
+        }
+    } else {
+        for (int n = 0; n < node_count; n++) {
+            for (int i = 0; i < sizes[n] && pin->cpu_count < SCALING_MAX_CPUS; i++) {
+                pin->cpus[pin->cpu_count++] = nodes[n][i];
+            }
+        }
+    }
+    return pin->cpu_count > 0 ? 0 : -1;
+#else
+    return -1;
+#endif
+}
+
+// Задает число потоков и привязывает каждый поток к своему процессору
+// Команда потоков OpenMP переиспользуется, привязка сохраняется
+static void scaling_pin_threads(const scaling_pinning* pin, int threads) {
+#ifdef _OPENMP
+    omp_set_num_threads(threads);
+#ifdef __linux__
+    if (pin->cpu_count == 0) {
+        return;
+    }
+    #pragma omp parallel num_threads(threads)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(pin->cpus[omp_get_thread_num() % pin->cpu_count], &set);
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+#endif
+#else
+    (void)pin;
+    (void)threads;
+#endif
+}
+
+// Разбор --pin none|compact|spread|node:K; 0 - успех
+static int scaling_parse_placement(const char* value, scaling_pinning* pin) {
+    pin->node = 0;
+    if (strcmp(value, "none") == 0) {
+        pin->placement = SCALING_PIN_NONE;
+    } else if (strcmp(value, "compact") == 0) {
+        pin->placement = SCALING_PIN_COMPACT;
+    } else if (strcmp(value, "spread") == 0) {
+        pin->placement = SCALING_PIN_SPREAD;
+    } else if (strncmp(value, "node:", 5) == 0 && value[5] >= '0' && value[5] <= '9') {
+        pin->placement = SCALING_PIN_NODE;
+        pin->node = atoi(value + 5);
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// Медиана времен запусков (массив переупорядочивается)
+static int scaling_compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double scaling_median(double* samples, int count) {
+    qsort(samples, count, sizeof(double), scaling_compare_doubles);
+    return count % 2 ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+}
+
+// Числа потоков по умолчанию: 1, 2, 4, ... и число процессоров
+static int scaling_default_threads(int* threads, int capacity) {
+    int procs = 1;
+#ifdef _OPENMP
+    procs = omp_get_num_procs();
+#endif
+    int count = 0;
+    for (int p = 1; p < procs && count < capacity - 1; p *= 2) {
+        threads[count++] = p;
+    }
+    threads[count++] = procs;
+    return count;
+}
+
+// Таблица ускорения и эффективности; база - первая точка
+// Сильное: S = T1 / Tp, E = S / p; слабое: E = T1 / Tp, S = p * E
+static void scaling_print_table(const char* title, int weak,
+                                const scaling_point* points, int count) {
+    if (count == 0) {
+        return;
+    }
+    printf("%s - %s масштабирование\n", title, weak ? "слабое" : "сильное");
+    printf("  потоков       размер   медиана, с%s  эффективность\n",
+           weak ? "  масшт. уск." : "    ускорение");
+    for (int i = 0; i < count; i++) {
+        double ratio = points[i].seconds > 0 ? points[0].seconds / points[i].seconds : 0;
+        double scale = (double)points[i].threads / points[0].threads;
+        double speedup = weak ? ratio * scale : ratio;
+        double efficiency = weak ? ratio : ratio / scale;
+        printf("  %7d %12lld %12.6f %12.2fx %14.0f%%\n", points[i].threads, points[i].size,
+               points[i].seconds, speedup, efficiency * 100);
+    }
+    printf("\n");
+}
+
+#endif // PRACTICE6_OMP_SCALING_H
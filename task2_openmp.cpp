@@ -4,43 +4,107 @@
  * Программа создает массив из 10000 случайных чисел и находит
  * минимальное и максимальное значения двумя способами:
  * 1) Последовательно
- * 2) Параллельно с OpenMP
+ * 2) Параллельно с OpenMP (внутри каждого потока - SIMD ядро)
+ *
+ * Обе версии построены на обобщенной редукции из common/reduction.h,
+ * которая за один проход считает также argmin/argmax, сумму,
+ * среднее, дисперсию и гистограмму для int, long long, float и double.
+ *
+ * Режим --bench запускает замер на большом массиве и выводит
+ * пропускную способность в ГБ/с в сравнении с пропускной
+ * способностью памяти. Замеры идут через common/bench.h: прогрев,
+ * несколько запусков, медиана/min/p95/σ, перебор размеров (--sizes)
+ * и чисел потоков (--threads), результаты в CSV/JSON.
+ *
+ * Режим --scaling повторяет findMinMaxParallel при 1, 2, 4, ... потоках
+ * (common/scaling.h): сильное масштабирование - размер фиксирован,
+ * слабое - растет с числом потоков. Потоки привязываются к процессорам
+ * (--pin), массив инициализируется теми же потоками (first touch).
+ *
+ * При сборке с PERF_COUNTERS=1 (make PERF=1) рядом со временем каждой
+ * версии выводятся аппаратные счетчики по потокам: циклы, инструкции,
+ * IPC, промахи LLC и ветвлений (common/perf_counters.h).
+ *
+ * Режим --input считает статистики файла реальных данных (int32 или
+ * float32, little-endian), отображенного в память (common/mapped_file.h),
+ * без копирования в массив.
  *
  * Компиляция: g++ -fopenmp -o task2_openmp task2_openmp.cpp
  * Запуск: ./task2_openmp
+ *         ./task2_openmp --bench [размер] [--mem-bw ГБ/с]
+ *         ./task2_openmp --bench --sizes 1000000,100000000 --threads 1,2,4 --json minmax.json
+ *         ./task2_openmp --scaling both --sizes 10000000 --pin spread
+ *         ./task2_openmp --input data.bin [--type int32|float32]
+ *         ./task2_openmp --dist zipf --seed 7
+ *
+ * Данные генерируются параллельно счетчиковым генератором Philox
+ * (common/data_gen.h): при одном seed массив один и тот же при любом
+ * числе потоков.
  */
 
 #include <iostream>
+#include <cstdio>
 #include <cstdlib>
-#include <ctime>
+#include <cstring>
+#include <climits>
 #include <omp.h>
 
+#include "common/bench.h"
+#include "common/simd_minmax.h"
+#include "common/reduction.h"
+#include "common/scaling.h"
+#include "common/mapped_file.h"
+#include "common/data_gen.h"
+
 using namespace std;
 
 // Размер массива
 const int ARRAY_SIZE = 10000;
 
+// Распределение тестовых данных (--dist, --seed)
+// По умолчанию числа от 0 до 99999 с фиксированным seed
+datagen::Spec dataSpec(datagen::UNIFORM, 0, 100000);
+
+// Настройки замеров (--reps, --warmup, --sizes, --threads, --csv, --json)
+// и накопленные результаты
+bench::Config benchConfig;
+bench::Report benchReport("task2_openmp");
+
+// Режим масштабирования (--scaling, --pin)
+scaling::Options scalingOptions;
+
 // Функция для заполнения массива случайными числами
+// Параллельно и воспроизводимо при любом числе потоков
 void fillArrayWithRandomNumbers(int arr[], int size)
 {
-    // Используем srand для инициализации генератора
-    srand(time(NULL));
-
-    for (int i = 0; i < size; i++)
-    {
-        // Генерируем числа от 0 до 99999
-        arr[i] = rand() % 100000;
-    }
+    datagen::fill(arr, size, dataSpec);
 }
 
 // Последовательный поиск минимума и максимума
+// Один поток, скалярное ядро - эталон для сравнения
 void findMinMaxSequential(int arr[], int size, int &minVal, int &maxVal)
+{
+    reduce::Options options;
+    options.parallel = false;
+    options.minMaxKernel = simd::minMaxScalar;
+
+    reduce::Result<int> r = reduce::compute(arr, size, reduce::MIN | reduce::MAX, options);
+    minVal = r.min;
+    maxVal = r.max;
+}
+
+// Параллельный поиск минимума и максимума с OpenMP (скалярный цикл)
+// Оставлен для сравнения с SIMD версией
+void findMinMaxParallelScalar(int arr[], int size, int &minVal, int &maxVal)
 {
     // Начинаем с первого элемента
     minVal = arr[0];
     maxVal = arr[0];
 
-    // Проходим по всему массиву
+    // Используем reduction для поиска min и max
+    // reduction(min:minVal) - каждый поток находит свой минимум, потом они объединяются
+    // reduction(max:maxVal) - то же самое для максимума
+    #pragma omp parallel for reduction(min:minVal) reduction(max:maxVal)
     for (int i = 1; i < size; i++)
     {
         if (arr[i] < minVal)
@@ -54,34 +118,434 @@ void findMinMaxSequential(int arr[], int size, int &minVal, int &maxVal)
     }
 }
 
-// Параллельный поиск минимума и максимума с OpenMP
-void findMinMaxParallel(int arr[], int size, int &minVal, int &maxVal)
+// Параллельный поиск минимума и максимума: OpenMP + SIMD
+// Массив делится на непрерывные куски по числу потоков,
+// каждый поток проходит свой кусок векторным ядром kernel
+void findMinMaxParallel(int arr[], int size, int &minVal, int &maxVal,
+                        simd::MinMaxKernel kernel = simd::minMaxKernel())
 {
-    // Начинаем с первого элемента
-    minVal = arr[0];
-    maxVal = arr[0];
+    reduce::Options options;
+    options.minMaxKernel = kernel;
 
-    // Используем reduction для поиска min и max
-    // reduction(min:minVal) - каждый поток находит свой минимум, потом они объединяются
-    // reduction(max:maxVal) - то же самое для максимума
-    #pragma omp parallel for reduction(min:minVal) reduction(max:maxVal)
-    for (int i = 1; i < size; i++)
+    reduce::Result<int> r = reduce::compute(arr, size, reduce::MIN | reduce::MAX, options);
+    minVal = r.min;
+    maxVal = r.max;
+}
+
+// Вывод всех статистик, посчитанных за один проход
+template <typename T>
+void printStatistics(const char* typeName, const T* data, int size)
+{
+    reduce::Options options;
+    options.histogram.lo = 0;
+    options.histogram.hi = 100000;
+    options.histogram.buckets = 10;
+
+    reduce::Result<T> r = reduce::compute(data, size, reduce::ALL, options);
+
+    cout << "Тип " << typeName << ":" << endl;
+    cout << "  min = " << r.min << " (индекс " << r.argmin << "), "
+         << "max = " << r.max << " (индекс " << r.argmax << ")" << endl;
+    cout << "  сумма = " << r.sum << ", среднее = " << r.mean
+         << ", дисперсия = " << r.variance << endl;
+    cout << "  гистограмма [0, 100000) по 10 корзинам:";
+    for (size_t b = 0; b < r.histogram.size(); b++)
     {
-        if (arr[i] < minVal)
+        cout << " " << r.histogram[b];
+    }
+    cout << endl;
+}
+
+// Пропускная способность памяти на чтение (ГБ/с, по медиане)
+// Все потоки просто суммируют массив: это самый простой проход
+// по памяти, с ним и сравнивается поиск min/max
+double measureReadBandwidth(const int arr[], int size)
+{
+    unsigned int check = 0;
+
+    bench::Summary t = bench::measure(benchConfig, [&]()
+    {
+        unsigned int sum = 0;
+        #pragma omp parallel for simd reduction(+:sum)
+        for (int i = 0; i < size; i++)
         {
-            minVal = arr[i];
+            sum += (unsigned int)arr[i];
         }
-        if (arr[i] > maxVal)
+        check += sum;
+    });
+
+    // Используем результат, чтобы компилятор не удалил цикл
+    volatile unsigned int dummy = check;
+    (void)dummy;
+
+    benchReport.add("read-bandwidth", "sum", size, omp_get_max_threads(), t,
+                    (double)size * sizeof(int));
+    return (double)size * sizeof(int) / t.median / 1e9;
+}
+
+// Печать одной строки результатов замера (ГБ/с - по медиане)
+void printBenchRow(const char* name, const bench::Summary& t, int size,
+                   double memBandwidth, double nominalBandwidth, bool ok)
+{
+    double gbps = (double)size * sizeof(int) / t.median / 1e9;
+
+    // Ширина считается в символах, а не в байтах UTF-8
+    int width = 0;
+    for (const char* c = name; *c; c++)
+    {
+        if ((*c & 0xC0) != 0x80)
         {
-            maxVal = arr[i];
+            width++;
         }
     }
+
+    cout << "  " << name;
+    for (int pad = width; pad < 24; pad++)
+    {
+        cout << ' ';
+    }
+    cout << t.median * 1000 << " мс (p95 " << t.p95 * 1000 << ", σ " << t.stddev * 1000
+         << "), " << gbps << " ГБ/с, "
+         << gbps / memBandwidth * 100 << "% от измеренной";
+    if (nominalBandwidth > 0)
+    {
+        cout << ", " << gbps / nominalBandwidth * 100 << "% от паспортной";
+    }
+    cout << (ok ? "" : "  ОШИБКА: результат не совпадает!") << endl;
 }
 
-int main()
+// Режим замера: медиана по запускам для каждой версии
+void runBenchmark(int size, double nominalBandwidth)
 {
+    int threads = omp_get_max_threads();
+    double bytes = (double)size * sizeof(int);
+
+    cout << "=== Задача 2: замер поиска min/max ===" << endl;
+    cout << "Размер массива: " << size << " ("
+         << bytes / (1 << 20) << " МБ)" << endl;
+    cout << "Количество потоков OpenMP: " << threads << endl;
+    cout << "Лучший набор инструкций: " << simd::isaName(simd::detectIsa()) << endl;
+    cout << "Замер: " << benchConfig.warmups << " прогревочных + "
+         << benchConfig.repetitions << " запусков, время - медиана" << endl;
+    cout << endl;
+
+    int* numbers = new int[size];
+    fillArrayWithRandomNumbers(numbers, size);
+
+    double memBandwidth = measureReadBandwidth(numbers, size);
+    cout << "Пропускная способность памяти (чтение): " << memBandwidth << " ГБ/с" << endl;
+    if (nominalBandwidth > 0)
+    {
+        cout << "Паспортная пропускная способность:      " << nominalBandwidth << " ГБ/с" << endl;
+    }
+    cout << endl;
+
+    // Эталон - последовательная версия
+    int minRef, maxRef;
+    bench::Summary t = bench::measure(benchConfig, "sequential", [&]()
+    {
+        findMinMaxSequential(numbers, size, minRef, maxRef);
+    });
+    printBenchRow("последовательно", t, size, memBandwidth, nominalBandwidth, true);
+    perf::print("sequential");
+    benchReport.add("minmax", "sequential", size, 1, t, bytes);
+
+    int minVal, maxVal;
+    t = bench::measure(benchConfig, "openmp-reduction", [&]()
+    {
+        findMinMaxParallelScalar(numbers, size, minVal, maxVal);
+    });
+    printBenchRow("OpenMP (скалярно)", t, size, memBandwidth, nominalBandwidth,
+                  minVal == minRef && maxVal == maxRef);
+    perf::print("openmp-reduction");
+    benchReport.add("minmax", "openmp-reduction", size, threads, t, bytes);
+
+    // Все SIMD версии, которые поддерживает процессор
+    const simd::Isa isas[] = { simd::Isa::Scalar, simd::Isa::SSE41,
+                               simd::Isa::AVX2, simd::Isa::AVX512 };
+    for (simd::Isa isa : isas)
+    {
+        if (!simd::isaSupported(isa))
+        {
+            continue;
+        }
+
+        simd::MinMaxKernel kernel = simd::minMaxKernelFor(isa);
+        char variant[64];
+        snprintf(variant, sizeof(variant), "openmp-%s", simd::isaName(isa));
+        t = bench::measure(benchConfig, variant, [&]()
+        {
+            findMinMaxParallel(numbers, size, minVal, maxVal, kernel);
+        });
+
+        char name[64];
+        snprintf(name, sizeof(name), "OpenMP + %s", simd::isaName(isa));
+        printBenchRow(name, t, size, memBandwidth, nominalBandwidth,
+                      minVal == minRef && maxVal == maxRef);
+        perf::print(variant);
+        benchReport.add("minmax", variant, size, threads, t, bytes);
+    }
+
+    // Все статистики за один проход против отдельного прохода на каждую
+    reduce::Options options;
+    options.histogram.lo = 0;
+    options.histogram.hi = 100000;
+    options.histogram.buckets = 64;
+
+    const unsigned separate[] = { reduce::MIN | reduce::MAX, reduce::ARGMIN | reduce::ARGMAX,
+                                  reduce::SUM, reduce::VARIANCE, reduce::HISTOGRAM };
+    bench::Summary fused = bench::measure(benchConfig, "stats-fused", [&]()
+    {
+        reduce::Result<int> r = reduce::compute(numbers, size, reduce::ALL, options);
+        minVal = r.min;
+        maxVal = r.max;
+    });
+    bench::Summary apart = bench::measure(benchConfig, "stats-separate", [&]()
+    {
+        for (unsigned stats : separate)
+        {
+            reduce::compute(numbers, size, stats, options);
+        }
+    });
+    cout << endl;
+    printBenchRow("все за 1 проход", fused, size, memBandwidth, nominalBandwidth,
+                  minVal == minRef && maxVal == maxRef);
+    perf::print("stats-fused");
+    printBenchRow("по отдельности (5)", apart, size, memBandwidth, nominalBandwidth, true);
+    perf::print("stats-separate");
+    benchReport.add("stats", "fused", size, threads, fused, bytes);
+    benchReport.add("stats", "separate", size, threads, apart, bytes);
+
+    cout << endl;
+    cout << "Минимум: " << minRef << ", максимум: " << maxRef << endl;
+
+    delete[] numbers;
+}
+
+// Режим масштабирования: findMinMaxParallel при 1..N потоках
+// baseSize - размер при сильном и размер на поток при слабом
+void runScaling(long long baseSize)
+{
+    std::vector<int> threads = scaling::threadCounts(scalingOptions, benchConfig);
+    long long largest = scaling::largestSize(scalingOptions, baseSize, threads);
+    if (largest > INT_MAX)
+    {
+        cout << "ОШИБКА: размер " << largest << " больше " << INT_MAX << endl;
+        return;
+    }
+
+    cout << "=== Задача 2: масштабирование поиска min/max ===" << endl;
+    scaling::printTopology(scalingOptions);
+    cout << "SIMD ядро: " << simd::isaName(simd::defaultIsa()) << endl;
+    cout << endl;
+
+    const scaling::Mode modes[] = { scaling::STRONG, scaling::WEAK };
+    for (scaling::Mode mode : modes)
+    {
+        if (!(scalingOptions.modes & mode))
+        {
+            continue;
+        }
+
+        std::vector<scaling::Point> points = scaling::sweep(scalingOptions, mode, baseSize, threads,
+            [&](long long size)
+            {
+                // Страницы массива достаются узлам потоков, которые их читают
+                int* numbers = new int[size];
+                scaling::firstTouch(numbers, size);
+                fillArrayWithRandomNumbers(numbers, (int)size);
+
+                int minVal, maxVal;
+                bench::Summary t = bench::measure(benchConfig, [&]()
+                {
+                    findMinMaxParallel(numbers, (int)size, minVal, maxVal);
+                });
+                delete[] numbers;
+                return t;
+            });
+        scaling::printTable("findMinMaxParallel", mode, points);
+        scaling::addToReport(benchReport, "minmax", mode, points, sizeof(int));
+    }
+}
+
+// Статистики файла, отображенного в память: последовательно и параллельно
+// Первый проход заодно подгружает страницы файла с диска
+template <typename T>
+void analyzeMappedData(const char* typeName, const T* data, size_t size)
+{
+    unsigned stats = reduce::MIN | reduce::MAX | reduce::ARGMIN | reduce::ARGMAX
+                     | reduce::SUM | reduce::MEAN | reduce::VARIANCE;
+    reduce::Options sequential;
+    sequential.parallel = false;
+    reduce::Options parallel;
+
+    double start = omp_get_wtime();
+    reduce::Result<T> seq = reduce::compute(data, size, stats, sequential);
+    double timeSeq = omp_get_wtime() - start;
+
+    start = omp_get_wtime();
+    reduce::Result<T> par = reduce::compute(data, size, stats, parallel);
+    double timePar = omp_get_wtime() - start;
+
+    double gigabytes = (double)size * sizeof(T) / 1e9;
+
+    cout << "Тип " << typeName << ", элементов: " << size << endl;
+    cout << "  min = " << par.min << " (индекс " << par.argmin << "), "
+         << "max = " << par.max << " (индекс " << par.argmax << ")" << endl;
+    cout << "  сумма = " << par.sum << ", среднее = " << par.mean
+         << ", дисперсия = " << par.variance << endl;
+    cout << "  Последовательно: " << timeSeq * 1000 << " мс, "
+         << (timeSeq > 0 ? gigabytes / timeSeq : 0) << " ГБ/с" << endl;
+    cout << "  Параллельно:     " << timePar * 1000 << " мс, "
+         << (timePar > 0 ? gigabytes / timePar : 0) << " ГБ/с" << endl;
+
+    if (seq.min == par.min && seq.max == par.max
+        && seq.argmin == par.argmin && seq.argmax == par.argmax)
+    {
+        cout << "  Результаты совпадают - OK!" << endl;
+    }
+    else
+    {
+        cout << "  ОШИБКА: результаты не совпадают!" << endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    // Разбор аргументов командной строки
+    bool benchMode = false;
+    long long benchSize = 100000000;  // 100M элементов (400 МБ)
+    double nominalBandwidth = 0;
+    const char* inputPath = NULL;
+    bool inputFloat = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--bench") == 0)
+        {
+            benchMode = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                benchSize = atoll(argv[++i]);
+            }
+        }
+        else if (bench::parseOption(argc, argv, i, benchConfig))
+        {
+        }
+        else if (scaling::parseOption(argc, argv, i, scalingOptions))
+        {
+        }
+        else if (strcmp(argv[i], "--mem-bw") == 0 && i + 1 < argc)
+        {
+            nominalBandwidth = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--dist") == 0 && i + 1 < argc
+                 && datagen::parseDistribution(argv[i + 1], dataSpec.distribution))
+        {
+            i++;
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            dataSpec.seed = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc)
+        {
+            inputPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--type") == 0 && i + 1 < argc
+                 && (strcmp(argv[i + 1], "int32") == 0 || strcmp(argv[i + 1], "float32") == 0))
+        {
+            inputFloat = strcmp(argv[++i], "float32") == 0;
+        }
+        else
+        {
+            cout << "Использование: " << argv[0]
+                 << " [--bench [размер]] [--mem-bw ГБ/с] [--input файл [--type int32|float32]]"
+                 << " [--dist распределение] [--seed S]" << endl;
+            cout << "Распределения:";
+            for (int d = 0; d < datagen::DISTRIBUTION_COUNT; d++)
+            {
+                cout << " " << datagen::distributionName((datagen::Distribution)d);
+            }
+            cout << endl;
+            bench::printUsage();
+            scaling::printUsage();
+            return 1;
+        }
+    }
+
+    if (inputPath != NULL)
+    {
+        cout << "=== Задача 2: Статистики файла " << inputPath << " ===" << endl;
+        cout << "Количество потоков OpenMP: " << omp_get_max_threads() << endl;
+        cout << "SIMD ядро: " << simd::isaName(simd::defaultIsa()) << endl;
+        cout << endl;
+
+        mapped::File input;
+        if (!input.openRead(inputPath))
+        {
+            return 1;
+        }
+        if (input.bytes() % 4 != 0)
+        {
+            cout << "ВНИМАНИЕ: размер файла не кратен 4 байтам, хвост пропущен" << endl;
+        }
+        if (input.bytes() < 4)
+        {
+            cout << "Файл пуст" << endl;
+            return 1;
+        }
+
+        if (inputFloat)
+        {
+            analyzeMappedData("float32", input.as<float>(), input.count<float>());
+        }
+        else
+        {
+            analyzeMappedData("int32", input.as<int>(), input.count<int>());
+        }
+        return 0;
+    }
+
+    if (scalingOptions.modes != 0)
+    {
+        // Базовый размер: первый из --sizes или 10M элементов на поток
+        long long baseSize = benchConfig.sizes.empty() ? 10000000 : benchConfig.sizes[0];
+        runScaling(baseSize);
+        return benchReport.write(benchConfig) ? 0 : 1;
+    }
+
+    if (benchMode)
+    {
+        // Перебор чисел потоков и размеров (по умолчанию - один замер)
+        std::vector<long long> sizes = bench::sizesOr(benchConfig,
+                                                      std::vector<long long>(1, benchSize));
+        std::vector<int> threads = bench::threadCounts(benchConfig);
+        for (size_t i = 0; i < sizes.size(); i++)
+        {
+            if (sizes[i] < 1 || sizes[i] > INT_MAX)
+            {
+                cout << "ОШИБКА: размер должен быть от 1 до " << INT_MAX << endl;
+                return 1;
+            }
+        }
+
+        for (size_t t = 0; t < threads.size(); t++)
+        {
+            omp_set_num_threads(threads[t]);
+            for (size_t i = 0; i < sizes.size(); i++)
+            {
+                runBenchmark((int)sizes[i], nominalBandwidth);
+                cout << endl;
+            }
+        }
+        return benchReport.write(benchConfig) ? 0 : 1;
+    }
+
     cout << "=== Задача 2: Поиск минимума и максимума ===" << endl;
     cout << "Размер массива: " << ARRAY_SIZE << endl;
+    cout << "Данные: " << datagen::distributionName(dataSpec.distribution)
+         << ", seed " << dataSpec.seed << endl;
     cout << endl;
 
     // Создаем массив
@@ -92,38 +556,45 @@ int main()
 
     // Показываем сколько потоков используется
     cout << "Количество потоков OpenMP: " << omp_get_max_threads() << endl;
+    cout << "SIMD ядро: " << simd::isaName(simd::defaultIsa()) << endl;
     cout << endl;
 
     // Переменные для результатов
-    int minSeq, maxSeq;
-    int minPar, maxPar;
+    int minSeq = 0, maxSeq = 0;
+    int minPar = 0, maxPar = 0;
 
     // ===== Последовательная версия =====
     cout << "--- Последовательная версия ---" << endl;
 
-    double startSeq = omp_get_wtime();  // Засекаем время
-    findMinMaxSequential(numbers, ARRAY_SIZE, minSeq, maxSeq);
-    double endSeq = omp_get_wtime();
-
-    double timeSeq = endSeq - startSeq;
+    // Медиана по нескольким запускам после прогрева
+    bench::Summary seq = bench::measure(benchConfig, "sequential", [&]()
+    {
+        findMinMaxSequential(numbers, ARRAY_SIZE, minSeq, maxSeq);
+    });
+    benchReport.add("minmax", "sequential", ARRAY_SIZE, 1, seq, ARRAY_SIZE * sizeof(int));
+    double timeSeq = seq.median;
 
     cout << "Минимум: " << minSeq << endl;
     cout << "Максимум: " << maxSeq << endl;
-    cout << "Время: " << timeSeq * 1000 << " мс" << endl;
+    cout << "Время: " << bench::format(seq) << endl;
+    perf::print("sequential");
     cout << endl;
 
     // ===== Параллельная версия =====
-    cout << "--- Параллельная версия (OpenMP) ---" << endl;
-
-    double startPar = omp_get_wtime();
-    findMinMaxParallel(numbers, ARRAY_SIZE, minPar, maxPar);
-    double endPar = omp_get_wtime();
+    cout << "--- Параллельная версия (OpenMP + SIMD) ---" << endl;
 
-    double timePar = endPar - startPar;
+    bench::Summary par = bench::measure(benchConfig, "openmp-simd", [&]()
+    {
+        findMinMaxParallel(numbers, ARRAY_SIZE, minPar, maxPar);
+    });
+    benchReport.add("minmax", "openmp-simd", ARRAY_SIZE, omp_get_max_threads(), par,
+                    ARRAY_SIZE * sizeof(int));
+    double timePar = par.median;
 
     cout << "Минимум: " << minPar << endl;
     cout << "Максимум: " << maxPar << endl;
-    cout << "Время: " << timePar * 1000 << " мс" << endl;
+    cout << "Время: " << bench::format(par) << endl;
+    perf::print("openmp-simd");
     cout << endl;
 
     // ===== Сравнение результатов =====
@@ -148,6 +619,30 @@ int main()
 
     cout << endl;
 
+    // ===== Все статистики за один проход =====
+    cout << "--- Статистики за один проход ---" << endl;
+
+    long long* numbers64 = new long long[ARRAY_SIZE];
+    float* numbersF = new float[ARRAY_SIZE];
+    double* numbersD = new double[ARRAY_SIZE];
+    for (int i = 0; i < ARRAY_SIZE; i++)
+    {
+        numbers64[i] = numbers[i];
+        numbersF[i] = (float)numbers[i];
+        numbersD[i] = (double)numbers[i];
+    }
+
+    printStatistics("int", numbers, ARRAY_SIZE);
+    printStatistics("long long", numbers64, ARRAY_SIZE);
+    printStatistics("float", numbersF, ARRAY_SIZE);
+    printStatistics("double", numbersD, ARRAY_SIZE);
+
+    delete[] numbers64;
+    delete[] numbersF;
+    delete[] numbersD;
+
+    cout << endl;
+
     // ===== Выводы =====
     cout << "--- Выводы ---" << endl;
     cout << "1. Для массива из 10000 элементов параллельная версия" << endl;
@@ -166,5 +661,6 @@ int main()
     // Освобождаем память
     delete[] numbers;
 
-    return 0;
+    // Результаты замеров - в CSV/JSON, если заданы --csv/--json
+    return benchReport.write(benchConfig) ? 0 : 1;
 }
@@ -5,36 +5,90 @@
  * 1) Последовательную версию
  * 2) Параллельную версию с OpenMP
  *
- * Тестируется на массивах размером 1000 и 10000 элементов.
+ * Для сравнения рядом запускаются параллельная сортировка
+ * выборкой (samplesort), параллельная сортировка слиянием и
+ * параллельная поразрядная сортировка (LSD radix sort), которые
+ * масштабируются на 10^8+ элементов. Маленькие куски в samplesort
+ * и сортировке слиянием сортируются битонической сетью AVX2.
+ *
+ * По умолчанию тестируется на массивах размером 1000 и 10000 элементов.
+ * Каждая сортировка замеряется общим каркасом common/bench.h: прогрев,
+ * несколько запусков, медиана/min/p95/σ; --sizes и --threads задают
+ * перебор, --csv и --json сохраняют результаты.
+ *
+ * Сборка с PERF_COUNTERS=1 (make PERF=1) добавляет к каждому замеру
+ * аппаратные счетчики по потокам (common/perf_counters.h): видно,
+ * во что упирается сортировка - в память, ветвления или синхронизацию.
+ *
+ * Режим --scaling повторяет параллельные сортировки при 1, 2, 4, ...
+ * потоках (common/scaling.h) с привязкой потоков (--pin) и
+ * инициализацией массивов теми же потоками (first touch); выводит
+ * ускорение и эффективность для сильного и слабого масштабирования.
+ *
+ * Режим --external сортирует файл int32, который не помещается в память
+ * (common/external_sort.h): серии по бюджету памяти сбрасываются на диск
+ * и сливаются k-путевым слиянием с асинхронным чтением и записью.
+ * Режим --input сортирует файл, отображенный в память (common/mapped_file.h),
+ * и записывает результат в отображенный выходной файл --output.
  *
  * Компиляция: g++ -fopenmp -o task3_selection_sort task3_selection_sort.cpp
  * Запуск: ./task3_selection_sort
+ *         ./task3_selection_sort --size 100000000 --sort samplesort,radix --radix-bits 8
+ *         ./task3_selection_sort --size 10000000 --sort mergesort --dist nearly-sorted
+ *         ./task3_selection_sort --sizes 1000000,10000000 --threads 1,2,4 --sort radix --csv sort.csv
+ *         ./task3_selection_sort --scaling strong --sizes 10000000 --sort samplesort,radix --pin spread
+ *         ./task3_selection_sort --input keys.bin --output sorted.bin --sort radix
+ *         ./task3_selection_sort --generate keys.bin 1000000000
+ *         ./task3_selection_sort --external keys.bin sorted.bin --memory 1024 --tmp /tmp
  */
 
 #include <iostream>
+#include <climits>
+#include <cstdio>
 #include <cstdlib>
-#include <ctime>
 #include <cstring>
 #include <omp.h>
 
+#include "common/bench.h"
+#include "common/data_gen.h"
+#include "common/external_sort.h"
+#include "common/mapped_file.h"
+#include "common/parallel_sort.h"
+#include "common/scaling.h"
+
 using namespace std;
 
+// Распределение тестовых данных (--dist, --seed)
+// По умолчанию числа от 0 до 9999 с фиксированным seed
+datagen::Spec dataSpec(datagen::UNIFORM, 0, 10000);
+
 // Функция для заполнения массива случайными числами
+// Параллельно и воспроизводимо при любом числе потоков
 void fillArray(int arr[], int size)
+{
+    datagen::fill(arr, size, dataSpec);
+}
+
+// Функция для копирования массива
+void copyArray(const int source[], int dest[], int size)
 {
     for (int i = 0; i < size; i++)
     {
-        arr[i] = rand() % 10000;
+        dest[i] = source[i];
     }
 }
 
-// Функция для копирования массива
-void copyArray(int source[], int dest[], int size)
+// Контрольная сумма, не зависящая от порядка элементов
+// Нужна чтобы убедиться, что сортировка не потеряла элементы
+unsigned long long checksum(const int arr[], int size)
 {
+    unsigned long long sum = 0;
     for (int i = 0; i < size; i++)
     {
-        dest[i] = source[i];
+        unsigned long long x = (unsigned int)arr[i];
+        sum += x * x + x * 0x9E3779B97F4A7C15ULL;
     }
+    return sum;
 }
 
 // Функция для проверки что массив отсортирован
@@ -126,8 +180,136 @@ void selectionSortParallel(int arr[], int size)
     }
 }
 
+// Параллельная сортировка выборкой (samplesort)
+// Один параллельный регион на всю сортировку вместо n регионов
+void sampleSortParallel(int arr[], int size)
+{
+    psort::sampleSort(arr, size);
+}
+
+// Параллельная сортировка слиянием на задачах OpenMP
+// Листья по 64 элемента сортируются битонической сетью AVX2
+void mergeSortParallel(int arr[], int size)
+{
+    psort::mergeSort(arr, size);
+}
+
+// Сколько бит ключа обрабатывает radix sort за один проход (--radix-bits)
+int radixBits = 8;
+
+// Параллельная поразрядная сортировка (LSD radix sort)
+// Ключи у нас неотрицательные и меньше 100000, поэтому сравнения
+// не нужны: хватает нескольких проходов раскладки по цифрам
+void radixSortParallel(int arr[], int size)
+{
+    psort::radixSort(arr, size, radixBits);
+}
+
+// Описание алгоритма сортировки для testPerformance
+struct SortMode
+{
+    const char* name;          // Имя для --sort
+    const char* title;         // Заголовок в выводе
+    void (*sort)(int[], int);  // Функция сортировки
+    bool parallel;             // Использует потоки OpenMP
+    bool quadratic;            // O(n^2) - не запускаем на больших массивах
+};
+
+const SortMode SORT_MODES[] = {
+    { "selection-seq", "Последовательная сортировка выбором", selectionSortSequential, false, true },
+    { "selection-par", "Параллельная сортировка выбором (OpenMP)", selectionSortParallel, true, true },
+    { "samplesort", "Параллельная сортировка выборкой (samplesort)", sampleSortParallel, true, false },
+    { "mergesort", "Параллельная сортировка слиянием (задачи OpenMP)", mergeSortParallel, true, false },
+    { "radix", "Параллельная поразрядная сортировка (LSD radix)", radixSortParallel, true, false },
+};
+
+const int SORT_MODE_COUNT = sizeof(SORT_MODES) / sizeof(SORT_MODES[0]);
+
+// Сортировки O(n^2) больше этого размера займут минуты - пропускаем
+const int QUADRATIC_LIMIT = 200000;
+
+// Настройки замеров (--reps, --warmup, --sizes, --threads, --csv, --json)
+// и накопленные результаты
+bench::Config benchConfig;
+bench::Report benchReport("task3_selection_sort");
+
+// Режим масштабирования (--scaling, --pin)
+scaling::Options scalingOptions;
+
+// Запуск выбранных сортировок на копиях массива original
+// modes - битовая маска: бит i включает SORT_MODES[i]
+// После вызова в arr лежит результат последней сортировки
+void runSortModes(const int original[], int arr[], int size, unsigned modes)
+{
+    unsigned long long expected = checksum(original, size);
+
+    // Время первой запущенной сортировки - база для ускорения
+    double baseTime = 0;
+    const char* baseName = NULL;
+
+    for (int m = 0; m < SORT_MODE_COUNT; m++)
+    {
+        const SortMode& mode = SORT_MODES[m];
+        if (!(modes & (1u << m)))
+        {
+            continue;
+        }
+
+        cout << endl << mode.title << ":" << endl;
+
+        if (mode.quadratic && size > QUADRATIC_LIMIT)
+        {
+            cout << "  Пропущено: O(n^2) на " << size << " элементах слишком долго" << endl;
+            continue;
+        }
+
+        if (mode.parallel)
+        {
+            cout << "  Количество потоков: " << omp_get_max_threads() << endl;
+        }
+
+        // Каждый запуск получает копию одного и того же массива
+        // (копирование в замер не входит)
+        bench::Summary t = bench::measure(benchConfig, mode.name,
+            [&]() { copyArray(original, arr, size); },
+            [&]() { mode.sort(arr, size); });
+        double time = t.median;
+
+        // Проверяем результат последнего запуска
+        if (isSorted(arr, size) && checksum(arr, size) == expected)
+        {
+            cout << "  Результат: массив отсортирован корректно" << endl;
+        }
+        else
+        {
+            cout << "  ОШИБКА: массив не отсортирован!" << endl;
+        }
+        cout << "  Время: " << bench::format(t) << endl;
+        perf::print(mode.name);
+        if (time > 0)
+        {
+            cout << "  Скорость: " << size / time / 1e6 << " млн элементов/с" << endl;
+        }
+        benchReport.add("sort", mode.name, size, mode.parallel ? omp_get_max_threads() : 1,
+                        t, (double)size * sizeof(int));
+
+        if (baseName == NULL)
+        {
+            baseTime = time;
+            baseName = mode.name;
+        }
+        else if (time > 0)
+        {
+            cout << "  Ускорение относительно " << baseName << ": "
+                 << baseTime / time << "x" << endl;
+        }
+    }
+
+}
+
 // Функция для тестирования производительности
-void testPerformance(int size)
+// modes - битовая маска: бит i включает SORT_MODES[i]
+void testPerformance(int size, unsigned modes = ~0u)
 {
     cout << "========================================" << endl;
     cout << "Размер массива: " << size << " элементов" << endl;
@@ -135,98 +317,438 @@ void testPerformance(int size)
 
     // Создаем массивы
     int* original = new int[size];
-    int* arrSeq = new int[size];
-    int* arrPar = new int[size];
+    int* arr = new int[size];
 
     // Заполняем исходный массив
     fillArray(original, size);
 
-    // Копируем для каждой версии
-    copyArray(original, arrSeq, size);
-    copyArray(original, arrPar, size);
+    runSortModes(original, arr, size, modes);
+
+    // Освобождаем память
+    delete[] original;
+    delete[] arr;
+}
+
+// Режим масштабирования: параллельные сортировки при 1..N потоках
+// baseSize - размер при сильном и размер на поток при слабом
+void runScaling(long long baseSize, unsigned modes)
+{
+    std::vector<int> threads = scaling::threadCounts(scalingOptions, benchConfig);
+    long long largest = scaling::largestSize(scalingOptions, baseSize, threads);
+    if (largest > INT_MAX)
+    {
+        cout << "ОШИБКА: размер " << largest << " больше " << INT_MAX << endl;
+        return;
+    }
+
+    cout << "=== Задача 3: масштабирование сортировок ===" << endl;
+    scaling::printTopology(scalingOptions);
+    cout << endl;
 
-    // ===== Последовательная сортировка =====
-    cout << endl << "Последовательная сортировка выбором:" << endl;
+    const scaling::Mode kinds[] = { scaling::STRONG, scaling::WEAK };
+    for (int m = 0; m < SORT_MODE_COUNT; m++)
+    {
+        const SortMode& mode = SORT_MODES[m];
+        if (!(modes & (1u << m)) || !mode.parallel)
+        {
+            continue;
+        }
+        if (mode.quadratic && largest > QUADRATIC_LIMIT)
+        {
+            cout << mode.title << ": пропущено, O(n^2) на " << largest
+                 << " элементах слишком долго" << endl << endl;
+            continue;
+        }
 
-    double startSeq = omp_get_wtime();
-    selectionSortSequential(arrSeq, size);
-    double endSeq = omp_get_wtime();
+        for (scaling::Mode kind : kinds)
+        {
+            if (!(scalingOptions.modes & kind))
+            {
+                continue;
+            }
 
-    double timeSeq = endSeq - startSeq;
+            std::vector<scaling::Point> points = scaling::sweep(scalingOptions, kind, baseSize, threads,
+                [&](long long size)
+                {
+                    // Оба массива сначала касаются потоки, которые их сортируют
+                    int* original = new int[size];
+                    int* arr = new int[size];
+                    scaling::firstTouch(original, size);
+                    scaling::firstTouch(arr, size);
+                    fillArray(original, (int)size);
+
+                    bench::Summary t = bench::measure(benchConfig,
+                        [&]() { copyArray(original, arr, (int)size); },
+                        [&]() { mode.sort(arr, (int)size); });
+                    if (!isSorted(arr, (int)size))
+                    {
+                        cout << "ОШИБКА: массив не отсортирован!" << endl;
+                    }
+
+                    delete[] original;
+                    delete[] arr;
+                    return t;
+                });
+            scaling::printTable(mode.title, kind, points);
+            scaling::addToReport(benchReport, mode.name, kind, points, sizeof(int));
+        }
+    }
+}
 
-    if (isSorted(arrSeq, size))
+// Сортировки на данных из файла int32, отображенного в память
+// Вход не копируется в отдельный массив: каждая сортировка получает
+// копию прямо из отображения. Если задан output, сортировки идут
+// в отображении выходного файла и результат остается в нем
+bool testFile(const char* input, const char* output, unsigned modes)
+{
+    mapped::File source;
+    if (!source.openRead(input))
     {
-        cout << "  Результат: массив отсортирован корректно" << endl;
+        return false;
     }
-    else
+    size_t count = source.count<int>();
+    if (count == 0 || count > INT_MAX)
     {
-        cout << "  ОШИБКА: массив не отсортирован!" << endl;
+        cout << "В файле должно быть от 1 до " << INT_MAX << " чисел int32" << endl;
+        return false;
     }
-    cout << "  Время: " << timeSeq * 1000 << " мс" << endl;
+    int size = (int)count;
 
-    // ===== Параллельная сортировка =====
-    cout << endl << "Параллельная сортировка выбором (OpenMP):" << endl;
-    cout << "  Количество потоков: " << omp_get_max_threads() << endl;
+    cout << "========================================" << endl;
+    cout << "Файл " << input << ": " << size << " элементов" << endl;
+    cout << "========================================" << endl;
 
-    double startPar = omp_get_wtime();
-    selectionSortParallel(arrPar, size);
-    double endPar = omp_get_wtime();
+    mapped::File target;
+    int* arr = NULL;
+    if (output != NULL)
+    {
+        if (!target.create(output, count * sizeof(int)))
+        {
+            return false;
+        }
+        arr = target.as<int>();
+    }
+    else
+    {
+        arr = new int[size];
+    }
 
-    double timePar = endPar - startPar;
+    runSortModes(source.as<int>(), arr, size, modes);
 
-    if (isSorted(arrPar, size))
+    if (output != NULL)
     {
-        cout << "  Результат: массив отсортирован корректно" << endl;
+        double start = omp_get_wtime();
+        target.close();
+        cout << endl << "Результат записан в " << output << " за "
+             << (omp_get_wtime() - start) * 1000 << " мс" << endl;
     }
     else
     {
-        cout << "  ОШИБКА: массив не отсортирован!" << endl;
+        delete[] arr;
+    }
+    return true;
+}
+
+// Запись файла из count случайных int32 для внешней сортировки
+// Пишется кусками, чтобы не держать весь файл в памяти
+bool generateFile(const char* path, long long count)
+{
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        cout << "Не удалось создать файл " << path << endl;
+        return false;
+    }
+
+    // Распределение из --dist на всем диапазоне неотрицательных int
+    datagen::Spec spec = dataSpec;
+    spec.lo = 0;
+    spec.hi = INT_MAX;
+
+    const int chunk = 1 << 20;
+    int* buffer = new int[chunk];
+    bool ok = true;
+    for (long long done = 0; done < count && ok; done += chunk)
+    {
+        int n = count - done < chunk ? (int)(count - done) : chunk;
+        datagen::fill(buffer, n, spec, done, count);
+        ok = fwrite(buffer, sizeof(int), n, file) == (size_t)n;
     }
-    cout << "  Время: " << timePar * 1000 << " мс" << endl;
+    delete[] buffer;
 
-    // ===== Сравнение =====
-    cout << endl << "Сравнение:" << endl;
+    if (fclose(file) != 0 || !ok)
+    {
+        cout << "Ошибка записи в файл " << path << endl;
+        return false;
+    }
+    cout << "Записано " << count << " элементов в " << path << endl;
+    return true;
+}
 
-    if (timePar > 0)
+// Внешняя сортировка файла с отчетом по фазам
+bool runExternalSort(const char* input, const char* output, const extsort::Options& options)
+{
+    cout << "=== Внешняя сортировка ===" << endl;
+    cout << "Вход: " << input << ", выход: " << output << endl;
+    cout << "Бюджет памяти: " << options.memoryBudget / (1 << 20) << " МБ, каталог серий: "
+         << options.tempDir << ", потоков: " << options.threads << endl;
+    cout << endl;
+
+    extsort::Stats stats = extsort::sortFile(input, output, options);
+    double bytes = (double)stats.elements * sizeof(int);
+
+    cout << "Элементов: " << stats.elements << " (" << bytes / 1e6 << " МБ)" << endl;
+    cout << endl;
+
+    cout << "Фаза 1: формирование серий (" << stats.runs << " серий)" << endl;
+    cout << "  Чтение:     " << stats.readTime << " с, "
+         << extsort::megabytesPerSecond(bytes, stats.readTime) << " МБ/с" << endl;
+    cout << "  Сортировка: " << stats.sortTime << " с, "
+         << extsort::megabytesPerSecond(bytes, stats.sortTime) << " МБ/с" << endl;
+    cout << "  Запись:     " << stats.writeTime << " с, "
+         << extsort::megabytesPerSecond(bytes, stats.writeTime) << " МБ/с" << endl;
+    double phase1 = stats.readTime + stats.sortTime + stats.writeTime;
+    cout << "  Всего:      " << phase1 << " с, "
+         << extsort::megabytesPerSecond(bytes, phase1) << " МБ/с" << endl;
+    cout << endl;
+
+    cout << "Фаза 2: слияние (" << stats.mergePasses << " прох.)" << endl;
+    cout << "  Время:           " << stats.mergeTime << " с, "
+         << extsort::megabytesPerSecond(stats.mergeBytes, stats.mergeTime) << " МБ/с" << endl;
+    cout << "  Ожидание диска:  " << stats.ioWaitTime << " с" << endl;
+    cout << endl;
+
+    double total = phase1 + stats.mergeTime;
+    cout << "Всего: " << total << " с, " << extsort::megabytesPerSecond(bytes, total) << " МБ/с" << endl;
+
+    if (extsort::verifyFile(output, stats))
+    {
+        cout << "Результат: файл отсортирован корректно" << endl;
+        return true;
+    }
+    cout << "ОШИБКА: файл не отсортирован или элементы потеряны!" << endl;
+    return false;
+}
+
+// Разбор списка алгоритмов вида "selection-par,samplesort"
+// Возвращает битовую маску для testPerformance или 0 при ошибке
+unsigned parseSortModes(const char* list)
+{
+    if (strcmp(list, "all") == 0)
     {
-        double speedup = timeSeq / timePar;
-        cout << "  Ускорение: " << speedup << "x" << endl;
+        return ~0u;
+    }
+
+    unsigned modes = 0;
+    char buffer[256];
+    strncpy(buffer, list, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
 
-        if (speedup > 1)
+    for (char* name = strtok(buffer, ","); name != NULL; name = strtok(NULL, ","))
+    {
+        int m = 0;
+        while (m < SORT_MODE_COUNT && strcmp(SORT_MODES[m].name, name) != 0)
         {
-            cout << "  Вывод: параллельная версия быстрее" << endl;
+            m++;
         }
-        else
+        if (m == SORT_MODE_COUNT)
         {
-            cout << "  Вывод: последовательная версия быстрее" << endl;
-            cout << "         (накладные расходы на синхронизацию)" << endl;
+            cout << "Неизвестный алгоритм: " << name << endl;
+            return 0;
         }
+        modes |= 1u << m;
     }
-
-    // Освобождаем память
-    delete[] original;
-    delete[] arrSeq;
-    delete[] arrPar;
+    return modes;
 }
 
-int main()
+void printUsage(const char* program)
 {
-    cout << "=== Задача 3: Сортировка выбором с OpenMP ===" << endl;
+    cout << "Использование: " << program
+         << " [--size N]... [--sort список] [--radix-bits B] [--dist имя] [--seed S]" << endl;
+    cout << "  --size N      размер массива (можно указать несколько раз)" << endl;
+    cout << "  --sort список алгоритмы через запятую или all:" << endl;
+    for (int m = 0; m < SORT_MODE_COUNT; m++)
+    {
+        cout << "                  " << SORT_MODES[m].name << endl;
+    }
+    cout << "  --radix-bits B бит за проход radix sort (" << psort::RADIX_MIN_BITS
+         << ".." << psort::RADIX_MAX_BITS << ", по умолчанию 8)" << endl;
+    cout << "  --dist имя    распределение данных:";
+    for (int d = 0; d < datagen::DISTRIBUTION_COUNT; d++)
+    {
+        cout << " " << datagen::distributionName((datagen::Distribution)d);
+    }
     cout << endl;
+    cout << "  --seed S      seed генератора (по умолчанию " << datagen::DEFAULT_SEED << ")" << endl;
+    bench::printUsage();
+    scaling::printUsage();
+    cout << "Сортировка файла int32 (little-endian), отображенного в память:" << endl;
+    cout << "  " << program << " --input ФАЙЛ [--output ФАЙЛ] [--sort список]" << endl;
+    cout << "Внешняя сортировка файла int32:" << endl;
+    cout << "  " << program << " --external ВХОД ВЫХОД [--memory МБ] [--tmp КАТАЛОГ]" << endl;
+    cout << "  --memory МБ   бюджет памяти (по умолчанию 256)" << endl;
+    cout << "  --tmp КАТАЛОГ каталог для серий (по умолчанию текущий)" << endl;
+    cout << "  " << program << " --generate ФАЙЛ N - записать N случайных чисел" << endl;
+}
 
-    // Инициализация генератора случайных чисел
-    srand(time(NULL));
+int main(int argc, char* argv[])
+{
+    // Разбор аргументов командной строки
+    unsigned modes = ~0u;
+    const char* externalInput = NULL;
+    const char* externalOutput = NULL;
+    const char* generatePath = NULL;
+    long long generateCount = 0;
+    const char* inputPath = NULL;
+    const char* outputPath = NULL;
+    extsort::Options externalOptions;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+        {
+            long long size = atoll(argv[++i]);
+            if (size < 1 || size > INT_MAX)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            benchConfig.sizes.push_back(size);
+        }
+        else if (bench::parseOption(argc, argv, i, benchConfig))
+        {
+        }
+        else if (scaling::parseOption(argc, argv, i, scalingOptions))
+        {
+        }
+        else if (strcmp(argv[i], "--sort") == 0 && i + 1 < argc)
+        {
+            modes = parseSortModes(argv[++i]);
+            if (modes == 0)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--radix-bits") == 0 && i + 1 < argc)
+        {
+            radixBits = atoi(argv[++i]);
+            if (radixBits < psort::RADIX_MIN_BITS || radixBits > psort::RADIX_MAX_BITS)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--external") == 0 && i + 2 < argc)
+        {
+            externalInput = argv[++i];
+            externalOutput = argv[++i];
+        }
+        else if (strcmp(argv[i], "--memory") == 0 && i + 1 < argc)
+        {
+            long long megabytes = atoll(argv[++i]);
+            if (megabytes < 1)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            externalOptions.memoryBudget = (size_t)megabytes << 20;
+        }
+        else if (strcmp(argv[i], "--tmp") == 0 && i + 1 < argc)
+        {
+            externalOptions.tempDir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dist") == 0 && i + 1 < argc
+                 && datagen::parseDistribution(argv[i + 1], dataSpec.distribution))
+        {
+            i++;
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            dataSpec.seed = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc)
+        {
+            inputPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+        {
+            outputPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--generate") == 0 && i + 2 < argc)
+        {
+            generatePath = argv[++i];
+            generateCount = atoll(argv[++i]);
+            if (generateCount < 1)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
 
-    // Тест для 1000 элементов
-    testPerformance(1000);
+    if (outputPath != NULL && inputPath == NULL)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
 
-    cout << endl;
+    // Режимы работы с файлами вместо тестов в памяти
+    if (generatePath != NULL || externalInput != NULL || inputPath != NULL)
+    {
+        if (generatePath != NULL && !generateFile(generatePath, generateCount))
+        {
+            return 1;
+        }
+        if (externalInput != NULL && !runExternalSort(externalInput, externalOutput, externalOptions))
+        {
+            return 1;
+        }
+        if (inputPath != NULL && !testFile(inputPath, outputPath, modes))
+        {
+            return 1;
+        }
+        return benchReport.write(benchConfig) ? 0 : 1;
+    }
+
+    if (scalingOptions.modes != 0)
+    {
+        // Базовый размер: первый из --sizes или 1M элементов на поток
+        long long baseSize = benchConfig.sizes.empty() ? 1000000 : benchConfig.sizes[0];
+        runScaling(baseSize, modes);
+        return benchReport.write(benchConfig) ? 0 : 1;
+    }
 
-    // Тест для 10000 элементов
-    testPerformance(10000);
+    // По умолчанию - тесты на 1000 и 10000 элементов
+    std::vector<long long> defaultSizes;
+    defaultSizes.push_back(1000);
+    defaultSizes.push_back(10000);
+    std::vector<long long> sizes = bench::sizesOr(benchConfig, defaultSizes);
+    std::vector<int> threads = bench::threadCounts(benchConfig);
 
+    cout << "=== Задача 3: Сортировка выбором с OpenMP ===" << endl;
+    cout << "Radix sort: " << radixBits << " бит за проход" << endl;
+    cout << "Данные: " << datagen::distributionName(dataSpec.distribution)
+         << ", seed " << dataSpec.seed << endl;
+    cout << "Замер: " << benchConfig.warmups << " прогревочных + "
+         << benchConfig.repetitions << " запусков" << endl;
     cout << endl;
 
+    for (size_t t = 0; t < threads.size(); t++)
+    {
+        omp_set_num_threads(threads[t]);
+        for (size_t i = 0; i < sizes.size(); i++)
+        {
+            testPerformance((int)sizes[i], modes);
+            cout << endl;
+        }
+    }
+
     // ===== Общие выводы =====
     cout << "========================================" << endl;
     cout << "Общие выводы:" << endl;
@@ -244,6 +766,9 @@ int main()
     cout << endl;
     cout << "4. Для лучшей параллельной производительности лучше" << endl;
     cout << "   использовать алгоритмы как quicksort или mergesort." << endl;
+    cout << "   Сортировка выборкой (samplesort) делает всего один" << endl;
+    cout << "   параллельный регион и масштабируется на все ядра." << endl;
 
-    return 0;
+    // Результаты замеров - в CSV/JSON, если заданы --csv/--json
+    return benchReport.write(benchConfig) ? 0 : 1;
 }
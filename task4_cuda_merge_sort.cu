@@ -6,20 +6,68 @@
  * 2) Каждый блок GPU сортирует свой подмассив
  * 3) Подмассивы сливаются параллельно
  *
- * Компиляция: nvcc -o task4_cuda_sort task4_cuda_merge_sort.cu
- * Запуск: ./task4_cuda_sort
+ * Для сравнения на CPU запускаются классическая рекурсивная сортировка
+ * слиянием и параллельная сортировка слиянием на задачах OpenMP.
+ * CPU аналог sortSmallArraysKernel - сортировка кусков по 64 элемента -
+ * сделан битонической сетью AVX2 (common/sort_network.h); режим
+ * --bench-leaf сравнивает ее с сортировкой вставками.
+ * Режим k-путевого слияния (common/kway_merge.h) сливает все куски
+ * по 64 элемента деревом проигравших за 1-2 прохода вместо log2(n/64)
+ * попарных; программа выводит байты трафика памяти на элемент.
+ *
+ * Без nvcc файл собирается обычным g++ (как C++): тогда остается только
+ * CPU часть - это вариант для узлов без GPU.
+ *
+ * Компиляция: nvcc -Xcompiler -fopenmp -o task4_cuda_sort task4_cuda_merge_sort.cu
+ *             g++ -fopenmp -x c++ -o task4_cpu_sort task4_cuda_merge_sort.cu
+ * Вместо случайного массива можно взять файл int32 (little-endian):
+ * --input отображает его в память (common/mapped_file.h) без копирования.
+ *
+ * Случайные данные генерируются параллельно и воспроизводимо
+ * (common/data_gen.h); --dist выбирает распределение, --seed - seed.
+ *
+ * Режим --scaling повторяет параллельные CPU сортировки при 1, 2, 4, ...
+ * потоках с привязкой потоков и инициализацией first touch
+ * (common/scaling.h) и выводит ускорение и эффективность.
+ *
+ * Сборка с -DPERF_COUNTERS=1 добавляет к CPU замерам аппаратные
+ * счетчики по потокам (common/perf_counters.h).
+ *
+ * Каждая сортировка замеряется через common/bench.h (прогрев, несколько
+ * запусков, медиана); --sizes и --threads задают перебор, --csv и --json
+ * сохраняют результаты.
+ *
+ * Запуск: ./task4_cuda_sort [--size N | --input файл] [--dist имя] [--seed S] [--bench-leaf]
+ *         ./task4_cpu_sort --sizes 100000,10000000 --threads 1,4 --reps 10 --csv sort.csv
+ *         ./task4_cpu_sort --scaling both --sizes 1000000 --pin compact
  */
 
 #include <iostream>
 #include <cstdlib>
-#include <ctime>
+#include <climits>
+#include <cstring>
+#include <omp.h>
+
+#ifdef __CUDACC__
 #include <cuda_runtime.h>
+#endif
+
+#include "common/bench.h"
+#include "common/data_gen.h"
+#include "common/kway_merge.h"
+#include "common/mapped_file.h"
+#include "common/parallel_sort.h"
+#include "common/scaling.h"
+#include "common/scratch_arena.h"
+#include "common/sort_network.h"
 
 using namespace std;
 
-// Размер массива
+// Размер массива по умолчанию
 #define ARRAY_SIZE 10000
 
+#ifdef __CUDACC__
+
 // Размер блока (потоков в блоке)
 #define BLOCK_SIZE 256
 
@@ -34,31 +82,28 @@ using namespace std;
         } \
     } while(0)
 
+#endif // __CUDACC__
+
 // Функция слияния двух отсортированных частей массива (на CPU)
 // left - начало первой части
 // mid - конец первой части (и начало второй)
 // right - конец второй части
-void merge(int arr[], int left, int mid, int right)
+// scratch - арена, из которой берется временная память (без new/delete)
+void merge(int arr[], int left, int mid, int right, arena::ScratchArena& scratch)
 {
     // Вычисляем размеры двух подмассивов
     int n1 = mid - left + 1;
     int n2 = right - mid;
 
-    // Создаем временные массивы
-    int* leftArr = new int[n1];
-    int* rightArr = new int[n2];
+    // Во временную память копируем только левую часть:
+    // правая часть читается прямо из arr, и запись в arr[k]
+    // никогда не обгоняет чтение arr[mid + 1 + j]
+    int* leftArr = scratch.acquire(n1);
+    int* rightArr = arr + mid + 1;
 
-    // Копируем данные во временные массивы
-    for (int i = 0; i < n1; i++)
-    {
-        leftArr[i] = arr[left + i];
-    }
-    for (int j = 0; j < n2; j++)
-    {
-        rightArr[j] = arr[mid + 1 + j];
-    }
+    memcpy(leftArr, arr + left, n1 * sizeof(int));
 
-    // Сливаем временные массивы обратно в arr
+    // Сливаем временный массив и правую часть обратно в arr
     int i = 0;      // Индекс левого подмассива
     int j = 0;      // Индекс правого подмассива
     int k = left;   // Индекс объединенного массива
@@ -79,25 +124,17 @@ void merge(int arr[], int left, int mid, int right)
     }
 
     // Копируем оставшиеся элементы левого массива
+    // (остаток правого уже стоит на своем месте)
     while (i < n1)
     {
         arr[k] = leftArr[i];
         i++;
         k++;
     }
-
-    // Копируем оставшиеся элементы правого массива
-    while (j < n2)
-    {
-        arr[k] = rightArr[j];
-        j++;
-        k++;
-    }
-
-    delete[] leftArr;
-    delete[] rightArr;
 }
 
+#ifdef __CUDACC__
+
 // GPU ядро для сортировки маленьких подмассивов (сортировка вставками)
 // Каждый блок сортирует свой подмассив
 __global__ void sortSmallArraysKernel(int* arr, int size, int chunkSize)
@@ -257,29 +294,49 @@ void mergeSortGPU(int* hostArr, int size)
     CUDA_CHECK(cudaFree(deviceTemp));
 }
 
+#endif // __CUDACC__
+
 // Последовательная сортировка слиянием на CPU (для сравнения)
-void mergeSortCPU(int arr[], int left, int right)
+void mergeSortCPU(int arr[], int left, int right, arena::ScratchArena& scratch)
 {
     if (left < right)
     {
         int mid = left + (right - left) / 2;
 
         // Сортируем две половины
-        mergeSortCPU(arr, left, mid);
-        mergeSortCPU(arr, mid + 1, right);
+        mergeSortCPU(arr, left, mid, scratch);
+        mergeSortCPU(arr, mid + 1, right, scratch);
 
         // Сливаем отсортированные половины
-        merge(arr, left, mid, right);
+        merge(arr, left, mid, right, scratch);
     }
 }
 
+// Параллельная сортировка слиянием на CPU (задачи OpenMP)
+// Один временный буфер, вставки на листьях, параллельное слияние
+void mergeSortCPUParallel(int arr[], int size, arena::ScratchArena& scratch)
+{
+    psort::mergeSort(arr, size, scratch);
+}
+
+// Статистика последнего запуска k-путевой сортировки
+kway::Stats kwayStats;
+
+// Сортировка на CPU с k-путевым слиянием (дерево проигравших)
+void mergeSortCPUKway(int arr[], int size, arena::ScratchArena& scratch)
+{
+    kwayStats = kway::mergeSort(arr, size, scratch);
+}
+
+// Распределение тестовых данных (--dist, --seed)
+// По умолчанию числа от 0 до 99999 с фиксированным seed
+datagen::Spec dataSpec(datagen::UNIFORM, 0, 100000);
+
 // Заполнение массива случайными числами
+// Параллельно и воспроизводимо при любом числе потоков
 void fillArray(int arr[], int size)
 {
-    for (int i = 0; i < size; i++)
-    {
-        arr[i] = rand() % 100000;
-    }
+    datagen::fill(arr, size, dataSpec);
 }
 
 // Проверка что массив отсортирован
@@ -296,7 +353,7 @@ bool isSorted(int arr[], int size)
 }
 
 // Копирование массива
-void copyArray(int src[], int dst[], int size)
+void copyArray(const int src[], int dst[], int size)
 {
     for (int i = 0; i < size; i++)
     {
@@ -304,82 +361,271 @@ void copyArray(int src[], int dst[], int size)
     }
 }
 
-int main()
+// Проверка что два массива совпадают
+bool sameArrays(int a[], int b[], int size)
 {
-    cout << "=== Задача 4: Сортировка слиянием на GPU (CUDA) ===" << endl;
-    cout << "Размер массива: " << ARRAY_SIZE << endl;
-    cout << endl;
+    for (int i = 0; i < size; i++)
+    {
+        if (a[i] != b[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
 
-    // Проверяем наличие GPU
-    int deviceCount;
-    CUDA_CHECK(cudaGetDeviceCount(&deviceCount));
+// Настройки замеров (--reps, --warmup, --sizes, --threads, --csv, --json)
+// и накопленные результаты
+bench::Config benchConfig;
+bench::Report benchReport("task4_merge_sort");
 
-    if (deviceCount == 0)
+// Режим масштабирования (--scaling, --pin)
+scaling::Options scalingOptions;
+
+// Замер одной CPU сортировки с выводом результата, время - медиана в мс
+// Каждая сортировка получает свою арену временной памяти: после
+// прогрева запуски только переиспользуют ее (счетчики - на один запуск)
+double runCPUSort(const char* title, const char* variant,
+                  void (*sort)(int[], int, arena::ScratchArena&),
+                  const int original[], int arr[], int size, int threads)
+{
+    cout << "--- " << title << " ---" << endl;
+
+    arena::ScratchArena scratch;
+
+    // Счетчики арены обнуляются перед первым замеряемым запуском
+    int runs = 0;
+    bench::Summary t = bench::measure(benchConfig, variant,
+        [&]()
+        {
+            if (runs++ == benchConfig.warmups)
+            {
+                scratch.resetCounters();
+            }
+            copyArray(original, arr, size);
+        },
+        [&]() { sort(arr, size, scratch); });
+    benchReport.add("mergesort", variant, size, threads, t, (double)size * sizeof(int));
+    double time = t.median * 1000;
+
+    if (isSorted(arr, size))
     {
-        cout << "ОШИБКА: GPU не найден!" << endl;
-        return 1;
+        cout << "Результат: массив отсортирован корректно" << endl;
+    }
+    else
+    {
+        cout << "ОШИБКА: массив не отсортирован!" << endl;
     }
+    cout << "Время: " << bench::format(t) << endl;
+    perf::print(variant);
+    int measured = benchConfig.repetitions > 0 ? benchConfig.repetitions : 1;
+    cout << "На один запуск после прогрева: запросов временной памяти "
+         << scratch.requests() / measured
+         << ", выделений из кучи " << scratch.allocations() / (double)measured << endl;
+    cout << endl;
 
-    // Получаем информацию о GPU
-    cudaDeviceProp prop;
-    CUDA_CHECK(cudaGetDeviceProperties(&prop, 0));
-    cout << "GPU: " << prop.name << endl;
-    cout << "Мультипроцессоры: " << prop.multiProcessorCount << endl;
+    return time;
+}
+
+// Микробенчмарк сортировки маленьких кусков:
+// сортировка вставками против битонической сети для кусков 8/16/32/64
+void benchmarkLeafSort(int size)
+{
+    cout << "=== Сортировка кусков: вставки против сети AVX2 ===" << endl;
+    cout << "Размер массива: " << size << endl;
+    if (!netsort::networkAvailable())
+    {
+        cout << "AVX2 не поддерживается - сеть заменена сортировкой вставками" << endl;
+    }
     cout << endl;
 
-    // Инициализация генератора случайных чисел
-    srand(time(NULL));
+    int* original = new int[size];
+    int* arr = new int[size];
+    fillArray(original, size);
 
-    // Создаем массивы
-    int* original = new int[ARRAY_SIZE];
-    int* arrCPU = new int[ARRAY_SIZE];
-    int* arrGPU = new int[ARRAY_SIZE];
+    const size_t chunks[] = { 8, 16, 32, 64 };
+    const netsort::BlockSort sorts[] = { netsort::insertionSort, netsort::blockSort() };
+    const char* const names[] = { "insertion", "network" };
 
-    // Заполняем исходный массив
-    fillArray(original, ARRAY_SIZE);
+    for (size_t chunk : chunks)
+    {
+        double median[2];
+        bool ok = true;
 
-    // Копируем для каждой версии
-    copyArray(original, arrCPU, ARRAY_SIZE);
-    copyArray(original, arrGPU, ARRAY_SIZE);
+        for (int s = 0; s < 2; s++)
+        {
+            bench::Summary t = bench::measure(benchConfig,
+                [&]() { copyArray(original, arr, size); },
+                [&]() { netsort::sortChunks(arr, size, chunk, sorts[s]); });
+            median[s] = t.median;
+
+            char variant[32];
+            snprintf(variant, sizeof(variant), "%s-%d", names[s], (int)chunk);
+            benchReport.add("leaf-sort", variant, size, omp_get_max_threads(), t,
+                            (double)size * sizeof(int));
+
+            // Каждый кусок должен быть отсортирован
+            for (int start = 0; start < size; start += chunk)
+            {
+                int len = size - start < (int)chunk ? size - start : (int)chunk;
+                ok = ok && isSorted(arr + start, len);
+            }
+        }
 
-    // ===== CPU сортировка =====
-    cout << "--- Сортировка на CPU ---" << endl;
+        double chunksCount = (double)(size + chunk - 1) / chunk;
+        cout << "Кусок " << chunk << ": вставки " << median[0] / chunksCount * 1e9
+             << " нс/кусок, сеть " << median[1] / chunksCount * 1e9
+             << " нс/кусок, ускорение " << median[0] / median[1] << "x"
+             << (ok ? "" : "  ОШИБКА: куски не отсортированы!") << endl;
+    }
 
-    clock_t startCPU = clock();
-    mergeSortCPU(arrCPU, 0, ARRAY_SIZE - 1);
-    clock_t endCPU = clock();
+    delete[] original;
+    delete[] arr;
+}
 
-    double timeCPU = (double)(endCPU - startCPU) / CLOCKS_PER_SEC * 1000;
+// Обертка над рекурсивной версией с сигнатурой (arr, size, scratch)
+// Временная память под самое большое слияние (левая половина)
+// резервируется сразу - дальше слияния только переиспользуют ее
+void mergeSortCPUClassic(int arr[], int size, arena::ScratchArena& scratch)
+{
+    scratch.acquire(size / 2 + 1);
+    mergeSortCPU(arr, 0, size - 1, scratch);
+}
 
-    if (isSorted(arrCPU, ARRAY_SIZE))
+// Режим масштабирования: параллельные CPU сортировки при 1..N потоках
+// baseSize - размер при сильном и размер на поток при слабом
+void runScaling(long long baseSize)
+{
+    std::vector<int> threads = scaling::threadCounts(scalingOptions, benchConfig);
+    long long largest = scaling::largestSize(scalingOptions, baseSize, threads);
+    if (largest > INT_MAX)
     {
-        cout << "Результат: массив отсортирован корректно" << endl;
+        cout << "ОШИБКА: размер " << largest << " больше " << INT_MAX << endl;
+        return;
     }
-    else
+
+    cout << "=== Задача 4: масштабирование CPU сортировок слиянием ===" << endl;
+    scaling::printTopology(scalingOptions);
+    cout << endl;
+
+    struct Variant
     {
-        cout << "ОШИБКА: массив не отсортирован!" << endl;
+        const char* name;
+        const char* title;
+        void (*sort)(int[], int, arena::ScratchArena&);
+    };
+    const Variant variants[] = {
+        { "openmp-tasks", "Сортировка слиянием (задачи OpenMP)", mergeSortCPUParallel },
+        { "kway", "k-путевое слияние (дерево проигравших)", mergeSortCPUKway },
+    };
+    const scaling::Mode kinds[] = { scaling::STRONG, scaling::WEAK };
+
+    for (const Variant& variant : variants)
+    {
+        for (scaling::Mode kind : kinds)
+        {
+            if (!(scalingOptions.modes & kind))
+            {
+                continue;
+            }
+
+            std::vector<scaling::Point> points = scaling::sweep(scalingOptions, kind, baseSize, threads,
+                [&](long long size)
+                {
+                    // Оба массива сначала касаются потоки, которые их сортируют
+                    int* original = new int[size];
+                    int* arr = new int[size];
+                    scaling::firstTouch(original, size);
+                    scaling::firstTouch(arr, size);
+                    fillArray(original, (int)size);
+
+                    arena::ScratchArena scratch;
+                    bench::Summary t = bench::measure(benchConfig,
+                        [&]() { copyArray(original, arr, (int)size); },
+                        [&]() { variant.sort(arr, (int)size, scratch); });
+                    if (!isSorted(arr, (int)size))
+                    {
+                        cout << "ОШИБКА: массив не отсортирован!" << endl;
+                    }
+
+                    delete[] original;
+                    delete[] arr;
+                    return t;
+                });
+            scaling::printTable(variant.title, kind, points);
+            scaling::addToReport(benchReport, variant.name, kind, points, sizeof(int));
+        }
     }
-    cout << "Время: " << timeCPU << " мс" << endl;
+}
+
+// Все сортировки на одном исходном массиве: CPU версии, трафик памяти
+// и (в сборке nvcc) GPU версия
+void testSorts(const int original[], int size)
+{
+    int threads = omp_get_max_threads();
+
+    cout << "========================================" << endl;
+    cout << "Размер массива: " << size << ", потоков OpenMP: " << threads << endl;
+    cout << "========================================" << endl;
     cout << endl;
 
-    // ===== GPU сортировка =====
-    cout << "--- Сортировка на GPU (CUDA) ---" << endl;
+    int* arrClassic = new int[size];
+    int* arrCPU = new int[size];
+    int* arrKway = new int[size];
 
-    // Создаем события CUDA для точного измерения времени
-    cudaEvent_t start, stop;
-    CUDA_CHECK(cudaEventCreate(&start));
-    CUDA_CHECK(cudaEventCreate(&stop));
+    // ===== CPU сортировки =====
+    double timeClassic = runCPUSort("Сортировка на CPU (рекурсивная, 1 поток)", "classic",
+                                    mergeSortCPUClassic, original, arrClassic, size, 1);
+    double timeCPU = runCPUSort("Сортировка на CPU (задачи OpenMP)", "openmp-tasks",
+                                mergeSortCPUParallel, original, arrCPU, size, threads);
+    double timeKway = runCPUSort("Сортировка на CPU (k-путевое слияние, дерево проигравших)",
+                                 "kway", mergeSortCPUKway, original, arrKway, size, threads);
 
-    CUDA_CHECK(cudaEventRecord(start));
-    mergeSortGPU(arrGPU, ARRAY_SIZE);
-    CUDA_CHECK(cudaEventRecord(stop));
+    cout << "--- Сравнение CPU версий ---" << endl;
+    if (timeCPU > 0)
+    {
+        cout << "Ускорение OpenMP: " << timeClassic / timeCPU << "x" << endl;
+    }
+    if (timeKway > 0)
+    {
+        cout << "Ускорение k-путевого слияния: " << timeClassic / timeKway << "x" << endl;
+    }
+    if (sameArrays(arrClassic, arrCPU, size) && sameArrays(arrClassic, arrKway, size))
+    {
+        cout << "Результаты совпадают - OK!" << endl;
+    }
+    else
+    {
+        cout << "ВНИМАНИЕ: результаты отличаются" << endl;
+    }
+    cout << endl;
+
+    // Трафик памяти: каждый проход читает и пишет весь массив
+    cout << "--- Трафик памяти (байт на элемент) ---" << endl;
+    cout << "Попарное слияние на CPU: " << kway::pairwiseBytesPerElement(size, false) << endl;
+#ifdef __CUDACC__
+    cout << "Попарное слияние на GPU (слияние + copyKernel): "
+         << kway::pairwiseBytesPerElement(size, true) << endl;
+#endif
+    cout << "k-путевое слияние (" << kwayStats.mergePasses << " прох.): "
+         << kwayStats.bytesPerElement << endl;
+    cout << endl;
+
+#ifdef __CUDACC__
+    int* arrGPU = new int[size];
 
-    CUDA_CHECK(cudaEventSynchronize(stop));
+    // ===== GPU сортировка =====
+    cout << "--- Сортировка на GPU (CUDA) ---" << endl;
 
-    float timeGPU;
-    CUDA_CHECK(cudaEventElapsedTime(&timeGPU, start, stop));
+    // mergeSortGPU синхронна (копирует результат обратно на хост),
+    // поэтому время по часам хоста - это время с учетом передачи данных
+    bench::Summary gpu = bench::measure(benchConfig,
+        [&]() { copyArray(original, arrGPU, size); },
+        [&]() { mergeSortGPU(arrGPU, size); });
+    benchReport.add("mergesort", "cuda", size, threads, gpu, (double)size * sizeof(int));
+    double timeGPU = gpu.median * 1000;
 
-    if (isSorted(arrGPU, ARRAY_SIZE))
+    if (isSorted(arrGPU, size))
     {
         cout << "Результат: массив отсортирован корректно" << endl;
     }
@@ -387,7 +633,7 @@ int main()
     {
         cout << "ОШИБКА: массив не отсортирован!" << endl;
     }
-    cout << "Время: " << timeGPU << " мс" << endl;
+    cout << "Время: " << bench::format(gpu) << endl;
     cout << endl;
 
     // ===== Сравнение =====
@@ -400,27 +646,191 @@ int main()
     }
 
     // Проверяем что результаты совпадают
-    bool resultsMatch = true;
-    for (int i = 0; i < ARRAY_SIZE; i++)
+    if (sameArrays(arrCPU, arrGPU, size))
+    {
+        cout << "Результаты CPU и GPU совпадают - OK!" << endl;
+    }
+    else
+    {
+        cout << "ВНИМАНИЕ: результаты отличаются" << endl;
+    }
+
+    cout << endl;
+
+    delete[] arrGPU;
+#endif
+
+    // Освобождаем память
+    delete[] arrClassic;
+    delete[] arrCPU;
+    delete[] arrKway;
+}
+
+int main(int argc, char* argv[])
+{
+    bool benchLeaf = false;
+    const char* inputPath = NULL;
+
+    for (int i = 1; i < argc; i++)
     {
-        if (arrCPU[i] != arrGPU[i])
+        bool ok = true;
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+        {
+            long long size = atoll(argv[++i]);
+            ok = size >= 1 && size <= INT_MAX;
+            benchConfig.sizes.push_back(size);
+        }
+        else if (bench::parseOption(argc, argv, i, benchConfig))
+        {
+        }
+        else if (scaling::parseOption(argc, argv, i, scalingOptions))
+        {
+        }
+        else if (strcmp(argv[i], "--bench-leaf") == 0)
+        {
+            benchLeaf = true;
+        }
+        else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc)
         {
-            resultsMatch = false;
-            break;
+            inputPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dist") == 0 && i + 1 < argc
+                 && datagen::parseDistribution(argv[i + 1], dataSpec.distribution))
+        {
+            i++;
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            dataSpec.seed = strtoull(argv[++i], NULL, 10);
+        }
+        else
+        {
+            ok = false;
+        }
+        if (!ok)
+        {
+            cout << "Использование: " << argv[0]
+                 << " [--size N | --input файл] [--dist распределение] [--seed S] [--bench-leaf]" << endl;
+            bench::printUsage();
+            scaling::printUsage();
+            return 1;
         }
     }
 
-    if (resultsMatch)
+    // Размеры для перебора; данные из файла - один размер, число int32 в файле
+    std::vector<long long> sizes = bench::sizesOr(benchConfig,
+                                                  std::vector<long long>(1, ARRAY_SIZE));
+    std::vector<int> threads = bench::threadCounts(benchConfig);
+    for (size_t i = 0; i < sizes.size(); i++)
     {
-        cout << "Результаты CPU и GPU совпадают - OK!" << endl;
+        if (sizes[i] < 1 || sizes[i] > INT_MAX)
+        {
+            cout << "ОШИБКА: размер должен быть от 1 до " << INT_MAX << endl;
+            return 1;
+        }
+    }
+
+    mapped::File input;
+    if (inputPath != NULL)
+    {
+        if (!input.openRead(inputPath))
+        {
+            return 1;
+        }
+        if (input.count<int>() == 0 || input.count<int>() > INT_MAX)
+        {
+            cout << "В файле должно быть от 1 до " << INT_MAX << " чисел int32" << endl;
+            return 1;
+        }
+        sizes.assign(1, (long long)input.count<int>());
+    }
+
+    if (scalingOptions.modes != 0)
+    {
+        // Базовый размер: первый из --sizes или 1M элементов на поток
+        runScaling(benchConfig.sizes.empty() ? 1000000 : sizes[0]);
+        return benchReport.write(benchConfig) ? 0 : 1;
+    }
+
+    if (benchLeaf)
+    {
+        for (size_t t = 0; t < threads.size(); t++)
+        {
+            omp_set_num_threads(threads[t]);
+            for (size_t i = 0; i < sizes.size(); i++)
+            {
+                benchmarkLeafSort(sizes[i] < 1000000 ? 1000000 : (int)sizes[i]);
+                cout << endl;
+            }
+        }
+        return benchReport.write(benchConfig) ? 0 : 1;
+    }
+
+#ifdef __CUDACC__
+    cout << "=== Задача 4: Сортировка слиянием на GPU (CUDA) ===" << endl;
+#else
+    cout << "=== Задача 4: Сортировка слиянием на CPU (сборка без CUDA) ===" << endl;
+#endif
+    if (inputPath != NULL)
+    {
+        cout << "Данные: файл " << inputPath << " (отображен в память)" << endl;
     }
     else
     {
-        cout << "ВНИМАНИЕ: результаты отличаются" << endl;
+        cout << "Данные: " << datagen::distributionName(dataSpec.distribution)
+             << ", seed " << dataSpec.seed << endl;
     }
+    cout << "Замер: " << benchConfig.warmups << " прогревочных + "
+         << benchConfig.repetitions << " запусков, время - медиана" << endl;
+    cout << endl;
 
+#ifdef __CUDACC__
+    // Проверяем наличие GPU
+    int deviceCount;
+    CUDA_CHECK(cudaGetDeviceCount(&deviceCount));
+
+    if (deviceCount == 0)
+    {
+        cout << "ОШИБКА: GPU не найден!" << endl;
+        return 1;
+    }
+
+    // Получаем информацию о GPU
+    cudaDeviceProp prop;
+    CUDA_CHECK(cudaGetDeviceProperties(&prop, 0));
+    cout << "GPU: " << prop.name << endl;
+    cout << "Мультипроцессоры: " << prop.multiProcessorCount << endl;
     cout << endl;
+#endif
+
+    for (size_t i = 0; i < sizes.size(); i++)
+    {
+        int size = (int)sizes[i];
+
+        // Исходный массив: файл или случайные числа
+        int* generated = NULL;
+        const int* original = NULL;
+        if (inputPath != NULL)
+        {
+            original = input.as<int>();
+        }
+        else
+        {
+            generated = new int[size];
+            fillArray(generated, size);
+            original = generated;
+        }
+
+        for (size_t t = 0; t < threads.size(); t++)
+        {
+            omp_set_num_threads(threads[t]);
+            testSorts(original, size);
+        }
+
+        delete[] generated;
+    }
 
+#ifdef __CUDACC__
     // ===== Выводы =====
     cout << "--- Выводы ---" << endl;
     cout << "1. GPU показывает ускорение на больших массивах" << endl;
@@ -435,14 +845,8 @@ int main()
     cout << endl;
     cout << "4. Оптимизация размера блока влияет на производительность -" << endl;
     cout << "   нужно экспериментировать для конкретного GPU." << endl;
+#endif
 
-    // Освобождаем память
-    delete[] original;
-    delete[] arrCPU;
-    delete[] arrGPU;
-
-    CUDA_CHECK(cudaEventDestroy(start));
-    CUDA_CHECK(cudaEventDestroy(stop));
-
-    return 0;
+    // Результаты замеров - в CSV/JSON, если заданы --csv/--json
+    return benchReport.write(benchConfig) ? 0 : 1;
 }